@@ -9,6 +9,9 @@
 // and cannot be removed from it.
 //
 
+#include <algorithm>
+#include <climits>
+
 #include "common/LteControlInfo.h"
 #include "common/binder/Binder.h"
 #include "common/cellInfo/CellInfo.h"
@@ -21,9 +24,11 @@
 #include "stack/mac/packet/LteHarqFeedback_m.h"
 #include "stack/mac/packet/LteMacPdu.h"
 #include "stack/mac/buffer/LteMacBuffer.h"
+#include "stack/mac/scheduler/LcgPacking.h"
 #include "assert.h"
 #include "stack/packetFlowManager/PacketFlowManagerBase.h"
 #include "stack/phy/LtePhyBase.h"
+#include "stack/sdap/common/QfiContextManager.h"
 
 namespace simu5g {
 
@@ -159,13 +164,18 @@ void LteMacBase::fromPhy(cPacket *pktAux)
         if (hrit != harqRxBuffers_[carrierFreq].end()) {
             hrit->second->insertPdu(cw, pdu);
         }
+        else if (binder_->getOmnetId(src) == 0) {
+            // the sender has left the simulation (and its buffers have been deleted): do not
+            // create a new H-ARQ buffer that would never be released
+            EV << NOW << " Mac::fromPhy: node " << nodeId_ << " dropping PDU from detached node " << src << endl;
+            delete pdu;
+        }
         else {
-            // FIXME: possible memory leak
             LteHarqBufferRx *hrb;
             if (userInfo->getDirection() == DL || userInfo->getDirection() == UL)
-                hrb = new LteHarqBufferRx(ENB_RX_HARQ_PROCESSES, this, binder_, src);
+                hrb = new LteHarqBufferRx(ENB_RX_HARQ_PROCESSES, this, binder_, src, carrierFreq);
             else // D2D
-                hrb = new LteHarqBufferRxD2D(ENB_RX_HARQ_PROCESSES, this, binder_, src, (userInfo->getDirection() == D2D_MULTI));
+                hrb = new LteHarqBufferRxD2D(ENB_RX_HARQ_PROCESSES, this, binder_, src, carrierFreq, (userInfo->getDirection() == D2D_MULTI));
 
             harqRxBuffers_[carrierFreq][src] = hrb;
             hrb->insertPdu(cw, pdu);
@@ -197,7 +207,7 @@ bool LteMacBase::bufferizePacket(cPacket *pktAux)
     LteMacBuffers::iterator it = mbuf_.find(cid);
     if (it == mbuf_.end()) {
         // Queue not found for this CID: create
-        LteMacQueue *queue = new LteMacQueue(queueSize_);
+        LteMacQueue *queue = createQueue(cid);
         take(queue);
         LteMacBuffer *vqueue = new LteMacBuffer();
 
@@ -212,7 +222,7 @@ bool LteMacBase::bufferizePacket(cPacket *pktAux)
         // register connection to LCG map.
         LteTrafficClass tClass = (LteTrafficClass)lteInfo->getTraffic();
 
-        lcgMap_.insert(LcgPair(tClass, CidBufferPair(cid, macBuffers_[cid])));
+        registerLcgConnection(tClass, cid, vqueue);
 
         EV << "LteMacBuffers : Using new buffer on node: " <<
             MacCidToNodeId(cid) << " for LCID: " << MacCidToLcid(cid) << ", Space left in the Queue: " <<
@@ -227,7 +237,8 @@ bool LteMacBase::bufferizePacket(cPacket *pktAux)
         if (it != macBuffers_.end())
             vqueue = it->second;
 
-        if (!queue->pushBack(pkt)) {
+        if (!queue->pushBack(pkt, getBorrowableQueueSpace(cid, queue, pkt->getByteLength()))) {
+            recordQfiOverflow(cid, pkt->getByteLength());
             totalOverflowedBytes_ += pkt->getByteLength();
             double sample = (double)totalOverflowedBytes_ / (NOW - getSimulation()->getWarmupPeriod());
             if (lteInfo->getDirection() == DL) {
@@ -262,57 +273,52 @@ bool LteMacBase::bufferizePacket(cPacket *pktAux)
 
 void LteMacBase::deleteQueues(MacNodeId nodeId)
 {
-    for (auto mit = mbuf_.begin(); mit != mbuf_.end(); ) {
-        if (MacCidToNodeId(mit->first) == nodeId) {
-            while (!mit->second->isEmpty()) {
-                cPacket *pkt = mit->second->popFront();
-                delete pkt;
-            }
-            delete mit->second;        // Delete Queue
-            mit = mbuf_.erase(mit);    // Delete Element
-        }
-        else {
-            ++mit;
+    for (auto mit = lowerBoundNodeCid(mbuf_, nodeId); mit != mbuf_.end() && MacCidToNodeId(mit->first) == nodeId; ) {
+        while (!mit->second->isEmpty()) {
+            cPacket *pkt = mit->second->popFront();
+            delete pkt;
         }
+        delete mit->second;        // Delete Queue
+        mit = mbuf_.erase(mit);    // Delete Element
     }
-    for (auto vit = macBuffers_.begin(); vit != macBuffers_.end(); ) {
-        if (MacCidToNodeId(vit->first) == nodeId) {
-            while (!vit->second->isEmpty())
-                vit->second->popFront();
-            delete vit->second;        // Delete Queue
-            vit = macBuffers_.erase(vit);        // Delete Element
-        }
-        else {
-            ++vit;
-        }
+    queuePools_.erase(nodeId);
+    for (auto vit = lowerBoundNodeCid(macBuffers_, nodeId); vit != macBuffers_.end() && MacCidToNodeId(vit->first) == nodeId; ) {
+        while (!vit->second->isEmpty())
+            vit->second->popFront();
+        delete vit->second;        // Delete Queue
+        vit = macBuffers_.erase(vit);        // Delete Element
     }
 
     // delete H-ARQ buffers
     for (auto& [key, harqBuffers] : harqTxBuffers_) {
-        for (auto hit = harqBuffers.begin(); hit != harqBuffers.end(); ) {
-            if (hit->first == nodeId) {
-                delete hit->second; // Delete Queue
-                hit = harqBuffers.erase(hit); // Delete Element
-            }
-            else {
-                ++hit;
-            }
+        auto hit = harqBuffers.find(nodeId);
+        if (hit != harqBuffers.end()) {
+            delete hit->second; // Delete Queue
+            harqBuffers.erase(hit); // Delete Element
         }
     }
 
     for (auto& [key, harqBuffers] : harqRxBuffers_) {
-        for (auto hit2 = harqBuffers.begin(); hit2 != harqBuffers.end(); ) {
-            if (hit2->first == nodeId) {
-                delete hit2->second; // Delete Queue
-                hit2 = harqBuffers.erase(hit2); // Delete Element
-            }
-            else {
-                ++hit2;
-            }
+        auto hit2 = harqBuffers.find(nodeId);
+        if (hit2 != harqBuffers.end()) {
+            delete hit2->second; // Delete Queue
+            harqBuffers.erase(hit2); // Delete Element
         }
     }
-
-    // TODO remove traffic descriptor and LCG entry
+    resetHarq_.erase(nodeId);
+
+    // delete traffic descriptors and LCG entries
+    for (auto cit = lowerBoundNodeCid(connDesc_, nodeId); cit != connDesc_.end() && MacCidToNodeId(cit->first) == nodeId; ) {
+        auto range = lcgMap_.equal_range((LteTrafficClass)cit->second.getTraffic());
+        for (auto lit = range.first; lit != range.second; ) {
+            if (lit->second.first == cit->first)
+                lit = lcgMap_.erase(lit);
+            else
+                ++lit;
+        }
+        cit = connDesc_.erase(cit);
+    }
+    eraseNodeCids(connDescIn_, nodeId);
 }
 
 void LteMacBase::decreaseNumerologyPeriodCounter()
@@ -341,6 +347,13 @@ void LteMacBase::initialize(int stage)
 
         // Create buffers
         queueSize_ = par("queueSize");
+        for (const auto& entry : cStringTokenizer(par("qfiQueueSize").stringValue()).asVector()) {
+            std::vector<std::string> fields = cStringTokenizer(entry.c_str(), ":").asVector();
+            if (fields.size() != 2 || atoi(fields[1].c_str()) < 0)
+                throw cRuntimeError("LteMacBase::initialize - invalid per-QFI queue size '%s'", entry.c_str());
+            qfiQueueSize_[atoi(fields[0].c_str())] = atoi(fields[1].c_str());
+        }
+        queueSharedPool_ = par("queueSharedPool");
 
         // Get reference to binder
         binder_.reference(this, "binderModule", true);
@@ -376,7 +389,7 @@ void LteMacBase::handleMessage(cMessage *msg)
 {
     if (msg->isSelfMessage()) {
         handleSelfMessage();
-        scheduleAt(NOW + ttiPeriod_, ttiTick_);
+        scheduleAt(getNextTtiTickTime(), ttiTick_);
         return;
     }
 
@@ -438,6 +451,76 @@ void LteMacBase::discardRlcPdu(inet::Ptr<const UserControlInfo> lteInfo, unsigne
 
 void LteMacBase::finish()
 {
+    for (const auto& [qfi, stats] : qfiOverflowStats_) {
+        std::string suffix = ":qfi" + std::to_string(qfi);
+        recordScalar(("macBufferOverflowPackets" + suffix).c_str(), stats.packets);
+        recordScalar(("macBufferOverflowBytes" + suffix).c_str(), stats.bytes);
+    }
+}
+
+int LteMacBase::getQfi(MacCid cid) const
+{
+    int qfi = QfiContextManager::getInstance()->getQfiForCid(cid);
+    return (qfi >= 0) ? qfi : MacCidToLcid(cid) + 1;
+}
+
+int LteMacBase::getPriorityLevel(MacCid cid) const
+{
+    const QfiContext *context = QfiContextManager::getInstance()->getContextByQfi(getQfi(cid));
+    return (context != nullptr) ? context->priorityLevel : INT_MAX;
+}
+
+void LteMacBase::registerLcgConnection(LteTrafficClass tClass, MacCid cid, LteMacBuffer *vqueue)
+{
+    insertByPriorityLevel(lcgMap_, tClass, CidBufferPair(cid, vqueue),
+            [this](const CidBufferPair& connection) { return getPriorityLevel(connection.first); });
+}
+
+unsigned int LteMacBase::getQueueSize(MacCid cid) const
+{
+    if (qfiQueueSize_.empty())
+        return queueSize_;
+    auto it = qfiQueueSize_.find(getQfi(cid));
+    return (it != qfiQueueSize_.end()) ? it->second : queueSize_;
+}
+
+LteMacQueue *LteMacBase::createQueue(MacCid cid)
+{
+    LteMacQueue *queue = new LteMacQueue(getQueueSize(cid));
+    if (!queueSharedPool_ || queue->getQueueSize() == 0)
+        return queue;
+
+    // unknown QFIs never borrow nor lend
+    const QfiContext *context = QfiContextManager::getInstance()->getContextByQfi(getQfi(cid));
+    if (context == nullptr)
+        return queue;
+
+    // on the e/gNB the queues of each UE form a separate pool, on UEs all the queues are local
+    MacNodeId owner = (getNodeType() == UE) ? nodeId_ : MacCidToNodeId(cid);
+    queue->attachPool(&queuePools_[owner], context->priorityLevel);
+    return queue;
+}
+
+int64_t LteMacBase::getBorrowableQueueSpace(MacCid cid, const LteMacQueue *queue, int64_t bytes) const
+{
+    LteMacQueuePool *pool = queue->getPool();
+    if (pool == nullptr || bytes + queue->getQueueOccupancy() < queue->getQueueSize())
+        return 0;
+
+    // the pool is made of the unused space of lower-priority queues (higher priority level value),
+    // minus the space already borrowed by the queues of the same UE
+    int64_t space = -pool->borrowedSpace;
+    for (auto it = pool->unusedSpace.upper_bound(queue->getPoolLevel()); it != pool->unusedSpace.end(); ++it)
+        space += it->second;
+    EV << "LteMacBase::getBorrowableQueueSpace - CID " << cid << " may borrow " << std::max<int64_t>(space, 0) << " bytes" << endl;
+    return std::max<int64_t>(space, 0);
+}
+
+void LteMacBase::recordQfiOverflow(MacCid cid, int64_t bytes)
+{
+    QfiOverflowStats& stats = qfiOverflowStats_[getQfi(cid)];
+    stats.packets++;
+    stats.bytes += bytes;
 }
 
 void LteMacBase::deleteModule() {
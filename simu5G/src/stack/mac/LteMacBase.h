@@ -17,6 +17,8 @@
 #include "common/binder/Binder.h"
 #include "common/LteCommon.h"
 #include "common/LteControlInfo.h"
+#include "stack/mac/MacCidRange.h"
+#include "stack/mac/buffer/LteMacQueue.h"
 
 namespace simu5g {
 
@@ -114,6 +116,23 @@ class LteMacBase : public cSimpleModule
     /// Mac Buffers maximum queue size
     unsigned int queueSize_;
 
+    /// Per-QFI MAC buffer size (QFIs not in the map use queueSize_)
+    std::map<int, unsigned int> qfiQueueSize_;
+
+    /// If true, full queues may borrow the unused space of lower-priority queues of the same UE
+    bool queueSharedPool_ = false;
+
+    /// Shared pool of the queues of each UE (only the local UE on UEs)
+    std::map<MacNodeId, LteMacQueuePool> queuePools_;
+
+    /// Per-QFI overflow statistics: dropped packets and bytes
+    struct QfiOverflowStats
+    {
+        unsigned long packets = 0;
+        unsigned long bytes = 0;
+    };
+    std::map<int, QfiOverflowStats> qfiOverflowStats_;
+
     /// Mac Sdu Real Buffers
     LteMacBuffers mbuf_;
 
@@ -314,6 +333,29 @@ class LteMacBase : public cSimpleModule
 
     void unregisterHarqBufferRx(MacNodeId nodeId);
 
+    /**
+     * Returns the QFI carried by the given connection. Connections that are not
+     * registered yet are mapped to the QFI of their DRB (lcid + 1)
+     */
+    int getQfi(MacCid cid) const;
+
+    /**
+     * Returns the priority level of the QFI carried by the given connection (lower
+     * values mean higher priority), or INT_MAX if the QFI has no context
+     */
+    int getPriorityLevel(MacCid cid) const;
+
+    /**
+     * Returns the size of the MAC buffer of the given connection (0 means infinite)
+     */
+    unsigned int getQueueSize(MacCid cid) const;
+
+    /**
+     * Creates the MAC buffer of the given connection and, with the shared pool,
+     * adds it to the pool of the queues of its UE
+     */
+    LteMacQueue *createQueue(MacCid cid);
+
     // visualization
     void refreshDisplay() const override;
 
@@ -352,6 +394,25 @@ class LteMacBase : public cSimpleModule
      */
     void finish() override;
 
+    /**
+     * Returns the space that the queue of the given connection may borrow from the
+     * unused space of the lower-priority queues of the same UE to store a packet of
+     * the given size. Returns 0 if the shared pool is disabled or the packet fits in the queue.
+     */
+    int64_t getBorrowableQueueSpace(MacCid cid, const LteMacQueue *queue, int64_t bytes) const;
+
+    /**
+     * Registers a connection in the LCG map. The connections of a traffic class are
+     * kept sorted by priority level, so that the LCG scheduler visits them in
+     * priority order without sorting them at every grant
+     */
+    void registerLcgConnection(LteTrafficClass tClass, MacCid cid, LteMacBuffer *vqueue);
+
+    /**
+     * Accounts a packet dropped by the MAC buffer of the given connection
+     */
+    void recordQfiOverflow(MacCid cid, int64_t bytes);
+
     /**
      * Deleting the module
      *
@@ -367,6 +428,11 @@ class LteMacBase : public cSimpleModule
      */
     virtual void handleSelfMessage() = 0;
 
+    /**
+     * Returns the time of the next TTI tick, one TTI after the current one
+     */
+    virtual simtime_t getNextTtiTickTime() const { return NOW + ttiPeriod_; }
+
     /**
      * sendLowerPackets() is used
      * to send packets to lower layer
@@ -9,6 +9,8 @@
 // and cannot be removed from it.
 //
 
+#include <algorithm>
+#include <climits>
 #include <string>
 
 #include <inet/common/ModuleAccess.h>
@@ -36,6 +38,7 @@
 #include "stack/packetFlowManager/PacketFlowManagerBase.h"
 #include "stack/rlc/um/LteRlcUm.h"
 #include "stack/pdcp_rrc/NRPdcpRrcEnb.h"
+#include "stack/sdap/common/QfiContextManager.h"
 
 namespace simu5g {
 
@@ -43,6 +46,11 @@ Define_Module(LteMacEnb);
 
 using namespace omnetpp;
 
+simsignal_t LteMacEnb::coordinationOverheadSignal_ = cComponent::registerSignal("coordinationOverhead");
+simsignal_t LteMacEnb::receivedBsrSignal_ = cComponent::registerSignal("receivedBsr");
+simsignal_t LteMacEnb::harqResidualBlerDlSignal_ = cComponent::registerSignal("harqResidualBlerDl");
+simsignal_t LteMacEnb::cellEdgeServedBytesSignal_[2] = { cComponent::registerSignal("cellEdgeServedBytesDl"), cComponent::registerSignal("cellEdgeServedBytesUl") };
+
 /*********************
 * PUBLIC FUNCTIONS
 *********************/
@@ -61,6 +69,10 @@ LteMacEnb::~LteMacEnb()
 
     for (auto &[key, value] : bsrbuf_)
         delete value;
+
+    // the virtual buffers are deleted by the base class, after the counters have been destroyed
+    for (auto &[key, value] : macBuffers_)
+        value->setBacklogCounter(nullptr, NODEID_NONE, 0);
 }
 
 /***********************
@@ -92,21 +104,26 @@ SchedDiscipline LteMacEnb::getSchedDiscipline(Direction dir)
     }
 }
 
+unsigned int LteMacEnb::getBandwidthPart(MacCid cid) const
+{
+    return getBandwidthPartForQfi(QfiContextManager::getInstance()->getQfiForCid(cid));
+}
+
+unsigned int LteMacEnb::getBandwidthPartForQfi(int qfi) const
+{
+    auto it = qfiToBwp_.find(qfi);
+    return (it != qfiToBwp_.end()) ? it->second : defaultBwp_;
+}
+
 void LteMacEnb::deleteQueues(MacNodeId nodeId)
 {
     Enter_Method_Silent();
 
     LteMacBase::deleteQueues(nodeId);
 
-    LteMacBufferMap::iterator bit;
-    for (bit = bsrbuf_.begin(); bit != bsrbuf_.end(); ) {
-        if (MacCidToNodeId(bit->first) == nodeId) {
-            delete bit->second;
-            bit = bsrbuf_.erase(bit);
-        }
-        else {
-            ++bit;
-        }
+    for (auto bit = lowerBoundNodeCid(bsrbuf_, nodeId); bit != bsrbuf_.end() && MacCidToNodeId(bit->first) == nodeId; ) {
+        delete bit->second;
+        bit = bsrbuf_.erase(bit);
     }
 
     // remove active connections from the schedulers
@@ -115,6 +132,16 @@ void LteMacEnb::deleteQueues(MacNodeId nodeId)
 
     // remove pending RAC requests
     enbSchedulerUl_->removePendingRac(nodeId);
+
+    // remove UL arrival predictors
+    enbSchedulerUl_->removePreGrantPredictors(nodeId);
+
+    // release the SR occasion
+    auto sit = srOffset_.find(nodeId);
+    if (sit != srOffset_.end()) {
+        srOccasionLoad_[sit->second]--;
+        srOffset_.erase(sit);
+    }
 }
 
 void LteMacEnb::initialize(int stage)
@@ -131,6 +158,94 @@ void LteMacEnb::initialize(int stage)
         numAntennas_ = getNumAntennas();
 
         eNodeBCount = par("eNodeBCount");
+
+        int srPeriodicity = par("srPeriodicity");
+        if (srPeriodicity < 0)
+            throw cRuntimeError("LteMacEnb::initialize - invalid srPeriodicity %d", srPeriodicity);
+        srPeriodicity_ = srPeriodicity;
+        srOccasionLoad_.assign(srPeriodicity_, 0);
+        int srProhibitTimer = par("srProhibitTimer");
+        if (srProhibitTimer < 0)
+            throw cRuntimeError("LteMacEnb::initialize - invalid srProhibitTimer %d", srProhibitTimer);
+        srProhibitTimer_ = srProhibitTimer;
+
+        tddPattern_ = par("tddPattern").stdstringValue();
+        if (tddPattern_.find_first_not_of("DUS") != std::string::npos)
+            throw cRuntimeError("LteMacEnb::initialize - invalid TDD pattern '%s'", tddPattern_.c_str());
+        if (!tddPattern_.empty()) {
+            // UL grants are scheduled in the slot preceding the UL slot, see isTddSlotUsable()
+            unsigned int len = tddPattern_.size();
+            for (Direction dir : {DL, UL}) {
+                std::vector<unsigned int>& next = tddNextOpportunity_[dir];
+                next.assign(len, 0);
+                for (unsigned int i = 0; i < len; i++) {
+                    for (unsigned int k = 1; k <= len; k++) {
+                        char slot = tddPattern_[(i + k + (dir == UL ? 1 : 0)) % len];
+                        if ((dir == DL && slot != 'U') || (dir == UL && slot == 'U')) {
+                            next[i] = k;
+                            break;
+                        }
+                    }
+                    if (next[i] == 0)
+                        throw cRuntimeError("LteMacEnb::initialize - TDD pattern '%s' has no %s slots", tddPattern_.c_str(), dirToA(dir).c_str());
+                }
+            }
+        }
+
+        // bandwidth parts: "firstBand-lastBand:numerologyIndex:discipline" entries
+        for (const auto& entry : cStringTokenizer(par("bandwidthParts").stringValue()).asVector()) {
+            std::vector<std::string> fields = cStringTokenizer(entry.c_str(), ":").asVector();
+            std::vector<int> bands = fields.empty() ? std::vector<int>() : cStringTokenizer(fields[0].c_str(), "-").asIntVector();
+            if (fields.size() != 3 || bands.size() != 2 || bands[0] < 0 || bands[1] < bands[0])
+                throw cRuntimeError("LteMacEnb::initialize - invalid bandwidth part '%s'", entry.c_str());
+
+            BandwidthPart bwp;
+            bwp.firstBand = Band(bands[0]);
+            bwp.lastBand = Band(bands[1]);
+            bwp.numerologyIndex = atoi(fields[1].c_str());
+            bwp.discipline = aToSchedDiscipline(fields[2]);
+            for (const auto& other : bandwidthParts_) {
+                if (bwp.firstBand <= other.lastBand && other.firstBand <= bwp.lastBand)
+                    throw cRuntimeError("LteMacEnb::initialize - bandwidth part '%s' overlaps another bandwidth part", entry.c_str());
+            }
+            bandwidthParts_.push_back(bwp);
+        }
+
+        // QFI to BWP mapping: "qfi:bwp" entries, "*:bwp" for the QFIs not listed
+        for (const auto& entry : cStringTokenizer(par("qfiToBwp").stringValue()).asVector()) {
+            std::vector<std::string> fields = cStringTokenizer(entry.c_str(), ":").asVector();
+            if (fields.size() != 2 || atoi(fields[1].c_str()) < 0 || (unsigned int)atoi(fields[1].c_str()) >= bandwidthParts_.size())
+                throw cRuntimeError("LteMacEnb::initialize - invalid QFI to bandwidth part mapping '%s'", entry.c_str());
+            if (fields[0] == "*")
+                defaultBwp_ = atoi(fields[1].c_str());
+            else
+                qfiToBwp_[atoi(fields[0].c_str())] = atoi(fields[1].c_str());
+        }
+
+        // inter-cell coordination: neighbouring cells given as MAC node IDs, all the other cells if empty
+        interCellCoordination_ = par("interCellCoordination").boolValue();
+        for (int id : cStringTokenizer(par("coordinationNeighbours").stringValue()).asIntVector())
+            coordinationNeighbours_.push_back(MacNodeId(id));
+        coordinationNeighboursResolved_ = !coordinationNeighbours_.empty();
+        coordinationDelay_ = par("coordinationDelay");
+        interferencePriceWeight_ = par("interferencePriceWeight");
+        cellEdgeCqi_ = par("cellEdgeCqi");
+        if (coordinationDelay_ < 0 || interferencePriceWeight_ < 0)
+            throw cRuntimeError("LteMacEnb::initialize - invalid inter-cell coordination parameters");
+
+        rbTxEnergy_ = par("rbTxEnergy");
+        slotActiveEnergy_ = par("slotActiveEnergy");
+        if (rbTxEnergy_ < 0 || slotActiveEnergy_ < 0 || par("lyEnergyWeight").doubleValue() < 0 || par("lyMaxMutedDelay").doubleValue() < 0)
+            throw cRuntimeError("LteMacEnb::initialize - invalid energy model parameters");
+
+        checkBacklogCounters_ = par("checkBacklogCounters").boolValue();
+
+        // modules queried for the UL active UEs
+        rlcUm_ = inet::findModuleFromPar<LteRlcUm>(par("rlcUmModule"), this);
+        cModule *pdcp = inet::getModuleFromPar<cModule>(par("pdcpRrcModule"), this);
+        if (strcmp(pdcp->getClassName(), "NRPdcpRrcEnb") == 0)
+            nrPdcp_ = check_and_cast<NRPdcpRrcEnb *>(pdcp);
+
         WATCH(numAntennas_);
         WATCH_MAP(bsrbuf_);
     }
@@ -220,9 +335,57 @@ void LteMacEnb::initialize(int stage)
         // set the periodicity for each scheduler
         enbSchedulerDl_->initializeSchedulerPeriodCounter(cellInfo_->getMaxNumerologyIndex());
         enbSchedulerUl_->initializeSchedulerPeriodCounter(cellInfo_->getMaxNumerologyIndex());
+
+        // read UL pre-grant configuration
+        enbSchedulerUl_->initializePreGrants();
+
+        // read DL adaptive retransmission configuration
+        enbSchedulerDl_->initializeAdaptiveRtx();
     }
 }
 
+void LteMacEnb::finish()
+{
+    LteMacBase::finish();
+    enbSchedulerUl_->recordPreGrantStatistics();
+
+    for (const auto& [qfi, stats] : harqQfiStats_) {
+        std::string suffix = ":qfi" + std::to_string(qfi);
+        recordScalar(("harqRetransmissionsDl" + suffix).c_str(), stats.retransmissions);
+        recordScalar(("harqResidualErrorRateDl" + suffix).c_str(), (double)stats.residualErrors / stats.pdus);
+    }
+    for (Direction dir : { DL, UL }) {
+        for (const auto& [qfi, stats] : schedulingDelayStats_[dir]) {
+            std::string suffix = dirToA(dir) + ":qfi" + std::to_string(qfi);
+            recordScalar(("schedulingDelay" + suffix).c_str(), stats.sum / stats.samples, "s");
+            recordScalar(("schedulingDelayMax" + suffix).c_str(), stats.max, "s");
+        }
+    }
+}
+
+void LteMacEnb::recordHarqOutcome(MacCid cid, unsigned int transmissions, bool dropped)
+{
+    HarqQfiStats& stats = harqQfiStats_[QfiContextManager::getInstance()->getQfiForCid(cid)];
+    stats.pdus++;
+    stats.retransmissions += transmissions - 1;
+    if (dropped)
+        stats.residualErrors++;
+    emit(harqResidualBlerDlSignal_, dropped ? 1 : 0);
+}
+
+void LteMacEnb::recordSchedulingDelay(MacCid cid, Direction dir, simtime_t delay)
+{
+    QfiDelayStats& stats = schedulingDelayStats_[dir == DL ? DL : UL][QfiContextManager::getInstance()->getQfiForCid(cid)];
+    stats.samples++;
+    stats.sum += delay.dbl();
+    stats.max = std::max(stats.max, delay.dbl());
+}
+
+double LteMacEnb::getSlotTxEnergy(double blocks) const
+{
+    return (blocks > 0) ? slotActiveEnergy_ + blocks * rbTxEnergy_ : 0.0;
+}
+
 void LteMacEnb::handleMessage(cMessage *msg)
 {
     if (msg->isSelfMessage()) {
@@ -257,6 +420,11 @@ void LteMacEnb::macSduRequest()
                 allocatedBytes += enbSchedulerDl_->allocator_->getBytes(MACRO, b, destId);
             }
 
+            // a connection sharing its UE grant with other connections requests its own part only
+            unsigned int sharedBytes = enbSchedulerDl_->getSharedGrantBytes(cit.first, destCid);
+            if (sharedBytes > 0)
+                allocatedBytes = sharedBytes + MAC_HEADER;
+
             // send the request message to the upper layer
             auto pkt = new Packet("LteMacSduRequest");
             auto macSduRequest = makeShared<LteMacSduRequest>();
@@ -266,9 +434,10 @@ void LteMacEnb::macSduRequest()
             macSduRequest->setLcid(MacCidToLcid(destCid));
             macSduRequest->setSduSize(allocatedBytes - MAC_HEADER);    // do not consider MAC header size
             pkt->insertAtFront(macSduRequest);
-            if (queueSize_ != 0 && queueSize_ < macSduRequest->getSduSize()) {
+            unsigned int queueSize = getQueueSize(destCid);
+            if (queueSize != 0 && queueSize < macSduRequest->getSduSize()) {
                 throw cRuntimeError("LteMacEnb::macSduRequest: configured queueSize too low - requested SDU will not fit in queue!"
-                                    " (queue size: %d, SDU request requires: %d)", queueSize_, macSduRequest->getSduSize());
+                                    " (queue size: %d, SDU request requires: %d)", queueSize, macSduRequest->getSduSize());
             }
             auto tag = pkt->addTag<FlowControlInfo>();
             *tag = connDesc_[destCid];
@@ -278,21 +447,51 @@ void LteMacEnb::macSduRequest()
     EV << "------ END LteMacEnb::macSduRequest ------\n";
 }
 
+void LteMacEnb::bufferizeBsrReports(MacBsr *bsr, MacNodeId srcId, LogicalCid lcid)
+{
+    if (bsr->getReportLcidArraySize() == 0) {
+        bufferizeBsr(bsr, idToMacCid(srcId, lcid));
+        return;
+    }
+
+    // a UL connection that is not reported anymore has no backlog (e.g. its LCG is now reported
+    // on another connection). D2D backlogs come with their own BSRs
+    for (auto bit = lowerBoundNodeCid(bsrbuf_, srcId); bit != bsrbuf_.end() && MacCidToNodeId(bit->first) == srcId; ++bit) {
+        LogicalCid bufLcid = MacCidToLcid(bit->first);
+        if (bufLcid == D2D_SHORT_BSR || bufLcid == D2D_MULTI_SHORT_BSR || bit->second->isEmpty())
+            continue;
+        bool reported = false;
+        for (size_t i = 0; i < bsr->getReportLcidArraySize() && !reported; i++)
+            reported = bsr->getReportLcid(i) == bufLcid;
+        if (!reported)
+            bufferizeBsr(0, bsr->getTimestamp(), bit->first);
+    }
+
+    for (size_t i = 0; i < bsr->getReportLcidArraySize(); i++)
+        bufferizeBsr(bsr->getReportSize(i), bsr->getTimestamp(), idToMacCid(srcId, bsr->getReportLcid(i)));
+}
+
 void LteMacEnb::bufferizeBsr(MacBsr *bsr, MacCid cid)
+{
+    bufferizeBsr(bsr->getSize(), bsr->getTimestamp(), cid);
+}
+
+void LteMacEnb::bufferizeBsr(unsigned int size, double timestamp, MacCid cid)
 {
     LteMacBufferMap::iterator it = bsrbuf_.find(cid);
     if (it == bsrbuf_.end()) {
-        if (bsr->getSize() > 0) {
+        if (size > 0) {
             // Queue not found for this CID: create
             LteMacBuffer *bsrqueue = new LteMacBuffer();
+            bsrqueue->setBacklogCounter(&backlogCounter_[UL], MacCidToNodeId(cid), QfiContextManager::getInstance()->getQfiForCid(cid));
 
-            PacketInfo vpkt(bsr->getSize(), bsr->getTimestamp());
+            PacketInfo vpkt(size, timestamp);
             bsrqueue->pushBack(vpkt);
             bsrbuf_[cid] = bsrqueue;
 
             EV << "LteBsrBuffers : Added new BSR buffer for node: "
                << MacCidToNodeId(cid) << " for LCID: " << MacCidToLcid(cid)
-               << " Current BSR size: " << bsr->getSize() << "\n";
+               << " Current BSR size: " << size << "\n";
 
             // signal backlog to Uplink scheduler
             enbSchedulerUl_->backlog(cid);
@@ -302,19 +501,19 @@ void LteMacEnb::bufferizeBsr(MacBsr *bsr, MacCid cid)
     else {
         // Found
         LteMacBuffer *bsrqueue = it->second;
-        if (bsr->getSize() > 0) {
+        if (size > 0) {
             // update buffer
             PacketInfo queuedBsr;
             if (!bsrqueue->isEmpty())
                 queuedBsr = bsrqueue->popFront();
 
-            queuedBsr.first = bsr->getSize();
-            queuedBsr.second = bsr->getTimestamp();
+            queuedBsr.first = size;
+            queuedBsr.second = timestamp;
             bsrqueue->pushBack(queuedBsr);
 
             EV << "LteBsrBuffers : Using old buffer for node: " << MacCidToNodeId(
                     cid) << " for LCID: " << MacCidToLcid(cid)
-               << " Current BSR size: " << bsr->getSize() << "\n";
+               << " Current BSR size: " << size << "\n";
 
             // signal backlog to Uplink scheduler
             enbSchedulerUl_->backlog(cid);
@@ -388,12 +587,12 @@ void LteMacEnb::sendGrants(std::map<double, LteMacScheduleList> *scheduleList)
                << codewords << " codewords. CW[" << cw << "\\" << otherCw << "] carrier[" << citem.first << "]" << endl;
 
             // TODO: change to tag instead of chunk
-            // TODO: Grant is set as aperiodic by default
             auto pkt = new Packet("LteGrant");
 
             auto grant = makeShared<LteSchedulingGrant>();
             grant->setDirection(UL);
             grant->setCodewords(codewords);
+            setGrantPeriodicity(grant.get(), nodeId, citem.first);
 
             // Set total granted blocks
             grant->setTotalGrantedBlocks(granted);
@@ -403,42 +602,23 @@ void LteMacEnb::sendGrants(std::map<double, LteMacScheduleList> *scheduleList)
             pkt->addTagIfAbsent<UserControlInfo>()->setFrameType(GRANTPKT);
             pkt->addTagIfAbsent<UserControlInfo>()->setCarrierFrequency(citem.first);
 
-            // Get and set the user's UserTxParams
-            const UserTxParams& ui = getAmc()->computeTxParams(nodeId, UL, citem.first);
-            UserTxParams *txPara = new UserTxParams(ui);
-            grant->setUserTxParams(txPara);
-
-            // Acquiring remote antennas set from user info
-            const std::set<Remote>& antennas = ui.readAntennaSet();
+            // Get the bands allocated to the user in this slot
+            LteSchedulerEnb::UeAllocationSummary allocation;
+            enbSchedulerUl_->readUeAllocationSummary(nodeId, citem.first, allocation);
 
-            // Get bands for this carrier
-            const unsigned int firstBand = cellInfo_->getCarrierStartingBand(citem.first);
-            const unsigned int lastBand = cellInfo_->getCarrierLastBand(citem.first);
+            // Set the user's UserTxParams (the grant owns its copy), with the CQI of the allocated sub-bands
+            std::vector<unsigned int> cwBytes;
+            grant->setUserTxParams(amc_->computeGrantTxParams(nodeId, allocation.bands, UL, citem.first, cwBytes).dup());
 
             // HANDLE MULTICW
             for ( ; cw < codewords; ++cw) {
-                unsigned int grantedBytes = 0;
-
-                for (Band b = firstBand; b <= lastBand; ++b) {
-                    unsigned int bandAllocatedBlocks = 0;
-
-                    for (const auto& antenna : antennas) {
-                        bandAllocatedBlocks += enbSchedulerUl_->readPerUeAllocatedBlocks(nodeId, antenna, b);
-                    }
-
-                    grantedBytes += amc_->computeBytesOnNRbs(nodeId, b, cw,
-                            bandAllocatedBlocks, UL, citem.first);
-                }
+                unsigned int grantedBytes = (cw < cwBytes.size()) ? cwBytes[cw] : 0;
 
                 grant->setGrantedCwBytes(cw, grantedBytes);
                 EV << NOW << " LteMacEnb::sendGrants - granting " << grantedBytes << " on cw " << cw << endl;
             }
 
-            RbMap map;
-
-            enbSchedulerUl_->readRbOccupation(nodeId, citem.first, map);
-
-            grant->setGrantedBlocks(map);
+            grant->setGrantedBlocks(allocation.rbMap);
             pkt->insertAtFront(grant);
 
             /*
@@ -457,6 +637,24 @@ void LteMacEnb::sendGrants(std::map<double, LteMacScheduleList> *scheduleList)
     }
 }
 
+void LteMacEnb::setGrantPeriodicity(LteSchedulingGrant *grant, MacNodeId nodeId, double carrierFrequency)
+{
+    unsigned int period = 0;
+    unsigned int expiration = 0;
+    if (!enbSchedulerUl_->getIssuedConfiguredGrant(nodeId, carrierFrequency, period, expiration)) {
+        // the UE keeps a single grant per carrier
+        enbSchedulerUl_->releaseConfiguredGrant(nodeId, carrierFrequency);
+        grant->setPeriodic(false);
+        return;
+    }
+
+    EV << NOW << " LteMacEnb::setGrantPeriodicity - periodic grant for UE " << nodeId << ", period " << period
+       << " expiration " << expiration << endl;
+    grant->setPeriodic(true);
+    grant->setPeriod(period);
+    grant->setExpiration(expiration);
+}
+
 void LteMacEnb::macHandleRac(cPacket *pktAux)
 {
     EV << NOW << "LteMacEnb::macHandleRac" << endl;
@@ -466,7 +664,18 @@ void LteMacEnb::macHandleRac(cPacket *pktAux)
     auto racPkt = pkt->removeAtFront<LteRac>();
     auto uinfo = pkt->getTagForUpdate<UserControlInfo>();
 
-    enbSchedulerUl_->signalRac(uinfo->getSourceId(), uinfo->getCarrierFrequency());
+    // the request is served by the next scheduling pass, together with the other requests of the slot,
+    // according to the priority level of the UE backlog carried in the request
+    int priorityLevel = racPkt->getPriorityLevel() < 0 ? INT_MAX : racPkt->getPriorityLevel();
+    // with bandwidth parts, the request is served by the scheduler of the BWP of the QFI the UE is requesting for
+    int bandwidthPart = bandwidthParts_.empty() ? -1 : (int)getBandwidthPartForQfi(racPkt->getQfi());
+    srBatch_[uinfo->getCarrierFrequency()].emplace_back(uinfo->getSourceId(), NOW, priorityLevel, bandwidthPart);
+
+    if (srPeriodicity_ > 0) {
+        // SR on a dedicated occasion: the grant itself acts as the response
+        delete pkt;
+        return;
+    }
 
     // TODO: all RACs are marked as successful
     racPkt->setSuccess(true);
@@ -479,6 +688,125 @@ void LteMacEnb::macHandleRac(cPacket *pktAux)
     sendLowerPackets(pkt);
 }
 
+bool LteMacEnb::isTddSlotUsable(Direction dir) const
+{
+    if (tddPattern_.empty())
+        return true;
+
+    // DL data is sent in D and S slots. UL grants are issued one slot before the UL slot
+    unsigned long slot = (unsigned long)floor(NOW / ttiPeriod_ + 0.5) + (dir == DL ? 0 : 1);
+    char slotType = tddPattern_[slot % tddPattern_.size()];
+    return (dir == DL) ? slotType != 'U' : slotType == 'U';
+}
+
+double LteMacEnb::getTddWaitingTime(Direction dir) const
+{
+    if (tddPattern_.empty())
+        return 0;
+
+    unsigned long slot = (unsigned long)floor(NOW / ttiPeriod_ + 0.5);
+    const std::vector<unsigned int>& next = tddNextOpportunity_[(dir == DL) ? DL : UL];
+    return (next[slot % next.size()] - 1) * ttiPeriod_;
+}
+
+bool LteMacEnb::isCellEdgeUe(const UserTxParams& info) const
+{
+    const std::vector<Cqi>& cqi = info.readCqiVector();
+    return cellEdgeCqi_ > 0 && !cqi.empty() && cqi[0] <= cellEdgeCqi_;
+}
+
+void LteMacEnb::storeBandLoadReport(Direction dir, std::vector<double> load, std::vector<double> edgeLoad, unsigned int edgeBytes)
+{
+    std::deque<BandLoadReport>& reports = bandLoadReports_[dir];
+    reports.push_back({ NOW, std::move(load), std::move(edgeLoad) });
+
+    // drop the reports that are superseded for any reader, see getBandLoadReport()
+    while (reports.size() > 1 && reports[1].time < NOW - coordinationDelay_)
+        reports.pop_front();
+
+    emit(cellEdgeServedBytesSignal_[dir], (long)edgeBytes);
+}
+
+const LteMacEnb::BandLoadReport *LteMacEnb::getBandLoadReport(Direction dir, simtime_t maxTime) const
+{
+    // the report of the current slot is never used, so that the result does not depend
+    // on the order in which the cells are scheduled within the slot
+    const std::deque<BandLoadReport>& reports = bandLoadReports_[dir];
+    for (auto it = reports.rbegin(); it != reports.rend(); ++it) {
+        if (it->time <= maxTime && it->time < NOW)
+            return &(*it);
+    }
+    return nullptr;
+}
+
+const std::vector<double>& LteMacEnb::getInterferencePrice(Direction dir)
+{
+    std::vector<double>& price = interferencePrice_[dir];
+    if (!interCellCoordination_ || interferencePriceTime_[dir] == NOW)
+        return price;
+
+    if (!coordinationNeighboursResolved_) {
+        for (const EnbInfo *info : *binder_->getEnbList()) {
+            if (info->id != nodeId_ && info->nodeType == nodeType_)
+                coordinationNeighbours_.push_back(info->id);
+        }
+        coordinationNeighboursResolved_ = true;
+    }
+
+    interferencePriceTime_[dir] = NOW;
+    price.assign(cellInfo_->getNumBands(), 0.0);
+    long overhead = 0;
+    for (MacNodeId id : coordinationNeighbours_) {
+        if (binder_->getOmnetId(id) == 0)
+            continue;
+        LteMacEnb *neighbour = dynamic_cast<LteMacEnb *>(getMacByMacNodeId(binder_, id));
+        if (neighbour == nullptr)
+            continue;
+        const BandLoadReport *report = neighbour->getBandLoadReport(dir, NOW - coordinationDelay_);
+        if (report == nullptr)
+            continue;
+
+        const std::vector<double>& penalty = (dir == DL) ? report->load : report->edgeLoad;
+        for (size_t b = 0; b < std::min(price.size(), penalty.size()); b++)
+            price[b] += interferencePriceWeight_ * penalty[b];
+        overhead += report->load.size() + report->edgeLoad.size();
+    }
+    emit(coordinationOverheadSignal_, overhead);
+
+    EV << NOW << " LteMacEnb::getInterferencePrice - cell " << nodeId_ << " " << dirToA(dir) << ", " << coordinationNeighbours_.size()
+       << " neighbours, " << overhead << " band values received" << endl;
+    return price;
+}
+
+void LteMacEnb::handleSrBatch()
+{
+    for (auto& [carrierFrequency, srList] : srBatch_) {
+        if (srList.empty())
+            continue;
+
+        EV << NOW << " LteMacEnb::handleSrBatch - " << srList.size() << " requests on carrier " << carrierFrequency << endl;
+        enbSchedulerUl_->signalSr(srList, carrierFrequency);
+        srList.clear();
+    }
+}
+
+unsigned int LteMacEnb::assignSrOffset(MacNodeId ueId)
+{
+    if (srPeriodicity_ == 0)
+        throw cRuntimeError("LteMacEnb::assignSrOffset - SR occasions are not configured in cell %hu", num(nodeId_));
+
+    auto it = srOffset_.find(ueId);
+    if (it != srOffset_.end())
+        return it->second;
+
+    // SR occasions carry orthogonal resources, hence they never collide: spread UEs
+    // over the period to balance the number of SRs handled per slot
+    unsigned int offset = std::min_element(srOccasionLoad_.begin(), srOccasionLoad_.end()) - srOccasionLoad_.begin();
+    srOccasionLoad_[offset]++;
+    srOffset_[ueId] = offset;
+    return offset;
+}
+
 void LteMacEnb::macPduMake(MacCid cid)
 {
     EV << "----- START LteMacEnb::macPduMake -----\n";
@@ -524,6 +852,7 @@ void LteMacEnb::macPduMake(MacCid cid)
                 pkt->addTagIfAbsent<UserControlInfo>()->setDestId(destId);
                 pkt->addTagIfAbsent<UserControlInfo>()->setDirection(DL);
                 pkt->addTagIfAbsent<UserControlInfo>()->setCarrierFrequency(carrierFreq);
+                pkt->addTagIfAbsent<UserControlInfo>()->setLcid(MacCidToLcid(destCid));
 
                 const UserTxParams& txInfo = amc_->computeTxParams(destId, DL, carrierFreq);
 
@@ -641,6 +970,12 @@ void LteMacEnb::macPduUnmake(cPacket *pktAux)
 
         // TODO: upPkt->info()
         EV << "LteMacBase: PDU Unmaker extracted SDU" << endl;
+
+        // update the UL arrival statistics of the connection
+        auto lteInfo = check_and_cast<Packet *>(upPkt)->getTag<FlowControlInfo>();
+        MacCid cid = idToMacCid(lteInfo->getSourceId(), lteInfo->getLcid());
+        enbSchedulerUl_->notifyUlReception(cid, upPkt->getByteLength(), upPkt->getTimestamp(), userInfo->getCarrierFrequency());
+
         sendUpperPackets(upPkt);
     }
 
@@ -649,8 +984,8 @@ void LteMacEnb::macPduUnmake(cPacket *pktAux)
         // TODO: see if BSR for CID or LCID
         MacBsr *bsr = check_and_cast<MacBsr *>(macPkt->popCe());
         auto lteInfo = pkt->getTag<UserControlInfo>();
-        MacCid cid = idToMacCid(lteInfo->getSourceId(), 0);
-        bufferizeBsr(bsr, cid);
+        bufferizeBsrReports(bsr, lteInfo->getSourceId(), 0);
+        emit(receivedBsrSignal_, 1L);
         delete bsr;
     }
     pkt->insertAtFront(macPkt);
@@ -687,6 +1022,7 @@ bool LteMacEnb::bufferizePacket(cPacket *pktAux)
         LteMacBufferMap::iterator it = macBuffers_.find(cid);
         if (it == macBuffers_.end()) {
             LteMacBuffer *vqueue = new LteMacBuffer();
+            vqueue->setBacklogCounter(&backlogCounter_[DL], MacCidToNodeId(cid), QfiContextManager::getInstance()->getQfiForCid(cid));
             vqueue->pushBack(vpkt);
             macBuffers_[cid] = vqueue;
 
@@ -696,7 +1032,7 @@ bool LteMacEnb::bufferizePacket(cPacket *pktAux)
             // register connection to lcg map.
             LteTrafficClass tClass = (LteTrafficClass)lteInfo->getTraffic();
 
-            lcgMap_.insert(LcgPair(tClass, CidBufferPair(cid, macBuffers_[cid])));
+            registerLcgConnection(tClass, cid, vqueue);
 
             EV << "LteMacBuffers : Using new buffer on node: " <<
                 MacCidToNodeId(cid) << " for Lcid: " << MacCidToLcid(cid) << ", Bytes in the Queue: " <<
@@ -728,7 +1064,7 @@ bool LteMacEnb::bufferizePacket(cPacket *pktAux)
     LteMacBuffers::iterator it = mbuf_.find(cid);
     if (it == mbuf_.end()) {
         // Queue not found for this cid: create
-        LteMacQueue *queue = new LteMacQueue(queueSize_);
+        LteMacQueue *queue = createQueue(cid);
 
         queue->pushBack(pkt);
 
@@ -742,10 +1078,12 @@ bool LteMacEnb::bufferizePacket(cPacket *pktAux)
         // Found
         LteMacQueue *queue = it->second;
 
-        if (!queue->pushBack(pkt)) {
+        if (!queue->pushBack(pkt, getBorrowableQueueSpace(cid, queue, pkt->getByteLength()))) {
             // unable to buffer the packet (packet is not enqueued and will be dropped): update statistics
             EV << "LteMacBuffers : queue" << cid << " is full - cannot buffer packet " << pkt->getId() << "\n";
 
+            recordQfiOverflow(cid, pkt->getByteLength());
+
             totalOverflowedBytes_ += pkt->getByteLength();
             double sample = (double)totalOverflowedBytes_ / (NOW - getSimulation()->getWarmupPeriod());
 
@@ -802,6 +1140,9 @@ void LteMacEnb::handleSelfMessage()
 
     EV << "-----" << "ENB MAIN LOOP -----" << endl;
 
+    if (checkBacklogCounters_)
+        verifyBacklogCounters();
+
     // Reception
 
     // extract PDUs from all HARQ RX buffers and pass them to unmaker
@@ -827,6 +1168,9 @@ void LteMacEnb::handleSelfMessage()
 
     enbSchedulerUl_->updateHarqDescs();
 
+    // hand the SRs received in the last slot to the UL scheduler
+    handleSrBatch();
+
     std::map<double, LteMacScheduleList> *scheduleListUl = enbSchedulerUl_->schedule();
     // send uplink grants to PHY layer
     sendGrants(scheduleListUl);
@@ -1032,10 +1376,8 @@ int LteMacEnb::getActiveUesNumber(Direction dir)
 
         // every time an RLC SDU enters the layer, a newPktData is sent to
         // mac to inform the presence of data in RLC.
-        for (const auto& vit : macBuffers_) {
-            if (!vit.second->isEmpty())
-                activeUeSet.insert(MacCidToNodeId(vit.first)); // active users in RLC
-        }
+        for (const auto& [ueId, backlog] : backlogCounter_[DL].getUeBacklog())
+            activeUeSet.insert(ueId); // active users in RLC
     }
     else if (dir == UL) {
         // extract PDUs from all harqRxBuffers and pass them to unmaker
@@ -1048,10 +1390,9 @@ int LteMacEnb::getActiveUesNumber(Direction dir)
         }
 
         // check the presence of UM
-        LteRlcUm *rlcUm = inet::findModuleFromPar<LteRlcUm>(par("rlcUmModule"), this);
-        if (rlcUm != nullptr) {
+        if (rlcUm_ != nullptr) {
             std::set<MacNodeId> activeRlcUe;
-            rlcUm->activeUeUL(&activeRlcUe);
+            rlcUm_->activeUeUL(&activeRlcUe);
             for (auto ue : activeRlcUe) {
                 activeUeSet.insert(ue); // active users in RLC
             }
@@ -1062,12 +1403,9 @@ int LteMacEnb::getActiveUesNumber(Direction dir)
          * the PDCP layer can also have SDUs buffered.
          */
 
-        NRPdcpRrcEnb *nrPdpc;
-        cModule *pdcp = inet::getModuleFromPar<cModule>(par("pdcpRrcModule"), this);
-        if (strcmp(pdcp->getClassName(), "NRPdcpRrcEnb") == 0) {
-            nrPdpc = check_and_cast<NRPdcpRrcEnb *>(pdcp);
+        if (nrPdcp_ != nullptr) {
             std::set<MacNodeId> activePdcpUe;
-            nrPdpc->activeUeUL(&activePdcpUe);
+            nrPdcp_->activeUeUL(&activePdcpUe);
             for (auto ue: activePdcpUe) {
                 activeUeSet.insert(ue); // active users in RLC
             }
@@ -1081,6 +1419,50 @@ int LteMacEnb::getActiveUesNumber(Direction dir)
 }
 
 
+void LteMacEnb::verifyBacklogCounters()
+{
+    const LteMacBufferMap *buffers[2] = { &macBuffers_, &bsrbuf_ };
+    const char *dirName[2] = { "DL", "UL" };
+
+    for (int dir = DL; dir <= UL; dir++) {
+        std::map<MacNodeId, LteMacBacklogCounter::Backlog> ueBacklog;
+        std::map<int, LteMacBacklogCounter::Backlog> qfiBacklog;
+        int64_t bytes = 0;
+        for (const auto& [cid, buffer] : *buffers[dir]) {
+            if (buffer->isEmpty())
+                continue;
+            LteMacBacklogCounter::Backlog& ue = ueBacklog[MacCidToNodeId(cid)];
+            LteMacBacklogCounter::Backlog& qfi = qfiBacklog[QfiContextManager::getInstance()->getQfiForCid(cid)];
+            ue.bytes += buffer->getQueueOccupancy();
+            ue.packets += buffer->getQueueLength();
+            qfi.bytes += buffer->getQueueOccupancy();
+            qfi.packets += buffer->getQueueLength();
+            bytes += buffer->getQueueOccupancy();
+        }
+
+        const LteMacBacklogCounter& counter = backlogCounter_[dir];
+        if (bytes != counter.getBytes())
+            throw cRuntimeError("LteMacEnb::verifyBacklogCounters - %s backlog is %ld bytes, counter reports %ld",
+                    dirName[dir], (long)bytes, (long)counter.getBytes());
+        if (ueBacklog.size() != counter.getBackloggedUesNumber())
+            throw cRuntimeError("LteMacEnb::verifyBacklogCounters - %s backlogged UEs are %d, counter reports %d",
+                    dirName[dir], (int)ueBacklog.size(), (int)counter.getBackloggedUesNumber());
+        for (const auto& [ueId, backlog] : ueBacklog) {
+            if (backlog.bytes != counter.getUeBytes(ueId))
+                throw cRuntimeError("LteMacEnb::verifyBacklogCounters - %s backlog of UE %hu is %ld bytes, counter reports %ld",
+                        dirName[dir], num(ueId), (long)backlog.bytes, (long)counter.getUeBytes(ueId));
+        }
+        if (qfiBacklog.size() != counter.getQfiBacklog().size())
+            throw cRuntimeError("LteMacEnb::verifyBacklogCounters - %s backlogged QFIs are %d, counter reports %d",
+                    dirName[dir], (int)qfiBacklog.size(), (int)counter.getQfiBacklog().size());
+        for (const auto& [qfi, backlog] : qfiBacklog) {
+            if (backlog.bytes != counter.getQfiBytes(qfi))
+                throw cRuntimeError("LteMacEnb::verifyBacklogCounters - %s backlog of QFI %d is %ld bytes, counter reports %ld",
+                        dirName[dir], qfi, (long)backlog.bytes, (long)counter.getQfiBytes(qfi));
+        }
+    }
+}
+
 unsigned int LteMacEnb::getDlQueueSize(MacCid cid)
 {
     // macBuffers_ is the correct protected member variable inherited from LteMacBase.
@@ -12,11 +12,15 @@
 #ifndef _LTE_LTEMACENB_H_
 #define _LTE_LTEMACENB_H_
 
+#include <deque>
+#include <tuple>
+
 #include <inet/common/ModuleRefByPar.h>
 
 #include "common/cellInfo/CellInfo.h"
 #include "stack/mac/LteMacBase.h"
 #include "stack/mac/amc/LteAmc.h"
+#include "stack/mac/buffer/LteMacBacklogCounter.h"
 #include "common/LteCommon.h"
 #include "stack/backgroundTrafficGenerator/IBackgroundTrafficManager.h"
 
@@ -25,14 +29,41 @@ namespace simu5g {
 using namespace omnetpp;
 
 class MacBsr;
+class LteSchedulingGrant;
 class LteAmc;
 class LteSchedulerEnbDl;
 class LteSchedulerEnbUl;
 class ConflictGraph;
 class LteHarqProcessRx;
+class LteRlcUm;
+class NRPdcpRrcEnb;
+
+/**
+ * Bandwidth part: contiguous range of logical bands of a carrier,
+ * scheduled with its own numerology and scheduling discipline
+ */
+struct BandwidthPart
+{
+    Band firstBand;
+    Band lastBand;
+    NumerologyIndex numerologyIndex;
+    SchedDiscipline discipline;
+};
 
 class LteMacEnb : public LteMacBase
 {
+  public:
+    /**
+     * Per-band load of a cell in one slot, exchanged with the neighbouring cells
+     * for inter-cell coordination
+     */
+    struct BandLoadReport
+    {
+        simtime_t time;
+        std::vector<double> load;        // fraction of each band used in the cell
+        std::vector<double> edgeLoad;    // fraction of each band used by cell-edge UEs
+    };
+
   protected:
     /// Local CellInfo
     inet::ModuleRefByPar<CellInfo> cellInfo_;
@@ -56,12 +87,91 @@ class LteMacEnb : public LteMacBase
     /// Buffer for the BSRs
     LteMacBufferMap bsrbuf_;
 
+    /// Live backlog of the MAC virtual buffers (DL) and of the BSR buffers (UL), updated by the buffers
+    LteMacBacklogCounter backlogCounter_[2];
+
+    /// If true, the backlog counters are compared with a full recount of the buffers at every slot
+    bool checkBacklogCounters_ = false;
+
+    /// RLC UM and NR PDCP modules, queried for the UL active UEs
+    LteRlcUm *rlcUm_ = nullptr;
+    NRPdcpRrcEnb *nrPdcp_ = nullptr;
+
     /// Lte Mac Scheduler - Downlink
     LteSchedulerEnbDl *enbSchedulerDl_ = nullptr;
 
     /// Lte Mac Scheduler - Uplink
     LteSchedulerEnbUl *enbSchedulerUl_ = nullptr;
 
+    /// Scheduling Request configuration: periodicity (in slots) of the SR occasions, 0 for contention-based RAC
+    unsigned int srPeriodicity_ = 0;
+
+    /// slots during which a UE does not repeat a SR, unless a grant is received
+    unsigned int srProhibitTimer_ = 0;
+
+    /// SR offset assigned to each UE and number of UEs per SR offset
+    std::map<MacNodeId, unsigned int> srOffset_;
+    std::vector<unsigned int> srOccasionLoad_;
+
+    /// SRs and RAC requests received in the current slot (one list per carrier), handed to the UL scheduler in one pass.
+    /// Each request holds the UE, its arrival time, the priority level of the UE backlog and the bandwidth part
+    /// serving it (-1 if BWPs are not used)
+    std::map<double, std::vector<std::tuple<MacNodeId, simtime_t, int, int>>> srBatch_;
+
+    /// TDD pattern, one character per slot (D: downlink, U: uplink, S: special). Empty for FDD
+    std::string tddPattern_;
+
+    /// For each slot of the TDD pattern, number of slots until the next opportunity in the given direction
+    std::vector<unsigned int> tddNextOpportunity_[2];
+
+    /// Bandwidth parts of each carrier. Empty if every carrier is scheduled as a whole
+    std::vector<BandwidthPart> bandwidthParts_;
+
+    /// BWP serving each QFI, and BWP serving the QFIs that are not listed
+    std::map<int, unsigned int> qfiToBwp_;
+    unsigned int defaultBwp_ = 0;
+
+    /// Per-QFI DL HARQ statistics: PDUs completed, retransmissions, PDUs lost after the last retransmission
+    struct HarqQfiStats
+    {
+        unsigned long pdus = 0;
+        unsigned long retransmissions = 0;
+        unsigned long residualErrors = 0;
+    };
+    std::map<int, HarqQfiStats> harqQfiStats_;
+
+    /// Per-QFI delay of the data when it is scheduled (age of the head of the served buffer), one map per direction
+    struct QfiDelayStats
+    {
+        unsigned long samples = 0;
+        double sum = 0;
+        double max = 0;
+    };
+    std::map<int, QfiDelayStats> schedulingDelayStats_[2];
+
+    /// Transmit energy model: energy per allocated block, and energy of the cell in a non-muted slot
+    double rbTxEnergy_ = 0;
+    double slotActiveEnergy_ = 0;
+
+    /// Inter-cell coordination: band load reports published by the schedulers and read by the neighbouring cells
+    bool interCellCoordination_ = false;
+    std::vector<MacNodeId> coordinationNeighbours_;
+    bool coordinationNeighboursResolved_ = false;
+    simtime_t coordinationDelay_;
+    double interferencePriceWeight_ = 1.0;
+    int cellEdgeCqi_ = 0;
+    std::deque<BandLoadReport> bandLoadReports_[2];
+
+    /// Interference price of each band (one per direction), computed once per slot
+    std::vector<double> interferencePrice_[2];
+    simtime_t interferencePriceTime_[2] = { -1, -1 };
+
+    static simsignal_t coordinationOverheadSignal_;
+    // one sample per received BSR, valued with the number of BSR buffers it updated
+    static simsignal_t receivedBsrSignal_;
+    static simsignal_t harqResidualBlerDlSignal_;
+    static simsignal_t cellEdgeServedBytesSignal_[2];
+
     /// Maps to keep track of nodes that need a retransmission to be scheduled
     std::map<double, int> needRtxDl_;
     std::map<double, int> needRtxUl_;
@@ -78,12 +188,23 @@ class LteMacEnb : public LteMacBase
      */
     void handleMessage(cMessage *msg) override;
 
+    /**
+     * Records the UL scheduler statistics.
+     */
+    void finish() override;
+
     /**
      * Creates scheduling grants (one for each nodeId) according to the Schedule List.
      * It sends them to the lower layer.
      */
     virtual void sendGrants(std::map<double, LteMacScheduleList> *scheduleList);
 
+    /**
+     * Makes the grant periodic if the UL scheduler has issued a configured grant to the UE in
+     * this slot. Otherwise, the grant replaces the configured grant of the UE, which is released
+     */
+    void setGrantPeriodicity(LteSchedulingGrant *grant, MacNodeId nodeId, double carrierFrequency);
+
     /**
      * macPduMake() creates MAC PDUs (one for each CID)
      * by extracting SDUs from Real Mac Buffers according
@@ -121,6 +242,15 @@ class LteMacEnb : public LteMacBase
      * @param cid connection id for this bsr
      */
     void bufferizeBsr(MacBsr *bsr, MacCid cid);
+    void bufferizeBsr(unsigned int size, double timestamp, MacCid cid);
+
+    /**
+     * bufferizeBsrReports() stores a BSR received from <srcId> on the given LCID.
+     * The reports of a UL BSR are stored once each, on the connection they are given on,
+     * and the UL connections of the sender that are no longer reported are emptied.
+     * A BSR without reports is stored on the connection of the BSR itself.
+     */
+    void bufferizeBsrReports(MacBsr *bsr, MacNodeId srcId, LogicalCid lcid);
 
     /**
      * bufferizePacket() is called every time a packet is
@@ -148,9 +278,16 @@ class LteMacEnb : public LteMacBase
 
     /*
      * Receives and handles RAC requests.
+     * When SR occasions are configured, requests are stored and handed to the UL scheduler
+     * at the beginning of the next scheduling pass, with no response to the UE.
      */
     void macHandleRac(cPacket *pkt) override;
 
+    /*
+     * Hands all SRs and RAC requests received in the last slot to the UL scheduler.
+     */
+    virtual void handleSrBatch();
+
     /*
      * Update UserTxParam stored in every lteMacPdu when an RTX changes this information.
      */
@@ -161,6 +298,12 @@ class LteMacEnb : public LteMacBase
      */
     virtual void flushHarqBuffers();
 
+    /**
+     * Recounts the MAC virtual buffers and the BSR buffers and throws an error
+     * if the result differs from the backlog counters.
+     */
+    void verifyBacklogCounters();
+
   public:
 
     LteMacEnb();
@@ -179,6 +322,16 @@ class LteMacEnb : public LteMacBase
      */
     virtual unsigned int getDlQueueSize(MacCid cid);
 
+    /**
+     * Returns the live backlog of the given direction: MAC virtual buffers in DL,
+     * BSR buffers in UL. Totals, per-QFI bytes and backlogged UEs are kept up to date
+     * on every buffer change, so that no recount is needed.
+     */
+    const LteMacBacklogCounter& getBacklogCounter(Direction dir) const
+    {
+        return backlogCounter_[dir];
+    }
+
 
     /**
     /**
@@ -212,6 +365,133 @@ class LteMacEnb : public LteMacBase
         return bgTrafficManager_[carrierFrequency];
     }
 
+    /**
+     * Returns true if a TDD pattern is configured.
+     */
+    bool isTddEnabled() const
+    {
+        return !tddPattern_.empty();
+    }
+
+    /**
+     * Returns true if the current slot can be used by the scheduler of the given direction.
+     * UL grants are issued one slot ahead of the UL slot where the UE transmits.
+     */
+    bool isTddSlotUsable(Direction dir) const;
+
+    /**
+     * Returns the additional time (with respect to FDD) that the backlog not served in the
+     * current slot waits before the next opportunity in the same direction. 0 for FDD.
+     */
+    double getTddWaitingTime(Direction dir) const;
+
+    /**
+     * Returns the bandwidth parts configured on each carrier (empty if BWPs are not used).
+     */
+    const std::vector<BandwidthPart>& getBandwidthParts() const
+    {
+        return bandwidthParts_;
+    }
+
+    /**
+     * Returns the index of the bandwidth part serving the given connection,
+     * according to the QFI of the connection.
+     */
+    unsigned int getBandwidthPart(MacCid cid) const;
+
+    /**
+     * Returns the index of the bandwidth part serving the given QFI
+     * (the default one if the QFI is not mapped or unknown).
+     */
+    unsigned int getBandwidthPartForQfi(int qfi) const;
+
+    /**
+     * Accounts the outcome of a DL HARQ process (called by the HARQ unit when the PDU is
+     * acknowledged or discarded), per QFI of the connection that originated the PDU.
+     */
+    void recordHarqOutcome(MacCid cid, unsigned int transmissions, bool dropped);
+
+    /**
+     * Accounts the delay of the data of the connection when it is granted (DL or UL), per QFI.
+     */
+    void recordSchedulingDelay(MacCid cid, Direction dir, simtime_t delay);
+
+    /**
+     * Returns the transmit energy of one allocated block.
+     */
+    double getRbTxEnergy() const
+    {
+        return rbTxEnergy_;
+    }
+
+    /**
+     * Returns the energy of the cell in a slot with at least one allocated block.
+     */
+    double getSlotActiveEnergy() const
+    {
+        return slotActiveEnergy_;
+    }
+
+    /**
+     * Returns the estimated transmit energy of a slot with the given number of allocated blocks
+     * (0 for a muted slot).
+     */
+    double getSlotTxEnergy(double blocks) const;
+
+    /**
+     * Returns true if the neighbouring cells exchange their band load to price inter-cell interference.
+     */
+    bool isInterCellCoordinationEnabled() const
+    {
+        return interCellCoordination_;
+    }
+
+    /**
+     * Returns true if the UE is at the cell edge, according to the wideband CQI of its TX parameters.
+     */
+    bool isCellEdgeUe(const UserTxParams& info) const;
+
+    /**
+     * Stores the band load of the current slot for the given direction (called by the scheduler
+     * at the end of each slot), so that the neighbouring cells can read it.
+     */
+    void storeBandLoadReport(Direction dir, std::vector<double> load, std::vector<double> edgeLoad, unsigned int edgeBytes);
+
+    /**
+     * Returns the most recent band load report of the given direction published before
+     * the current slot and not later than maxTime, nullptr if none.
+     */
+    const BandLoadReport *getBandLoadReport(Direction dir, simtime_t maxTime) const;
+
+    /**
+     * Returns the interference price of each band for the cell-edge UEs in the given direction,
+     * i.e. the (weighted) load of the band in the neighbouring cells. In DL, cell-edge UEs are interfered
+     * by any transmission of the neighbouring gNBs, in UL by the cell-edge UEs of the neighbouring cells.
+     * Empty if inter-cell coordination is disabled.
+     */
+    const std::vector<double>& getInterferencePrice(Direction dir);
+
+    /**
+     * Returns the periodicity (in slots) of the SR occasions, 0 if contention-based RAC is used.
+     */
+    unsigned int getSrPeriodicity() const
+    {
+        return srPeriodicity_;
+    }
+
+    /**
+     * Returns the SR prohibit timer (in slots) configured to the UEs.
+     */
+    unsigned int getSrProhibitTimer() const
+    {
+        return srProhibitTimer_;
+    }
+
+    /**
+     * Assigns the SR offset to the given UE, choosing the least loaded SR occasion.
+     */
+    unsigned int assignSrOffset(MacNodeId ueId);
+
     /**
      * Returns the number of system antennas (MACRO included).
      */
@@ -27,6 +27,8 @@ Define_Module(LteMacEnbD2D);
 using namespace omnetpp;
 using namespace inet;
 
+simsignal_t LteMacEnbD2D::d2dMulticastDeliverySignal_ = cComponent::registerSignal("d2dMulticastDelivery");
+
 
 
 void LteMacEnbD2D::initialize(int stage)
@@ -156,6 +158,9 @@ void LteMacEnbD2D::macPduUnmake(cPacket *pktAux)
             connDescIn_[cid] = toStore;
         }
 
+        // update the UL arrival statistics of the connection
+        enbSchedulerUl_->notifyUlReception(cid, upPkt->getByteLength(), upPkt->getTimestamp(), userInfo->getCarrierFrequency());
+
         EV << "LteMacEnbD2D: Lcid --->"<< (int)lcid << " Cid: " << cid <<endl;
         QfiContextManager* mgr = QfiContextManager::getInstance();
         mgr->registerQfiForCid(cid, (int)lcid + 1);
@@ -169,36 +174,28 @@ void LteMacEnbD2D::macPduUnmake(cPacket *pktAux)
         sendUpperPackets(upPkt);
     }
 
+    // a D2D_MULTI BSR also carries the multicast group the transmitter is going to serve
+    if (userInfo->getLcid() == D2D_MULTI_SHORT_BSR && userInfo->getMulticastGroupId() >= 0)
+        multicastGroups_.registerTransmitter(userInfo->getMulticastGroupId(), userInfo->getSourceId());
+
     while (macPkt->hasCe()) {
         // Extract CE
         // TODO: see if for cid or lcid
         MacBsr *bsr = check_and_cast<MacBsr *>(macPkt->popCe());
-	/*
-	* 
-	* Fixing BSR CE Handling for Multiple CIDs
-	*
-        * auto lteInfo = pkt->getTag<UserControlInfo>();
-        * LogicalCid lcid = lteInfo->getLcid();  // one of SHORT_BSR or D2D_MULTI_SHORT_BSR
-	*
-        * MacCid cid = idToMacCid(lteInfo->getSourceId(), lcid); // this way, different connections from the same UE (e.g. one UL and one D2D)
-        *                                                       // obtain different CIDs. With the inverse operation, you can get
-        *                                                       // the LCID and discover if the connection is UL or D2D
-	* bufferizeBsr(bsr, cid);
-	*/
-
-	for (const auto& [cid, info] : connDescIn_) {
-		LogicalCid lcid = info.getLcid();
-    		MacNodeId nodeId = info.getSourceId();
-    		MacCid derivedCid = idToMacCid(nodeId, lcid);
-
-    		EV << "BSR CE: Cached FlowControlInfo → NodeId=" << nodeId
-       		<< ", LCID=" << (int)lcid
-       		<< ", CID=" << derivedCid
-       		<< ", BSR size=" << bsr->getSize()
-       		<< ", TS=" << bsr->getTimestamp() << endl;
-
-    		bufferizeBsr(bsr, derivedCid);
-	}        
+        // a UL BSR is stored once per LCG report, on the reported DRB. The D2D and D2D_MULTI BSRs are
+        // stored on the LCID they are carried on, so that the backlogs of the same UE are kept apart.
+        // The reported DRBs may have sent no data yet: their QFI is registered as for the data above,
+        // since the QFI-aware schedulers and the backlog counters look it up on these connections
+        QfiContextManager* mgr = QfiContextManager::getInstance();
+        for (size_t i = 0; i < bsr->getReportLcidArraySize(); i++) {
+            MacCid cid = idToMacCid(userInfo->getSourceId(), bsr->getReportLcid(i));
+            mgr->registerQfiForCid(cid, (int)bsr->getReportLcid(i) + 1);
+            if (mgr->getQfiForCid(cid) < 0)
+                throw cRuntimeError("LteMacEnbD2D::macPduUnmake - no QFI for UL connection %u of node %hu", cid, num(userInfo->getSourceId()));
+        }
+        bufferizeBsrReports(bsr, userInfo->getSourceId(), userInfo->getLcid());
+        emit(receivedBsrSignal_, 1L);
+        delete bsr;
     }
     pkt->insertAtFront(macPkt);
 
@@ -254,12 +251,12 @@ void LteMacEnbD2D::sendGrants(std::map<double, LteMacScheduleList> *scheduleList
             // get the direction of the grant, depending on which connection has been scheduled by the eNB
             Direction dir = (lcid == D2D_MULTI_SHORT_BSR) ? D2D_MULTI : ((lcid == D2D_SHORT_BSR) ? D2D : UL);
 
-            // TODO Grant is set aperiodic as default
             // TODO: change to tag instead of header
             auto pkt = new Packet("LteGrant");
             auto grant = makeShared<LteSchedulingGrant>();
             grant->setDirection(dir);
             grant->setCodewords(codewords);
+            setGrantPeriodicity(grant.get(), nodeId, carrierFreq);
 
             // set total granted blocks
             grant->setTotalGrantedBlocks(granted);
@@ -270,38 +267,23 @@ void LteMacEnbD2D::sendGrants(std::map<double, LteMacScheduleList> *scheduleList
             pkt->addTagIfAbsent<UserControlInfo>()->setFrameType(GRANTPKT);
             pkt->addTagIfAbsent<UserControlInfo>()->setCarrierFrequency(carrierFreq);
 
-            const UserTxParams& ui = getAmc()->computeTxParams(nodeId, dir, carrierFreq);
-            UserTxParams *txPara = new UserTxParams(ui);
-            // FIXME: possible memory leak
-            grant->setUserTxParams(txPara);
+            // get the bands allocated to the user in this slot
+            LteSchedulerEnb::UeAllocationSummary allocation;
+            enbSchedulerUl_->readUeAllocationSummary(nodeId, carrierFreq, allocation);
 
-            // acquiring remote antennas set from user info
-            const std::set<Remote>& antennas = ui.readAntennaSet();
-
-            // get bands for this carrier
-            const unsigned int firstBand = cellInfo_->getCarrierStartingBand(carrierFreq);
-            const unsigned int lastBand = cellInfo_->getCarrierLastBand(carrierFreq);
+            // the grant owns its copy of the user's UserTxParams, with the CQI of the allocated sub-bands
+            std::vector<unsigned int> cwBytes;
+            grant->setUserTxParams(amc_->computeGrantTxParams(nodeId, allocation.bands, dir, carrierFreq, cwBytes).dup());
 
             //  HANDLE MULTICW
             for ( ; cw < codewords; ++cw) {
-                unsigned int grantedBytes = 0;
-
-                for (Band b = firstBand; b <= lastBand; ++b) {
-                    unsigned int bandAllocatedBlocks = 0;
-                    for (const auto& antenna : antennas) {
-                        bandAllocatedBlocks += enbSchedulerUl_->readPerUeAllocatedBlocks(nodeId, antenna, b);
-                    }
-                    grantedBytes += amc_->computeBytesOnNRbs(nodeId, b, cw, bandAllocatedBlocks, dir, carrierFreq);
-                }
+                unsigned int grantedBytes = (cw < cwBytes.size()) ? cwBytes[cw] : 0;
 
                 grant->setGrantedCwBytes(cw, grantedBytes);
                 EV << NOW << " LteMacEnbD2D::sendGrants - granting " << grantedBytes << " on cw " << cw << endl;
             }
-            RbMap map;
 
-            enbSchedulerUl_->readRbOccupation(nodeId, carrierFreq, map);
-
-            grant->setGrantedBlocks(map);
+            grant->setGrantedBlocks(allocation.rbMap);
 
             /*
              * @author Alessandro Noferi
@@ -353,46 +335,36 @@ void LteMacEnbD2D::deleteQueues(MacNodeId nodeId)
 {
     LteMacEnb::deleteQueues(nodeId);
     deleteHarqBuffersMirrorD2D(nodeId);
+    multicastGroups_.removeNode(nodeId);
 }
 
 void LteMacEnbD2D::deleteHarqBuffersMirrorD2D(MacNodeId nodeId)
 {
     // delete all "mirror" buffers that have nodeId as sender or receiver
-    for (auto& mit : harqBuffersMirrorD2D_) {
-        for (auto it = mit.second.begin(); it != mit.second.end(); ) {
-            // get current nodeIDs
-            MacNodeId senderId = (it->first).first; // Transmitter
-            MacNodeId destId = (it->first).second;  // Receiver
-
-            if (senderId == nodeId || destId == nodeId) {
-                delete it->second;
-                it = mit.second.erase(it);
-            }
-            else {
-                ++it;
-            }
-        }
-    }
+    for (auto& mit : harqBuffersMirrorD2D_)
+        mit.second.eraseNode(nodeId);
 }
 
 void LteMacEnbD2D::deleteHarqBuffersMirrorD2D(MacNodeId txPeer, MacNodeId rxPeer)
 {
-    // delete all "mirror" buffers that have nodeId as sender or receiver
-    for (auto& mit : harqBuffersMirrorD2D_) {
-        for (auto it = mit.second.begin(); it != mit.second.end(); ) {
-            // get current nodeIDs
-            MacNodeId senderId = (it->first).first; // Transmitter
-            MacNodeId destId = (it->first).second;  // Receiver
-
-            if (senderId == txPeer && destId == rxPeer) {
-                delete it->second;
-                it = mit.second.erase(it);
-            }
-            else {
-                ++it;
-            }
-        }
-    }
+    // delete the "mirror" buffer of the pair <txPeer,rxPeer>
+    for (auto& mit : harqBuffersMirrorD2D_)
+        mit.second.erase(D2DPair(txPeer, rxPeer));
+}
+
+void LteMacEnbD2D::macHandleMulticastFeedback(Packet *pkt)
+{
+    auto mfbpkt = pkt->peekAtFront<LteHarqFeedbackMirror>();
+    int32_t groupId = pkt->getTag<UserControlInfo>()->getMulticastGroupId();
+    bool delivered = mfbpkt->getResult();
+
+    const LteD2DMulticastGroups::Group& group = multicastGroups_.recordOutcome(groupId, mfbpkt->getD2dSenderId(), delivered);
+    emit(d2dMulticastDeliverySignal_, delivered ? 1.0 : 0.0);
+
+    EV << NOW << " LteMacEnbD2D::macHandleMulticastFeedback - group " << groupId << " tx " << mfbpkt->getD2dSenderId()
+       << (delivered ? " ACK" : " NACK") << ", delivery ratio " << group.getDeliveryRatio() << endl;
+
+    delete pkt;
 }
 
 void LteMacEnbD2D::sendModeSwitchNotification(MacNodeId srcId, MacNodeId dstId, LteD2DMode oldMode, LteD2DMode newMode)
@@ -528,10 +500,8 @@ void LteMacEnbD2D::flushHarqBuffers()
     }
 
     // flush mirror buffer
-    for (auto& mirr_mit : harqBuffersMirrorD2D_) {
-        for (auto& mirr_it : mirr_mit.second)
-            mirr_it.second->markSelectedAsWaiting();
-    }
+    for (auto& mirr_mit : harqBuffersMirrorD2D_)
+        mirr_mit.second.markSelectedAsWaiting();
 }
 
 /*
@@ -554,14 +524,21 @@ void LteMacEnbD2D::fromPhy(cPacket *pktAux)
             return;
         }
 
+        // multicast outcomes only feed the group statistics: no buffer is kept per receiver
+        if (userInfo->getMulticastGroupId() >= 0) {
+            macHandleMulticastFeedback(pkt);
+            return;
+        }
+
         // H-ARQ feedback, send it to the mirror buffer of the D2D pair
         auto mfbpkt = pkt->peekAtFront<LteHarqFeedbackMirror>();
         MacNodeId d2dSender = mfbpkt->getD2dSenderId();
         MacNodeId d2dReceiver = mfbpkt->getD2dReceiverId();
         D2DPair pair(d2dSender, d2dReceiver);
-        HarqBuffersMirrorD2D::iterator hit = harqBuffersMirrorD2D_[carrierFrequency].find(pair);
+        HarqBuffersMirrorD2D& harqBuffersMirrorD2D = harqBuffersMirrorD2D_[carrierFrequency];
+        LteHarqBufferMirrorD2D *hb = harqBuffersMirrorD2D.find(pair);
         EV << NOW << "LteMacEnbD2D::fromPhy - node " << nodeId_ << " Received HARQ Feedback pkt (mirrored)" << endl;
-        if (hit == harqBuffersMirrorD2D_[carrierFrequency].end()) {
+        if (hb == nullptr) {
             // if feedback arrives, a buffer should exist (unless it is a handover scenario
             // where the HARQ buffer was deleted but feedback was in transit)
             // this case must be taken care of
@@ -569,13 +546,13 @@ void LteMacEnbD2D::fromPhy(cPacket *pktAux)
                 return;
 
             // create buffer
-            LteHarqBufferMirrorD2D *hb = new LteHarqBufferMirrorD2D((unsigned int)UE_TX_HARQ_PROCESSES, (unsigned char)par("maxHarqRtx"), this);
-            harqBuffersMirrorD2D_[carrierFrequency][pair] = hb;
-            hb->receiveHarqFeedback(pkt);
-        }
-        else {
-            hit->second->receiveHarqFeedback(pkt);
+            hb = new LteHarqBufferMirrorD2D((unsigned int)UE_TX_HARQ_PROCESSES, (unsigned char)par("maxHarqRtx"), this);
+            harqBuffersMirrorD2D.insert(pair, hb);
         }
+        hb->receiveHarqFeedback(pkt);
+
+        // a NACK makes the pair eligible for retransmission scheduling
+        harqBuffersMirrorD2D.markPending(pair);
     }
     else {
         LteMacBase::fromPhy(pkt);
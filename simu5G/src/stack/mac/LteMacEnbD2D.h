@@ -14,7 +14,8 @@
 
 #include "stack/mac/LteMacEnb.h"
 #include "stack/mac/buffer/LteMacBuffer.h"
-#include "stack/mac/buffer/harq_d2d/LteHarqBufferMirrorD2D.h"
+#include "stack/mac/buffer/harq_d2d/LteHarqBuffersMirrorD2D.h"
+#include "stack/mac/buffer/harq_d2d/LteD2DMulticastGroups.h"
 #include "stack/d2dModeSelection/D2DModeSwitchNotification_m.h"
 #include "stack/mac/conflict_graph/ConflictGraph.h"
 
@@ -22,8 +23,7 @@ namespace simu5g {
 
 using namespace omnetpp;
 
-typedef std::pair<MacNodeId, MacNodeId> D2DPair;
-typedef std::map<D2DPair, LteHarqBufferMirrorD2D *> HarqBuffersMirrorD2D;
+typedef LteHarqBuffersMirrorD2D HarqBuffersMirrorD2D;
 class ConflictGraph;
 
 class LteMacEnbD2D : public LteMacEnb
@@ -31,11 +31,16 @@ class LteMacEnbD2D : public LteMacEnb
   protected:
 
     /*
-     * Stores the mirrored status of H-ARQ buffers for D2D transmissions.
-     * The key value of the map is the pair <sender,receiver> of the D2D flow
+     * Stores the mirrored status of H-ARQ buffers for D2D transmissions,
+     * indexed by the pair <sender,receiver> of the D2D flow
      */
     std::map<double, HarqBuffersMirrorD2D> harqBuffersMirrorD2D_;
 
+    // multicast groups served by D2D transmitters, with the outcomes reported by their receivers
+    LteD2DMulticastGroups multicastGroups_;
+
+    static simsignal_t d2dMulticastDeliverySignal_;
+
     // if true, use the preconfigured TX params for transmission, else use that signaled by the eNB
     bool usePreconfiguredTxParams_;
     UserTxParams *preconfiguredTxParams_ = nullptr;
@@ -78,6 +83,12 @@ class LteMacEnbD2D : public LteMacEnb
 
     void macHandleD2DModeSwitch(cPacket *pkt);
 
+    /**
+     * Accounts the outcome of a multicast transmission, reported by its transmitter on
+     * behalf of all the receivers, into the statistics of the group
+     */
+    void macHandleMulticastFeedback(inet::Packet *pkt);
+
     /**
      * Flush Tx H-ARQ buffers for all users
      */
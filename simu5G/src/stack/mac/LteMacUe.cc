@@ -11,6 +11,11 @@
 
 #include "stack/mac/LteMacUe.h"
 
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <vector>
+
 #include <inet/networklayer/ipv4/Ipv4InterfaceData.h>
 
 #include "corenetwork/statsCollector/UeStatsCollector.h"
@@ -30,6 +35,25 @@ Define_Module(LteMacUe);
 using namespace inet;
 using namespace omnetpp;
 
+simsignal_t LteMacUe::bsrControlBytesSignal_ = cComponent::registerSignal("bsrControlBytes");
+
+// buffer size levels of the 5-bit BSR table (3GPP TS 38.321, Table 6.1.3.1-1)
+static const unsigned int bsrLevels[] = {
+    0, 10, 14, 20, 28, 38, 53, 74, 102, 142, 198, 276, 384, 535, 745, 1038, 1446, 2014,
+    2806, 3909, 5446, 7587, 10570, 14726, 20516, 28581, 39818, 55474, 77284, 107669, 150000
+};
+
+// size of a BSR control element with its MAC subheader
+static const unsigned int SHORT_BSR_CE_BYTES = 2;
+static const unsigned int LONG_BSR_CE_BASE_BYTES = 3;  // plus one byte per reported LCG
+
+// smallest level not lower than the given size (sizes beyond the table are reported as they are)
+static unsigned int quantizeBufferSize(unsigned int size)
+{
+    const unsigned int *level = std::lower_bound(std::begin(bsrLevels), std::end(bsrLevels), size);
+    return (level != std::end(bsrLevels)) ? *level : size;
+}
+
 LteMacUe::LteMacUe()
 {
     nodeType_ = UE;
@@ -54,6 +78,21 @@ void LteMacUe::initialize(int stage)
 {
     LteMacBase::initialize(stage);
     if (stage == INITSTAGE_LOCAL) {
+        eventDrivenBsr_ = par("eventDrivenBsr").boolValue();
+        bsrDeltaThreshold_ = par("bsrDeltaThreshold").intValue();
+        periodicBsrTimer_ = par("periodicBsrTimer");
+        if (bsrDeltaThreshold_ < 0 || periodicBsrTimer_ < 0)
+            throw cRuntimeError("LteMacUe::initialize - invalid event-driven BSR parameters");
+
+        std::string bsrTable = par("bsrTable").stdstringValue();
+        if (bsrTable == "none")
+            bsrTable_ = BSR_TABLE_NONE;
+        else if (bsrTable == "short")
+            bsrTable_ = BSR_TABLE_SHORT;
+        else if (bsrTable == "lcg")
+            bsrTable_ = BSR_TABLE_LCG;
+        else
+            throw cRuntimeError("LteMacUe::initialize - unknown BSR table '%s'", bsrTable.c_str());
     }
     else if (stage == INITSTAGE_LINK_LAYER) {
         if (strcmp(getFullName(), "nrMac") == 0)
@@ -82,6 +121,9 @@ void LteMacUe::initialize(int stage)
             amc->attachUser(nodeId_, UL);
             amc->attachUser(nodeId_, DL);
 
+            // get the SR configuration from the serving cell
+            configureSr();
+
             /*
              * @author Alessandro Noferi
              *
@@ -165,6 +207,7 @@ void LteMacUe::initialize(int stage)
                 }
             }
         }
+        lastTtiTick_ = NOW;
         scheduleAt(NOW + ttiPeriod_, ttiTick_);
     }
 }
@@ -177,10 +220,60 @@ void LteMacUe::handleMessage(cMessage *msg)
             delete msg;
             return;
         }
+        if (msg == ttiTick_) {
+            lastTtiTick_ = NOW;
+            waitingGrantOccasion_ = false;
+        }
+    }
+    else {
+        // the packet might need processing at the next TTI
+        resumeTtiTick();
     }
     LteMacBase::handleMessage(msg);
 }
 
+simtime_t LteMacUe::getNextTtiTickTime() const
+{
+    if (!waitingGrantOccasion_)
+        return NOW + ttiPeriod_;
+
+    // received PDUs still have to be evaluated and extracted at each TTI
+    for (const auto& [carrierFrequency, rxBuffers] : harqRxBuffers_) {
+        for (const auto& [srcId, rxBuffer] : rxBuffers) {
+            if (rxBuffer->isHarqBufferActive())
+                return NOW + ttiPeriod_;
+        }
+    }
+
+    // nothing to do before the first occasion (or expiration) of the periodic grants
+    simtime_t nextTick = SIMTIME_MAX;
+    for (const auto& [carrierFrequency, grant] : schedulingGrant_) {
+        if (grant == nullptr || !grant->getPeriodic())
+            continue;
+        nextTick = std::min(nextTick, std::min(nextGrantOccasion_.at(carrierFrequency), grantExpiration_.at(carrierFrequency)));
+    }
+    return std::max(nextTick, NOW + ttiPeriod_);
+}
+
+void LteMacUe::resumeTtiTick()
+{
+    if (ttiTick_ == nullptr || !ttiTick_->isScheduled())
+        return;
+
+    // first TTI boundary not earlier than now. A tick due now is still processed,
+    // as it is scheduled after the other messages
+    simtime_t period = ttiPeriod_;
+    int64_t elapsed = (NOW - lastTtiTick_).raw();
+    int64_t ttis = std::max<int64_t>(1, (elapsed + period.raw() - 1) / period.raw());
+    simtime_t nextTick = lastTtiTick_ + period * ttis;
+
+    if (ttiTick_->getArrivalTime() > nextTick) {
+        EV << NOW << " LteMacUe::resumeTtiTick - UE " << nodeId_ << " tick moved from " << ttiTick_->getArrivalTime() << " to " << nextTick << endl;
+        cancelEvent(ttiTick_);
+        scheduleAt(nextTick, ttiTick_);
+    }
+}
+
 int LteMacUe::macSduRequest()
 {
     EV << "----- START LteMacUe::macSduRequest -----\n";
@@ -263,6 +356,9 @@ bool LteMacUe::bufferizePacket(cPacket *pktAux)
         auto rlcSdu = pkt->peekAtFront<LteRlcSdu>();
         PacketInfo vpkt(rlcSdu->getLengthMainPacket(), pkt->getTimestamp());
 
+        // must be checked before the new data is queued
+        checkBsrOnNewData(cid, vpkt.first);
+
         LteMacBufferMap::iterator it = macBuffers_.find(cid);
         if (it == macBuffers_.end()) {
             LteMacBuffer *vqueue = new LteMacBuffer();
@@ -275,7 +371,7 @@ bool LteMacUe::bufferizePacket(cPacket *pktAux)
             // register connection to lcg map.
             LteTrafficClass tClass = (LteTrafficClass)lteInfo->getTraffic();
 
-            lcgMap_.insert(LcgPair(tClass, CidBufferPair(cid, macBuffers_[cid])));
+            registerLcgConnection(tClass, cid, vqueue);
 
             EV << "LteMacBuffers : Using new buffer on node: " <<
                 MacCidToNodeId(cid) << " for Lcid: " << MacCidToLcid(cid) << ", Bytes in the Queue: " <<
@@ -307,7 +403,7 @@ bool LteMacUe::bufferizePacket(cPacket *pktAux)
     LteMacBuffers::iterator it = mbuf_.find(cid);
     if (it == mbuf_.end()) {
         // Queue not found for this cid: create
-        LteMacQueue *queue = new LteMacQueue(queueSize_);
+        LteMacQueue *queue = createQueue(cid);
 
         queue->pushBack(pkt);
 
@@ -320,7 +416,8 @@ bool LteMacUe::bufferizePacket(cPacket *pktAux)
     else {
         // Found
         LteMacQueue *queue = it->second;
-        if (!queue->pushBack(pkt)) {
+        if (!queue->pushBack(pkt, getBorrowableQueueSpace(cid, queue, pkt->getByteLength()))) {
+            recordQfiOverflow(cid, pkt->getByteLength());
             totalOverflowedBytes_ += pkt->getByteLength();
             double sample = (double)totalOverflowedBytes_ / (NOW - getSimulation()->getWarmupPeriod());
             if (lteInfo->getDirection() == DL) {
@@ -540,21 +637,20 @@ void LteMacUe::macPduMake(MacCid cid)
             auto header = macPkt->removeAtFront<LteMacPdu>();
             if (bsrTriggered_) {
                 MacBsr *bsr = new MacBsr();
+                unsigned int ceBytes;
 
                 bsr->setTimestamp(simTime().dbl());
-                bsr->setSize(size);
+                setUlBsrReports(bsr, size, ceBytes);
                 header->pushCe(bsr);
 
                 bsrTriggered_ = false;
                 bsrAlreadyMade = true;
+                bsrSent(ceBytes);
 
                 EV << "LteMacUe::macPduMake - BSR with size " << size << " created" << endl;
             }
 
-            if (bsrAlreadyMade && size > 0)                                              // this prevents the UE from sending an unnecessary RAC request
-                bsrRtxTimer_ = bsrRtxTimerStart_;
-            else
-                bsrRtxTimer_ = 0;
+            updateBsrRtxTimer(bsrAlreadyMade, size);
 
             // insert updated MacPdu
             macPkt->insertAtFront(header);
@@ -645,6 +741,8 @@ void LteMacUe::handleSelfMessage()
     }
 
     EV << NOW << "LteMacUe::handleSelfMessage " << nodeId_ << " - HARQ process " << (unsigned int)currentHarq_ << endl;
+
+    checkPeriodicBsr();
     // updating current HARQ process for next TTI
 
     // no grant available - if user has backlogged data, it will trigger scheduling request
@@ -667,41 +765,12 @@ void LteMacUe::handleSelfMessage()
         // TODO ensure all operations are done before return ( i.e. move H-ARQ RX purge before this point)
     }
     else {
-        bool periodicGrant = false;
         bool checkRac = false;
-        bool skip = false;
-        for (auto& git : schedulingGrant_) {
-            if (git.second != nullptr && git.second->getPeriodic()) {
-                periodicGrant = true;
-                double carrierFreq = git.first;
-
-                // Periodic checks
-                if (--expirationCounter_[carrierFreq] < 0) {
-                    // Periodic grant is expired
-                    git.second = nullptr;
-                    checkRac = true;
-                }
-                else if (--periodCounter_[carrierFreq] > 0) {
-                    skip = true;
-                }
-                else {
-                    // resetting grant period
-                    periodCounter_[carrierFreq] = git.second->getPeriod();
-                    // this is periodic grant TTI - continue with frame sending
-                    checkRac = false;
-                    skip = false;
-                    break;
-                }
-            }
-        }
-        if (periodicGrant) {
-            if (checkRac)
-                checkRAC();
-            else {
-                if (skip)
-                    return;
-            }
-        }
+        bool skip = checkPeriodicGrants(checkRac);
+        if (checkRac)
+            checkRAC();
+        else if (skip)
+            return;
     }
 
     scheduleList_.clear();
@@ -729,9 +798,10 @@ void LteMacUe::handleSelfMessage()
                 EV << "\t Looking for retransmission in ACID " << (unsigned int)currentHarq_ << endl;
                 LteHarqBufferTx *currHarq = it2.second;
 
-                // check if the current process has units ready for retransmission
-                retx = currHarq->getProcess(currentHarq_)->hasReadyUnits();
-                CwList cwListRetx = currHarq->getProcess(currentHarq_)->readyUnitsIds();
+                // check if the current process has units ready for retransmission in the same direction as the grant
+                Direction grantDir = (Direction)schedulingGrant_[carrierFrequency]->getDirection();
+                retx = currHarq->getReadyProcesses(grantDir).count(currentHarq_) > 0;
+                CwList cwListRetx = retx ? currHarq->getProcess(currentHarq_)->readyUnitsIds(grantDir) : CwList();
 
                 EV << "\t [process=" << (unsigned int)currentHarq_ << "] , [reTX=" << ((retx) ? "true" : "false")
                    << "] , [n=" << cwListRetx.size() << "]" << endl;
@@ -821,20 +891,61 @@ void LteMacUe::macHandleGrant(cPacket *pktAux)
     // store received grant
     schedulingGrant_[carrierFrequency] = grant;
 
-    if (grant->getPeriodic()) {
-        periodCounter_[carrierFrequency] = grant->getPeriod();
-        expirationCounter_[carrierFrequency] = grant->getExpiration();
-    }
+    if (grant->getPeriodic())
+        configurePeriodicGrant(grant.get(), carrierFrequency);
 
     EV << NOW << "Node " << nodeId_ << " received grant of blocks " << grant->getTotalGrantedBlocks()
        << ", bytes " << grant->getGrantedCwBytes(0) << endl;
 
-    // clearing pending RAC requests
+    // clearing pending RAC requests and SRs
     racRequested_ = false;
+    srProhibitTimer_ = 0;
 
     delete pkt;
 }
 
+void LteMacUe::configurePeriodicGrant(const LteSchedulingGrant *grant, double carrierFrequency)
+{
+    // the grant is used at the period-th TTI from now, and it is valid for 'expiration' TTIs.
+    // The pending tick is the first TTI counted
+    simtime_t period = ttiPeriod_;
+    simtime_t firstTick = (ttiTick_ != nullptr && ttiTick_->isScheduled()) ? ttiTick_->getArrivalTime() : NOW + period;
+    unsigned int grantPeriod = std::max(1u, grant->getPeriod());
+    nextGrantOccasion_[carrierFrequency] = firstTick + period * (grantPeriod - 1);
+    grantExpiration_[carrierFrequency] = firstTick + period * grant->getExpiration();
+
+    EV << NOW << " LteMacUe::configurePeriodicGrant - UE " << nodeId_ << " carrier " << carrierFrequency << " first occasion "
+       << nextGrantOccasion_[carrierFrequency] << " expiration " << grantExpiration_[carrierFrequency] << endl;
+}
+
+bool LteMacUe::checkPeriodicGrants(bool& checkRac)
+{
+    bool periodicGrant = false;
+    bool due = false;
+    checkRac = false;
+    for (auto& [carrierFrequency, grant] : schedulingGrant_) {
+        if (grant == nullptr || !grant->getPeriodic())
+            continue;
+
+        periodicGrant = true;
+        if (NOW >= grantExpiration_[carrierFrequency]) {
+            // periodic grant is expired
+            grant = nullptr;
+            checkRac = true;
+        }
+        else if (NOW >= nextGrantOccasion_[carrierFrequency]) {
+            // this is a periodic grant TTI - move the occasion one period ahead and continue with frame sending
+            nextGrantOccasion_[carrierFrequency] += simtime_t(ttiPeriod_) * std::max(1u, grant->getPeriod());
+            due = true;
+        }
+    }
+    if (due)
+        checkRac = false;
+
+    waitingGrantOccasion_ = periodicGrant && !due && !checkRac;
+    return waitingGrantOccasion_;
+}
+
 void LteMacUe::macHandleRac(cPacket *pktAux)
 {
     auto pkt = check_and_cast<inet::Packet *>(pktAux);
@@ -874,6 +985,12 @@ void LteMacUe::checkRAC()
     EV << NOW << " LteMacUe::checkRAC , UE  " << nodeId_ << ", racTimer : " << racBackoffTimer_ << " maxRacTryOuts : " << maxRacTryouts_
        << ", raRespTimer:" << raRespTimer_ << endl;
 
+    // a dedicated SR configuration replaces the contention-based access
+    if (srPeriodicity_ > 0) {
+        checkSR();
+        return;
+    }
+
     if (racBackoffTimer_ > 0) {
         racBackoffTimer_--;
         return;
@@ -916,6 +1033,8 @@ void LteMacUe::checkRAC()
         auto pkt = new Packet("RacRequest");
 
         auto racReq = makeShared<LteRac>();
+        racReq->setPriorityLevel(getBackloggedPriorityLevel());
+        racReq->setQfi(getBackloggedQfi());
         pkt->insertAtFront(racReq);
 
         double carrierFrequency = phy_->getPrimaryChannelModel()->getCarrierFrequency();
@@ -934,6 +1053,244 @@ void LteMacUe::checkRAC()
     }
 }
 
+void LteMacUe::checkSR()
+{
+    EV << NOW << " LteMacUe::checkSR , UE  " << nodeId_ << ", srPeriodicity : " << srPeriodicity_ << " srOffset : " << srOffset_
+       << ", srProhibitTimer:" << srProhibitTimer_ << endl;
+
+    if (bsrRtxTimer_ > 0) {
+        // decrease BSR timer
+        bsrRtxTimer_--;
+        EV << NOW << " LteMacUe::checkSR - waiting for a grant, BSR RTX timer has not expired yet (timer=" << bsrRtxTimer_ << ")" << endl;
+        return;
+    }
+
+    if (srProhibitTimer_ > 0) {
+        // no RAC response follows a SR: the SR is only held back by the prohibit timer
+        srProhibitTimer_--;
+        EV << NOW << " LteMacUe::checkSR - SR prohibited, waiting for the grant for the previous SR (timer=" << srProhibitTimer_ << ")" << endl;
+        return;
+    }
+
+    // SRs can be sent only on the dedicated occasions
+    if (!isSrOccasion())
+        return;
+
+    MacCid cid = 0;
+    bool trigger = false;
+    for (const auto& it : macBuffers_) {
+        if (!(it.second->isEmpty())) {
+            cid = it.first;
+            trigger = true;
+            break;
+        }
+    }
+
+    if (!trigger) {
+        EV << NOW << " UE " << nodeId_ << ", SR aborted, no data in queues " << endl;
+        return;
+    }
+
+    // the SR occasion is dedicated, hence no contention is possible: the grant that
+    // answers the SR will carry the BSR
+    triggerBsr(cid);
+
+    auto pkt = new Packet("SchedulingRequest");
+
+    auto racReq = makeShared<LteRac>();
+    racReq->setPriorityLevel(getBackloggedPriorityLevel());
+    racReq->setQfi(getBackloggedQfi());
+    pkt->insertAtFront(racReq);
+
+    double carrierFrequency = phy_->getPrimaryChannelModel()->getCarrierFrequency();
+    pkt->addTagIfAbsent<UserControlInfo>()->setCarrierFrequency(carrierFrequency);
+    pkt->addTagIfAbsent<UserControlInfo>()->setSourceId(getMacNodeId());
+    pkt->addTagIfAbsent<UserControlInfo>()->setDestId(getMacCellId());
+    pkt->addTagIfAbsent<UserControlInfo>()->setDirection(UL);
+    pkt->addTagIfAbsent<UserControlInfo>()->setFrameType(RACPKT);
+
+    sendLowerPackets(pkt);
+
+    EV << NOW << " UE  " << nodeId_ << " cell " << cellId_ << ", SR sent to PHY " << endl;
+
+    // the SR is repeated on the next occasion, unless prohibited or answered by a grant
+    srProhibitTimer_ = srProhibitTimerStart_;
+}
+
+int LteMacUe::getBackloggedPriorityLevel() const
+{
+    int priorityLevel = INT_MAX;
+    for (const auto& [cid, buffer] : macBuffers_) {
+        if (!buffer->isEmpty())
+            priorityLevel = std::min(priorityLevel, getPriorityLevel(cid));
+    }
+    return priorityLevel;
+}
+
+int LteMacUe::getBackloggedQfi() const
+{
+    int priorityLevel = INT_MAX;
+    int qfi = -1;
+    for (const auto& [cid, buffer] : macBuffers_) {
+        if (!buffer->isEmpty() && (qfi < 0 || getPriorityLevel(cid) < priorityLevel)) {
+            priorityLevel = getPriorityLevel(cid);
+            qfi = getQfi(cid);
+        }
+    }
+    return qfi;
+}
+
+bool LteMacUe::isSrOccasion() const
+{
+    if (srPeriodicity_ == 0)
+        return false;
+
+    unsigned long slot = (unsigned long)floor(NOW / ttiPeriod_ + 0.5);
+    return slot % srPeriodicity_ == srOffset_;
+}
+
+void LteMacUe::configureSr()
+{
+    srPeriodicity_ = 0;
+    srOffset_ = 0;
+    srProhibitTimerStart_ = 0;
+    srProhibitTimer_ = 0;
+    if (cellId_ == NODEID_NONE)
+        return;
+
+    LteMacEnb *enb = check_and_cast<LteMacEnb *>(getMacByMacNodeId(binder_, cellId_));
+    srPeriodicity_ = enb->getSrPeriodicity();
+    if (srPeriodicity_ > 0) {
+        srOffset_ = enb->assignSrOffset(nodeId_);
+        srProhibitTimerStart_ = enb->getSrProhibitTimer();
+    }
+
+    EV << "LteMacUe::configureSr - UE " << nodeId_ << " cell " << cellId_ << ", srPeriodicity " << srPeriodicity_ << " srOffset " << srOffset_ << endl;
+}
+
+void LteMacUe::checkBsrOnNewData(MacCid cid, unsigned int bytes)
+{
+    unreportedBytes_ += bytes;
+    if (!eventDrivenBsr_ || bsrTriggered_)
+        return;
+
+    // new data with higher priority than all the backlogged connections (or no backlog at all)
+    int priorityLevel = getPriorityLevel(cid);
+    bool higherPriority = true;
+    for (const auto& [bufferCid, buffer] : macBuffers_) {
+        if (!buffer->isEmpty() && getPriorityLevel(bufferCid) <= priorityLevel) {
+            higherPriority = false;
+            break;
+        }
+    }
+
+    if (!higherPriority && unreportedBytes_ <= bsrDeltaThreshold_)
+        return;
+
+    EV << NOW << " LteMacUe::checkBsrOnNewData - UE " << nodeId_ << " BSR triggered by "
+       << (higherPriority ? "higher priority data" : "backlog variation") << " on cid " << cid << endl;
+
+    triggerBsr(cid);
+    // a regular BSR is sent as soon as possible, requesting a grant if needed
+    bsrRtxTimer_ = 0;
+}
+
+void LteMacUe::checkPeriodicBsr()
+{
+    if (!eventDrivenBsr_ || periodicBsrTimer_ == 0 || bsrTriggered_ || NOW - lastBsrTime_ < periodicBsrTimer_)
+        return;
+
+    // periodic BSRs are only sent on the available grants
+    for (const auto& [cid, buffer] : macBuffers_) {
+        if (!buffer->isEmpty()) {
+            triggerBsr(cid);
+            return;
+        }
+    }
+}
+
+unsigned int LteMacUe::getReportedBsrSize(unsigned int size, unsigned int& ceBytes) const
+{
+    ceBytes = SHORT_BSR_CE_BYTES;
+    if (bsrTable_ == BSR_TABLE_NONE || size == 0)
+        return size;
+    return quantizeBufferSize(size);
+}
+
+void LteMacUe::setUlBsrReports(MacBsr *bsr, unsigned int size, unsigned int& ceBytes) const
+{
+    // LCG connections are stored consecutively in the LCG map, each LCG in priority order
+    std::vector<std::pair<MacCid, unsigned int>> reports;
+    size_t lead = 0;
+    for (auto it = lcgMap_.begin(); it != lcgMap_.end(); ) {
+        LteTrafficClass lcg = it->first;
+        MacCid lcgCid = 0;
+        unsigned int lcgBytes = 0;
+        for ( ; it != lcgMap_.end() && it->first == lcg; ++it) {
+            const FlowControlInfo& desc = connDesc_.at(it->second.first);
+            unsigned int occupancy = it->second.second->getQueueOccupancy();
+            if (desc.getDirection() != UL || occupancy == 0)
+                continue;
+            if (lcgBytes == 0)
+                lcgCid = it->second.first;
+            lcgBytes += occupancy + ((desc.getRlcType() == AM) ? RLC_HEADER_AM : (desc.getRlcType() == UM) ? RLC_HEADER_UM : 0);
+        }
+        if (lcgBytes > 0) {
+            if (!reports.empty() && getPriorityLevel(lcgCid) < getPriorityLevel(reports[lead].first))
+                lead = reports.size();
+            reports.push_back({lcgCid, lcgBytes});
+        }
+    }
+
+    if (reports.empty()) {
+        bsr->setSize(getReportedBsrSize(size, ceBytes));
+        return;
+    }
+
+    if (bsrTable_ == BSR_TABLE_SHORT) {
+        // a single level for the whole backlog, on the highest priority connection
+        unsigned int backlog = 0;
+        for (const auto& report : reports)
+            backlog += report.second;
+        reports = { { reports[lead].first, quantizeBufferSize(backlog) } };
+    }
+    else if (bsrTable_ == BSR_TABLE_LCG) {
+        for (auto& report : reports)
+            report.second = quantizeBufferSize(report.second);
+    }
+    ceBytes = (bsrTable_ == BSR_TABLE_LCG) ? LONG_BSR_CE_BASE_BYTES + reports.size() : SHORT_BSR_CE_BYTES;
+
+    unsigned int reported = 0;
+    bsr->setReportLcidArraySize(reports.size());
+    bsr->setReportSizeArraySize(reports.size());
+    for (size_t i = 0; i < reports.size(); i++) {
+        bsr->setReportLcid(i, MacCidToLcid(reports[i].first));
+        bsr->setReportSize(i, reports[i].second);
+        reported += reports[i].second;
+    }
+    bsr->setSize(reported);
+}
+
+void LteMacUe::bsrSent(unsigned int ceBytes)
+{
+    lastBsrTime_ = NOW;
+    unreportedBytes_ = 0;
+    emit(bsrControlBytesSignal_, (long)ceBytes);
+}
+
+void LteMacUe::updateBsrRtxTimer(bool bsrMade, unsigned int backlog)
+{
+    // this prevents the UE from sending an unnecessary RAC request: with event-driven BSRs, the
+    // remaining backlog has already been reported, and new data only requests a grant by triggering a BSR.
+    // If the backlog only holds data arrived after the last BSR, the eNB view has drained and no grant
+    // would follow: the request is sent right away
+    bool reported = bsrMade || (eventDrivenBsr_ && !bsrTriggered_ && backlog > unreportedBytes_);
+    if (backlog > 0 && reported)
+        bsrRtxTimer_ = bsrRtxTimerStart_;
+    else
+        bsrRtxTimer_ = 0;
+}
+
 void LteMacUe::updateUserTxParam(cPacket *pktAux)
 {
     auto pkt = check_and_cast<inet::Packet *>(pktAux);
@@ -951,6 +1308,7 @@ void LteMacUe::updateUserTxParam(cPacket *pktAux)
 
     int grantedBlocks = schedulingGrant_[carrierFrequency]->getTotalGrantedBlocks();
 
+    // only the allocated bands are listed in the granted blocks, the bands missing from the map have 0 blocks
     lteInfo->setGrantedBlocks(schedulingGrant_[carrierFrequency]->getGrantedBlocks());
     lteInfo->setTotalGrantedBlocks(grantedBlocks);
 }
@@ -973,14 +1331,11 @@ void LteMacUe::flushHarqBuffers()
 
 bool LteMacUe::getHighestBackloggedFlow(MacCid& cid, unsigned int& priority)
 {
-    // TODO : optimize if inefficient
-    // TODO : implement priorities and LCGs
-    // search in virtual buffer structures
-
-    for (const auto& item : macBuffers_) {
+    // the LCG map is sorted by traffic class and, within a class, by priority level
+    for (const auto& [tClass, item] : lcgMap_) {
         if (!item.second->isEmpty()) {
             cid = item.first;
-            // TODO priority = something;
+            priority = getPriorityLevel(cid);
             return true;
         }
     }
@@ -989,22 +1344,22 @@ bool LteMacUe::getHighestBackloggedFlow(MacCid& cid, unsigned int& priority)
 
 bool LteMacUe::getLowestBackloggedFlow(MacCid& cid, unsigned int& priority)
 {
-    // TODO : optimize if inefficient
-    // TODO : implement priorities and LCGs
-    for (LteMacBufferMap::const_reverse_iterator it = macBuffers_.rbegin(); it != macBuffers_.rend(); ++it) {
-        if (!it->second->isEmpty()) {
-            cid = it->first;
-            // TODO priority = something;
+    for (auto it = lcgMap_.rbegin(); it != lcgMap_.rend(); ++it) {
+        if (!it->second.second->isEmpty()) {
+            cid = it->second.first;
+            priority = getPriorityLevel(cid);
             return true;
         }
     }
-
     return false;
 }
 
 void LteMacUe::doHandover(MacNodeId targetEnb)
 {
     cellId_ = targetEnb;
+
+    // the SR configuration is assigned by the new serving cell
+    configureSr();
 }
 
 void LteMacUe::deleteQueues(MacNodeId nodeId)
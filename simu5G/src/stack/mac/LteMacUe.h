@@ -25,6 +25,7 @@ class LteSchedulingGrant;
 class LteSchedulerUeUl;
 class Binder;
 class LteChannelModel;
+class MacBsr;
 
 class LteMacUe : public LteMacBase
 {
@@ -45,8 +46,15 @@ class LteMacUe : public LteMacBase
     unsigned char currentHarq_ = 0;
 
     // periodic grant handling - one per carrier
-    std::map<double, unsigned int> periodCounter_;
-    std::map<double, unsigned int> expirationCounter_;
+    // time of the next transmission occasion and expiration time of the periodic grant
+    std::map<double, simtime_t> nextGrantOccasion_;
+    std::map<double, simtime_t> grantExpiration_;
+
+    // time of the last TTI tick, used to keep the tick aligned when TTIs are skipped
+    simtime_t lastTtiTick_;
+
+    // true if the last TTI was skipped waiting for the occasion of a periodic grant
+    bool waitingGrantOccasion_ = false;
 
     // number of MAC SDUs requested to the RLC
     int requestedSdus_ = 0;
@@ -71,6 +79,33 @@ class LteMacUe : public LteMacBase
     // BSR handling
     bool bsrTriggered_ = false;
 
+    // event-driven BSR triggering: a BSR is triggered on data arrival for a connection with higher
+    // priority than the backlogged ones, when more than bsrDeltaThreshold_ bytes arrived since the
+    // last BSR, or every periodicBsrTimer_ (if not zero) while data is queued
+    bool eventDrivenBsr_ = false;
+    int64_t bsrDeltaThreshold_ = 0;
+    simtime_t periodicBsrTimer_ = 0;
+    simtime_t lastBsrTime_ = 0;
+    int64_t unreportedBytes_ = 0;
+
+    // buffer size table used to quantize the reported sizes
+    enum BsrTable
+    {
+        BSR_TABLE_NONE,   // exact sizes
+        BSR_TABLE_SHORT,  // one level for the whole backlog
+        BSR_TABLE_LCG     // one level per LCG
+    };
+    BsrTable bsrTable_ = BSR_TABLE_NONE;
+
+    static simsignal_t bsrControlBytesSignal_;
+
+    // Scheduling Request (SR) configuration, assigned by the serving cell.
+    // When srPeriodicity_ is 0, the UE uses the contention-based RAC procedure
+    unsigned int srPeriodicity_ = 0;
+    unsigned int srOffset_ = 0;
+    unsigned int srProhibitTimerStart_ = 0;
+    unsigned int srProhibitTimer_ = 0;
+
     /**
      * Reads MAC parameters for UE and performs initialization.
      */
@@ -130,6 +165,35 @@ class LteMacUe : public LteMacBase
      */
     void macHandleGrant(cPacket *pkt) override;
 
+    /*
+     * Stores the transmission occasion and the expiration time of a periodic grant
+     * received on the given carrier
+     */
+    void configurePeriodicGrant(const LteSchedulingGrant *grant, double carrierFrequency);
+
+    /*
+     * Checks the periodic grants at the current TTI: expired grants are released,
+     * and the occasion of the grants due at this TTI is moved one period ahead.
+     *
+     * @param checkRac set to true if a periodic grant has expired
+     * @return true if the TTI has to be skipped, i.e. periodic grants are configured
+     *         but none of them is due at this TTI
+     */
+    bool checkPeriodicGrants(bool& checkRac);
+
+    /*
+     * Returns the time of the next TTI tick. While the UE is only waiting for the
+     * occasion of its periodic grants, the tick is moved to the next occasion
+     * (or expiration), so that no event is generated in between
+     */
+    simtime_t getNextTtiTickTime() const override;
+
+    /*
+     * Brings a postponed TTI tick back to the next TTI boundary.
+     * Called when a message that may require processing at the next TTI is received
+     */
+    void resumeTtiTick();
+
     /*
      * Receives and handles RAC responses
      */
@@ -139,6 +203,73 @@ class LteMacUe : public LteMacBase
      * Checks RAC status
      */
     virtual void checkRAC();
+
+    /*
+     * Sends a SR on the UE's dedicated occasion if there is backlogged data.
+     * Used in place of checkRAC() when a SR configuration is assigned by the serving cell
+     */
+    virtual void checkSR();
+
+    /*
+     * Returns the priority level of the highest-priority connection with queued data,
+     * carried in RAC requests and SRs so that the eNB can serve them in priority order
+     */
+    int getBackloggedPriorityLevel() const;
+
+    /*
+     * Returns the QFI of the highest-priority connection with queued data (-1 if none),
+     * carried in RAC requests and SRs so that the eNB can serve them on the bandwidth part of that QFI
+     */
+    int getBackloggedQfi() const;
+
+    /*
+     * Accounts the arrival of new data for the given connection and triggers a BSR
+     * if one of the event-driven conditions is met
+     */
+    void checkBsrOnNewData(MacCid cid, unsigned int bytes);
+
+    /*
+     * Triggers a periodic BSR if the timer has expired and data is queued
+     */
+    void checkPeriodicBsr();
+
+    /*
+     * Returns the size to be reported in a BSR carrying a single size for a backlog of <size> bytes
+     * (e.g. a D2D BSR), quantized according to the configured buffer size table.
+     * ceBytes is set to the size of the corresponding control element
+     */
+    unsigned int getReportedBsrSize(unsigned int size, unsigned int& ceBytes) const;
+
+    /*
+     * Fills a UL BSR for a backlog of <size> bytes. The backlog of the UL connections is reported
+     * per LCG, each report given on the highest priority backlogged connection of its LCG, so that
+     * the eNB keeps it on a DRB with a known QFI. With the short table, the whole backlog is given on
+     * the highest priority backlogged connection. Without UL backlog, only the size is reported.
+     * ceBytes is set to the size of the corresponding control element
+     */
+    void setUlBsrReports(MacBsr *bsr, unsigned int size, unsigned int& ceBytes) const;
+
+    /*
+     * Records that a BSR control element of <ceBytes> bytes has been added to a MAC PDU
+     */
+    void bsrSent(unsigned int ceBytes);
+
+    /*
+     * Sets the BSR retransmission timer after a MAC PDU has been built.
+     * With event-driven BSRs, the timer is also started when the eNB has already
+     * been informed about (part of) the remaining backlog
+     */
+    void updateBsrRtxTimer(bool bsrMade, unsigned int backlog);
+
+    /*
+     * Returns true if the current slot is a SR occasion for this UE
+     */
+    bool isSrOccasion() const;
+
+    /*
+     * Retrieves the SR configuration from the serving cell
+     */
+    virtual void configureSr();
     /*
      * Update UserTxParam stored in every lteMacPdu when an RTX changes this information
      */
@@ -171,6 +302,14 @@ class LteMacUe : public LteMacBase
         return currentHarq_;
     }
 
+    /*
+     * Triggers the BSR for the given connection
+     */
+    virtual void triggerBsr(MacCid cid)
+    {
+        bsrTriggered_ = true;
+    }
+
     /*
      * Access BSR trigger flag
      */
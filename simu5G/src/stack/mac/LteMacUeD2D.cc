@@ -13,6 +13,7 @@
 
 #include "stack/mac/buffer/harq/LteHarqBufferRx.h"
 #include "stack/mac/buffer/LteMacQueue.h"
+#include "stack/mac/packet/LteHarqFeedback_m.h"
 #include "stack/mac/packet/LteRac_m.h"
 #include "stack/mac/packet/LteSchedulingGrant.h"
 #include "stack/mac/scheduler/LteSchedulerUeUl.h"
@@ -100,6 +101,7 @@ void LteMacUeD2D::macPduMake(MacCid cid)
             if (bsrTriggered_ || bsrD2DMulticastTriggered_) {
                 // Compute BSR size taking into account only DM flows
                 int sizeBsr = 0;
+                int32_t multicastGroupId = -1;
                 for (const auto& itbsr : macBuffers_) {
                     MacCid cid = itbsr.first;
                     Direction connDir = (Direction)connDesc_[cid].getDirection();
@@ -109,6 +111,8 @@ void LteMacUeD2D::macPduMake(MacCid cid)
                         continue;
                     if (bsrD2DMulticastTriggered_ && connDir != D2D_MULTI)
                         continue;
+                    if (connDir == D2D_MULTI)
+                        multicastGroupId = connDesc_[cid].getMulticastGroupId();
 
                     sizeBsr += itbsr.second->getQueueOccupancy();
 
@@ -123,7 +127,8 @@ void LteMacUeD2D::macPduMake(MacCid cid)
 
                 if (sizeBsr > 0) {
                     // Call the appropriate function to make a BSR for a D2D communication
-                    auto macPktBsr = makeBsr(sizeBsr);
+                    unsigned int ceBytes;
+                    auto macPktBsr = makeBsr(getReportedBsrSize(sizeBsr, ceBytes));
                     auto info = macPktBsr->getTagForUpdate<UserControlInfo>();
                     double carrierFreq = gitem.first;
                     if (info != nullptr) {
@@ -131,6 +136,8 @@ void LteMacUeD2D::macPduMake(MacCid cid)
                         info->setUserTxParams(gitem.second->getUserTxParams()->dup());
                         if (bsrD2DMulticastTriggered_) {
                             info->setLcid(D2D_MULTI_SHORT_BSR);
+                            // let the eNB know which group will be served by the grant
+                            info->setMulticastGroupId(multicastGroupId);
                             bsrD2DMulticastTriggered_ = false;
                         }
                         else
@@ -146,6 +153,7 @@ void LteMacUeD2D::macPduMake(MacCid cid)
                         else
                             macPduList_[channelModel->getCarrierFrequency()][{getMacCellId(), 0}] = macPktBsr;
                         bsrAlreadyMade = true;
+                        bsrSent(ceBytes);
                         EV << "LteMacUeD2D::macPduMake - BSR D2D created with size " << sizeBsr << " bytes created" << endl;
                     }
 
@@ -379,19 +387,18 @@ void LteMacUeD2D::macPduMake(MacCid cid)
             // Attach BSR to PDU if RAC is won and wasn't already made
             if ((bsrTriggered_ || bsrD2DMulticastTriggered_) && !bsrAlreadyMade && size > 0) {
                 MacBsr *bsr = new MacBsr();
+                unsigned int ceBytes;
                 bsr->setTimestamp(simTime().dbl());
-                bsr->setSize(size);
+                setUlBsrReports(bsr, size, ceBytes);
                 header->pushCe(bsr);
                 bsrTriggered_ = false;
                 bsrD2DMulticastTriggered_ = false;
                 bsrAlreadyMade = true;
+                bsrSent(ceBytes);
                 EV << "LteMacUeD2D::macPduMake - BSR created with size " << size << endl;
             }
 
-            if (bsrAlreadyMade && size > 0)                                              // this prevents the UE from sending an unnecessary RAC request
-                bsrRtxTimer_ = bsrRtxTimerStart_;
-            else
-                bsrRtxTimer_ = 0;
+            updateBsrRtxTimer(bsrAlreadyMade, size);
 
             macPkt->insertAtFront(header);
 
@@ -427,6 +434,8 @@ void LteMacUeD2D::handleMessage(cMessage *msg)
         auto userInfo = pkt->getTag<UserControlInfo>();
 
         if (userInfo->getFrameType() == D2DMODESWITCHPKT) {
+            resumeTtiTick();
+
             EV << "LteMacUeD2D::handleMessage - Received packet " << pkt->getName() <<
                 " from port " << pkt->getArrivalGate()->getName() << endl;
 
@@ -462,17 +471,16 @@ void LteMacUeD2D::macHandleGrant(cPacket *pktAux)
 
     // store received grant
     schedulingGrant_[carrierFrequency] = grant;
-    if (grant->getPeriodic()) {
-        periodCounter_[carrierFrequency] = grant->getPeriod();
-        expirationCounter_[carrierFrequency] = grant->getExpiration();
-    }
+    if (grant->getPeriodic())
+        configurePeriodicGrant(grant.get(), carrierFrequency);
 
     EV << NOW << " Node " << nodeId_ << " received grant of blocks " << grant->getTotalGrantedBlocks()
        << ", bytes " << grant->getGrantedCwBytes(0) << " Direction: " << dirToA(grant->getDirection()) << endl;
 
-    // clearing pending RAC requests
+    // clearing pending RAC requests and SRs
     racRequested_ = false;
     racD2DMulticastRequested_ = false;
+    srProhibitTimer_ = 0;
 
     delete pkt;
 }
@@ -482,6 +490,12 @@ void LteMacUeD2D::checkRAC()
     EV << NOW << " LteMacUeD2D::checkRAC , Ue  " << nodeId_ << ", racTimer : " << racBackoffTimer_ << " maxRacTryOuts : " << maxRacTryouts_
        << ", raRespTimer:" << raRespTimer_ << endl;
 
+    // a dedicated SR configuration replaces the contention-based access
+    if (srPeriodicity_ > 0) {
+        checkSR();
+        return;
+    }
+
     if (racBackoffTimer_ > 0) {
         racBackoffTimer_--;
         return;
@@ -543,6 +557,7 @@ void LteMacUeD2D::checkRAC()
         pkt->addTagIfAbsent<UserControlInfo>()->setFrameType(RACPKT);
 
         auto racReq = makeShared<LteRac>();
+        racReq->setPriorityLevel(getBackloggedPriorityLevel());
 
         pkt->insertAtFront(racReq);
         sendLowerPackets(pkt);
@@ -610,6 +625,10 @@ void LteMacUeD2D::handleSelfMessage()
 
     EV << NOW << " LteMacUeD2D::handleSelfMessage " << nodeId_ << " - HARQ process " << (unsigned int)currentHarq_ << endl;
 
+    sendMulticastReports();
+
+    checkPeriodicBsr();
+
     // no grant available - if user has backlogged data, it will trigger scheduling request
     // no HARQ counter is updated since no transmission is sent.
 
@@ -627,43 +646,12 @@ void LteMacUeD2D::handleSelfMessage()
         // TODO ensure all operations done before return (i.e. move H-ARQ RX purge before this point)
     }
     else {
-        bool periodicGrant = false;
         bool checkRac = false;
-        bool skip = false;
-        for (auto& git : schedulingGrant_) {
-            if (git.second != nullptr && git.second->getPeriodic()) {
-                periodicGrant = true;
-                double carrierFreq = git.first;
-
-                // Periodic checks
-                if (--expirationCounter_[carrierFreq] < 0) {
-                    // Periodic grant is expired
-                    git.second = nullptr;
-                    // if necessary, a RAC request will be sent to obtain a grant
-                    checkRac = true;
-                    //return;
-                }
-                else if (--periodCounter_[carrierFreq] > 0) {
-                    skip = true;
-                }
-                else {
-                    // resetting grant period
-                    periodCounter_[carrierFreq] = git.second->getPeriod();
-                    // this is periodic grant TTI - continue with frame sending
-                    checkRac = false;
-                    skip = false;
-                    break;
-                }
-            }
-        }
-        if (periodicGrant) {
-            if (checkRac)
-                checkRAC();
-            else {
-                if (skip)
-                    return;
-            }
-        }
+        bool skip = checkPeriodicGrants(checkRac);
+        if (checkRac)
+            checkRAC();
+        else if (skip)
+            return;
     }
 
     scheduleList_.clear();
@@ -692,25 +680,16 @@ void LteMacUeD2D::handleSelfMessage()
                 EV << "\t Looking for retx in acid " << (unsigned int)currentHarq_ << endl;
                 currHarq = it2.second;
 
-                // check if the current process has unit ready for retx
-                bool ready = currHarq->getProcess(currentHarq_)->hasReadyUnits();
-                CwList cwListRetx = currHarq->getProcess(currentHarq_)->readyUnitsIds();
+                // check if the current process has units ready for retx in the same direction as the grant
+                Direction grantDir = (Direction)schedulingGrant_[carrierFrequency]->getDirection();
+                bool ready = currHarq->getReadyProcesses(grantDir).count(currentHarq_) > 0;
+                CwList cwListRetx = ready ? currHarq->getProcess(currentHarq_)->readyUnitsIds(grantDir) : CwList();
 
                 EV << "\t [process=" << (unsigned int)currentHarq_ << "] , [retx=" << (ready ? "true" : "false")
-                   << "] , [n=" << cwListRetx.size() << "]" << endl;
-
-                // check if one 'ready' unit has the same direction as the grant
-                bool checkDir = false;
-                for (Codeword cw : cwListRetx) {
-                    auto info = currHarq->getProcess(currentHarq_)->getPdu(cw)->getTag<UserControlInfo>();
-                    if (info->getDirection() == schedulingGrant_[carrierFrequency]->getDirection()) {
-                        checkDir = true;
-                        break;
-                    }
-                }
+                   << "] , [n=" << cwListRetx.size() << "] , [dir=" << dirToA(grantDir) << "]" << endl;
 
                 // if a retransmission is needed
-                if (ready && checkDir) {
+                if (ready) {
                     UnitList signal;
                     signal.first = currentHarq_;
                     signal.second = cwListRetx;
@@ -1001,6 +980,59 @@ void LteMacUeD2D::macHandleD2DModeSwitch(cPacket *pktAux)
     delete pkt;
 }
 
+void LteMacUeD2D::recordMulticastOutcome(long macPduId, int32_t groupId, double carrierFrequency, unsigned char acid, Codeword cw, int64_t pduLength, bool delivered)
+{
+    Enter_Method_Silent("recordMulticastOutcome");
+
+    auto [it, inserted] = multicastOutcomes_.emplace(macPduId, MulticastOutcome{ groupId, carrierFrequency, acid, cw, pduLength, delivered, NOW });
+    if (!inserted)
+        it->second.delivered = it->second.delivered && delivered;
+}
+
+simtime_t LteMacUeD2D::getNextTtiTickTime() const
+{
+    if (!multicastOutcomes_.empty())
+        return NOW + ttiPeriod_;
+    return LteMacUe::getNextTtiTickTime();
+}
+
+void LteMacUeD2D::sendMulticastReports()
+{
+    for (auto it = multicastOutcomes_.begin(); it != multicastOutcomes_.end(); ) {
+        const MulticastOutcome& outcome = it->second;
+        if (outcome.firstReport == NOW) {
+            // other receivers may still report in this TTI
+            ++it;
+            continue;
+        }
+
+        // the eNB keeps no H-ARQ state for multicast PDUs: the report only feeds the group statistics
+        if (enb_ != nullptr && outcome.groupId >= 0) {
+            auto pkt = new Packet("MulticastHarqReport");
+            auto fb = makeShared<LteHarqFeedbackMirror>();
+            fb->setAcid(outcome.acid);
+            fb->setCw(outcome.cw);
+            fb->setResult(outcome.delivered);
+            fb->setFbMacPduId(it->first);
+            fb->setPduLength(outcome.pduLength);
+            fb->setD2dSenderId(nodeId_);
+            fb->setD2dReceiverId(NODEID_NONE);
+
+            pkt->insertAtFront(fb);
+            pkt->addTagIfAbsent<UserControlInfo>()->setSourceId(nodeId_);
+            pkt->addTagIfAbsent<UserControlInfo>()->setDestId(cellId_);
+            pkt->addTagIfAbsent<UserControlInfo>()->setFrameType(HARQPKT);
+            pkt->addTagIfAbsent<UserControlInfo>()->setCarrierFrequency(outcome.carrierFrequency);
+            pkt->addTagIfAbsent<UserControlInfo>()->setMulticastGroupId(outcome.groupId);
+
+            EV << NOW << " LteMacUeD2D::sendMulticastReports - UE " << nodeId_ << " group " << outcome.groupId << " PDU " << it->first
+               << (outcome.delivered ? " delivered" : " lost") << endl;
+            sendLowerPackets(pkt);
+        }
+        it = multicastOutcomes_.erase(it);
+    }
+}
+
 void LteMacUeD2D::doHandover(MacNodeId targetEnb)
 {
     if (targetEnb == NODEID_NONE)
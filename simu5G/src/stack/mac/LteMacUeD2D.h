@@ -42,6 +42,20 @@ class LteMacUeD2D : public LteMacUe
 
     static simsignal_t rcvdD2DModeSwitchNotificationSignal_;
 
+    // outcome of a multicast PDU sent by this UE, aggregated over the receivers of the group
+    struct MulticastOutcome
+    {
+        int32_t groupId;
+        double carrierFrequency;
+        unsigned char acid;
+        Codeword cw;
+        int64_t pduLength;
+        bool delivered;
+        simtime_t firstReport;
+    };
+    // multicast PDUs whose outcome has not been reported to the eNB yet, indexed by MAC PDU id
+    std::map<long, MulticastOutcome> multicastOutcomes_;
+
     // if true, use the preconfigured TX params for transmission, else use those signaled by the eNB
     bool usePreconfiguredTxParams_;
     UserTxParams *preconfiguredTxParams_ = nullptr;
@@ -77,6 +91,17 @@ class LteMacUeD2D : public LteMacUe
 
     void macHandleD2DModeSwitch(cPacket *pkt);
 
+    /**
+     * Sends to the eNB a single report for each multicast PDU whose receivers reported
+     * their outcome in a previous TTI: the PDU is delivered only if all of them decoded it
+     */
+    void sendMulticastReports();
+
+    /*
+     * The tick is not postponed to the next periodic grant occasion while multicast reports are pending
+     */
+    simtime_t getNextTtiTickTime() const override;
+
     virtual Packet *makeBsr(int size);
 
     /**
@@ -98,7 +123,7 @@ class LteMacUeD2D : public LteMacUe
         return true;
     }
 
-    virtual void triggerBsr(MacCid cid)
+    void triggerBsr(MacCid cid) override
     {
         if (connDesc_[cid].getDirection() == D2D_MULTI)
             bsrD2DMulticastTriggered_ = true;
@@ -107,6 +132,13 @@ class LteMacUeD2D : public LteMacUe
     }
 
     void doHandover(MacNodeId targetEnb) override;
+
+    /**
+     * Records the outcome of a multicast PDU sent by this UE at one of the receivers of the group.
+     * All the receivers evaluate the PDU in the same TTI, hence their outcomes are reported to the
+     * eNB together, at the next TTI
+     */
+    void recordMulticastOutcome(long macPduId, int32_t groupId, double carrierFrequency, unsigned char acid, Codeword cw, int64_t pduLength, bool delivered);
 };
 
 } //namespace
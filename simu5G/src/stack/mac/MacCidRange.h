@@ -0,0 +1,77 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_MACCIDRANGE_H_
+#define _LTE_MACCIDRANGE_H_
+
+#include <utility>
+
+// Since the node ID is the most significant part of the CID, the connections of a node are
+// contiguous in any container ordered by MacCid, hence they can be visited (or erased) in time
+// proportional to their number rather than to the size of the container.
+//
+// These helpers rely on idToMacCid() and MacCidToNodeId() (see common/LteCommon.h), which must
+// be declared before this file is included.
+
+namespace simu5g {
+
+// CID of an entry of a set (the entry itself) or of a map (its key)
+template<typename Key>
+const Key& nodeCidKey(const Key& entry)
+{
+    return entry;
+}
+
+template<typename Key, typename Value>
+const Key& nodeCidKey(const std::pair<const Key, Value>& entry)
+{
+    return entry.first;
+}
+
+/**
+ * Returns the first entry of a container ordered by MacCid that may belong to the given node.
+ */
+template<typename Container, typename NodeId>
+typename Container::iterator lowerBoundNodeCid(Container& container, NodeId nodeId)
+{
+    return container.lower_bound(idToMacCid(nodeId, 0));
+}
+
+/**
+ * Erases the entries of the given node from a container ordered by MacCid.
+ * @return the number of erased entries
+ */
+template<typename Container, typename NodeId>
+unsigned int eraseNodeCids(Container& container, NodeId nodeId)
+{
+    unsigned int erased = 0;
+    auto it = lowerBoundNodeCid(container, nodeId);
+    while (it != container.end() && MacCidToNodeId(nodeCidKey(*it)) == nodeId) {
+        it = container.erase(it);
+        erased++;
+    }
+    return erased;
+}
+
+/**
+ * Erases the entry of the given node from each map of a container of per-node maps
+ * (e.g. the per-carrier H-ARQ or RAC status of the UL scheduler).
+ */
+template<typename PerKeyMaps, typename NodeId>
+void eraseNodeFromEach(PerKeyMaps& maps, NodeId nodeId)
+{
+    for (auto& item : maps)
+        item.second.erase(nodeId);
+}
+
+} //namespace
+
+#endif
@@ -45,6 +45,10 @@ void NRMacUe::handleSelfMessage()
 
     EV << NOW << "NRMacUe::handleSelfMessage " << nodeId_ << " - HARQ process " << (unsigned int)currentHarq_ << endl;
 
+    sendMulticastReports();
+
+    checkPeriodicBsr();
+
     // no grant available - if user has backlogged data, it will trigger scheduling request
     // no HARQ counter is updated since no transmission is sent.
 
@@ -63,41 +67,12 @@ void NRMacUe::handleSelfMessage()
         // TODO ensure all operations done before return (i.e. move H-ARQ RX purge before this point)
     }
     else {
-        bool periodicGrant = false;
         bool checkRac = false;
-        bool skip = false;
-        for (auto& git : schedulingGrant_) {
-            if (git.second != nullptr && git.second->getPeriodic()) {
-                periodicGrant = true;
-                double carrierFreq = git.first;
-
-                // Periodic checks
-                if (--expirationCounter_[carrierFreq] < 0) {
-                    // Periodic grant is expired
-                    git.second = nullptr;
-                    checkRac = true;
-                }
-                else if (--periodCounter_[carrierFreq] > 0) {
-                    skip = true;
-                }
-                else {
-                    // resetting grant period
-                    periodCounter_[carrierFreq] = git.second->getPeriod();
-                    // this is periodic grant TTI - continue with frame sending
-                    checkRac = false;
-                    skip = false;
-                    break;
-                }
-            }
-        }
-        if (periodicGrant) {
-            if (checkRac)
-                checkRAC();
-            else {
-                if (skip)
-                    return;
-            }
-        }
+        bool skip = checkPeriodicGrants(checkRac);
+        if (checkRac)
+            checkRAC();
+        else if (skip)
+            return;
     }
 
     scheduleList_.clear();
@@ -127,37 +102,22 @@ void NRMacUe::handleSelfMessage()
                 continue;
 
             for (auto [it2Key, currHarq] : mtit.second) {
-                unsigned int numProcesses = currHarq->getNumProcesses();
-
-                for (unsigned int proc = 0; proc < numProcesses; proc++) {
-                    LteHarqProcessTx *currProc = currHarq->getProcess(proc);
+                // the first process with units ready for retransmission in the same direction as the grant
+                Direction grantDir = (Direction)schedulingGrant_[carrierFrequency]->getDirection();
+                const std::set<unsigned char>& readyProcesses = currHarq->getReadyProcesses(grantDir);
+                if (readyProcesses.empty())
+                    continue;
 
-                    // check if the current process has unit ready for retransmission
-                    bool ready = currProc->hasReadyUnits();
-                    CwList cwListRetx = currProc->readyUnitsIds();
+                unsigned char proc = *readyProcesses.begin();
+                CwList cwListRetx = currHarq->getProcess(proc)->readyUnitsIds(grantDir);
 
-                    EV << "\t [process=" << proc << "] , [retx=" << (ready ? "true" : "false") << "] , [n=" << cwListRetx.size() << "]" << endl;
+                EV << "\t [process=" << (unsigned int)proc << "] , [retx=true] , [n=" << cwListRetx.size() << "] , [dir=" << dirToA(grantDir) << "]" << endl;
 
-                    // check if one 'ready' unit has the same direction of the grant
-                    bool checkDir = false;
-                    for (Codeword cw : cwListRetx) {
-                        auto info = currProc->getPdu(cw)->getTag<UserControlInfo>();
-                        if (info->getDirection() == schedulingGrant_[carrierFrequency]->getDirection()) {
-                            checkDir = true;
-                            break;
-                        }
-                    }
-
-                    // if a retransmission is needed
-                    if (ready && checkDir) {
-                        UnitList signal;
-                        signal.first = proc;
-                        signal.second = cwListRetx;
-                        currHarq->markSelected(signal, schedulingGrant_[carrierFrequency]->getUserTxParams()->getLayers().size());
-                        retx = true;
-                        break;
-                    }
-                }
+                UnitList signal;
+                signal.first = proc;
+                signal.second = cwListRetx;
+                currHarq->markSelected(signal, schedulingGrant_[carrierFrequency]->getUserTxParams()->getLayers().size());
+                retx = true;
             }
         }
         // if no retransmission is needed, proceed with normal scheduling
@@ -307,6 +267,7 @@ void NRMacUe::macPduMake(MacCid cid)
             if (bsrTriggered_ || bsrD2DMulticastTriggered_) {
                 // Compute BSR size taking into account only DM flows
                 int sizeBsr = 0;
+                int32_t multicastGroupId = -1;
                 for (auto [cid, buffer] : macBuffers_) {
                     Direction connDir = (Direction)connDesc_[cid].getDirection();
 
@@ -315,6 +276,8 @@ void NRMacUe::macPduMake(MacCid cid)
                         continue;
                     if (bsrD2DMulticastTriggered_ && connDir != D2D_MULTI)
                         continue;
+                    if (connDir == D2D_MULTI)
+                        multicastGroupId = connDesc_[cid].getMulticastGroupId();
 
                     sizeBsr += buffer->getQueueOccupancy();
 
@@ -329,13 +292,16 @@ void NRMacUe::macPduMake(MacCid cid)
 
                 if (sizeBsr > 0) {
                     // Call the appropriate function for making a BSR for D2D communication
-                    Packet *macPktBsr = makeBsr(sizeBsr);
+                    unsigned int ceBytes;
+                    Packet *macPktBsr = makeBsr(getReportedBsrSize(sizeBsr, ceBytes));
                     auto info = macPktBsr->getTagForUpdate<UserControlInfo>();
                     if (info != nullptr) {
                         info->setCarrierFrequency(carrierFreq);
                         info->setUserTxParams(gitem.second->getUserTxParams()->dup());
                         if (bsrD2DMulticastTriggered_) {
                             info->setLcid(D2D_MULTI_SHORT_BSR);
+                            // let the eNB know which group will be served by the grant
+                            info->setMulticastGroupId(multicastGroupId);
                             bsrD2DMulticastTriggered_ = false;
                         }
                         else
@@ -350,6 +316,7 @@ void NRMacUe::macPduMake(MacCid cid)
                         else
                             macPduList_[channelModel->getCarrierFrequency()][{getMacCellId(), 0}] = macPktBsr;
                         bsrAlreadyMade = true;
+                        bsrSent(ceBytes);
                         EV << "NRMacUe::macPduMake - BSR D2D created with size " << sizeBsr << " created" << endl;
                     }
 
@@ -585,20 +552,18 @@ void NRMacUe::macPduMake(MacCid cid)
             // Attach BSR to PDU if RAC is won and wasn't already made
             if ((bsrTriggered_ || bsrD2DMulticastTriggered_) && !bsrAlreadyMade && size > 0) {
                 MacBsr *bsr = new MacBsr();
+                unsigned int ceBytes;
                 bsr->setTimestamp(simTime().dbl());
-                bsr->setSize(size);
+                setUlBsrReports(bsr, size, ceBytes);
                 header->pushCe(bsr);
                 bsrTriggered_ = false;
                 bsrD2DMulticastTriggered_ = false;
                 bsrAlreadyMade = true;
+                bsrSent(ceBytes);
                 EV << "NRMacUe::macPduMake - BSR created with size " << size << endl;
             }
 
-            if (bsrAlreadyMade && size > 0) { // this prevents the UE from sending an unnecessary RAC request
-                bsrRtxTimer_ = bsrRtxTimerStart_;
-            }
-            else
-                bsrRtxTimer_ = 0;
+            updateBsrRtxTimer(bsrAlreadyMade, size);
 
             macPkt->insertAtFront(header);
 
@@ -33,6 +33,7 @@ void LteAllocationModule::init(const unsigned int resourceBlocks, const unsigned
 
     // initialize number of bands
     bands_ = bands;
+    resetActiveBands();
 
     // clear the OFDMA allocated blocks and set available planes to 1 (just the main OFDMA space)
     allocatedRbsMatrix_.clear();
@@ -236,6 +237,12 @@ unsigned int LteAllocationModule::computeTotalRbs()
 
 unsigned int LteAllocationModule::availableBlocks(const MacNodeId nodeId, const Remote antenna, const Band band)
 {
+    // bands outside the bandwidth part being scheduled cannot be used
+    if (band < activeFirstBand_ || band > activeLastBand_) {
+        EV << NOW << " LteAllocator::availableBlocks " << dirToA(dir_) << " - Band " << band << " is outside the active bandwidth part" << endl;
+        return 0;
+    }
+
     Plane plane = getOFDMPlane(nodeId);
 
     // blocks allocated in the current band
@@ -250,6 +257,18 @@ unsigned int LteAllocationModule::availableBlocks(const MacNodeId nodeId, const
     return 0;
 }
 
+void LteAllocationModule::setActiveBands(const Band firstBand, const Band lastBand)
+{
+    activeFirstBand_ = firstBand;
+    activeLastBand_ = lastBand;
+}
+
+void LteAllocationModule::resetActiveBands()
+{
+    activeFirstBand_ = 0;
+    activeLastBand_ = (bands_ > 0) ? Band(bands_ - 1) : 0;
+}
+
 unsigned int LteAllocationModule::getAllocatedBlocks(Plane plane, const Remote antenna, const Band band)
 {
     return allocatedRbsPerBand_[plane][antenna][band].allocated_;
@@ -40,6 +40,10 @@ class LteAllocationModule
     /// Operational Direction. Set via initialize().
     Direction dir_;
 
+    /// Range of bands where blocks can be allocated, i.e. the bandwidth part being scheduled
+    Band activeFirstBand_ = 0;
+    Band activeLastBand_ = 0;
+
     /// Flag that indicates when the data structures need to be reset in the next slot
     bool usedInLastSlot_ = false;
 
@@ -215,6 +219,12 @@ class LteAllocationModule
     unsigned int availableBlocks(const MacNodeId nodeId, const Remote antenna, const Band band);
     // ***************************************************************
 
+    // restricts the allocation to the given range of bands (bandwidth part)
+    void setActiveBands(const Band firstBand, const Band lastBand);
+
+    // makes all the bands available for allocation again
+    void resetActiveBands();
+
     // ************** Resource Blocks Allocation Methods **************
     // tries to satisfy the resource block request in the given band and for the given antenna
     bool addBlocks(const Remote antenna, const Band band, const MacNodeId nodeId, const unsigned int blocks,
@@ -256,6 +266,16 @@ class LteAllocationModule
         return allocatedRbsPerBand_[plane][antenna][band].ueAllocatedBytesMap_[nodeId];
     }
 
+    /*
+     * Returns the allocation info of the given UE in the current slot, nullptr if nothing
+     * has been allocated to it. Its per-band maps only contain the bands touched by the allocation.
+     */
+    const AllocatedRbsPerUeInfo *getAllocatedRbsPerUe(const MacNodeId nodeId) const
+    {
+        auto it = allocatedRbsUe_.find(nodeId);
+        return (it != allocatedRbsUe_.end()) ? &it->second : nullptr;
+    }
+
     // computes the amount of blocks allocated by the given UE
     unsigned int getBlocks(const MacNodeId nodeId)
     {
@@ -45,6 +45,9 @@ class AmcPilot
     //! contains for each user, the subset of Bands that will be considered in the AMC operations
     UsableBandsList usableBandsList_;
 
+    //! same content as usableBandsList_, as bitmasks. Rebuilt only when the usable bands of a node are set
+    std::map<MacNodeId, UsableBandsMask> usableBandsMaskList_;
+
     // specifies how the final CQI will be computed from the per band CQIs (e.g. AVG, MAX, MIN)
     PilotComputationModes mode_;
 
@@ -86,6 +89,12 @@ class AmcPilot
     virtual void setUsableBands(MacNodeId id, UsableBands usableBands) = 0;
     virtual UsableBands *getUsableBands(MacNodeId id) = 0;
 
+    /**
+     * Returns the same bands as getUsableBands(), as a bitmask that allows checking
+     * a band in constant time. nullptr if all bands are usable.
+     */
+    virtual const UsableBandsMask *getUsableBandsMask(MacNodeId id) = 0;
+
     void setMode(PilotComputationModes mode) { mode_ = mode; }
 };
 
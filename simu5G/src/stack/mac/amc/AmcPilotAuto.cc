@@ -219,35 +219,35 @@ void AmcPilotAuto::setUsableBands(MacNodeId id, UsableBands usableBands)
         EV << usableBand << ",";
     }
     EV << "]" << endl;
-    UsableBandsList::iterator it = usableBandsList_.find(id);
 
-    // if usable bands for this node are already set, delete it (probably unnecessary)
-    if (it != usableBandsList_.end())
-        usableBandsList_.erase(id);
-    usableBandsList_.insert({id, usableBands});
+    UsableBandsMask& mask = usableBandsMaskList_[id];
+    mask.clear();
+    for (unsigned short usableBand : usableBands) {
+        if (usableBand >= mask.size())
+            mask.resize(usableBand + 1, false);
+        mask[usableBand] = true;
+    }
+
+    usableBandsList_[id] = std::move(usableBands);
+}
+
+UsableBandsList::iterator AmcPilotAuto::findUsableBands(MacNodeId id)
+{
+    UsableBandsList::iterator it = usableBandsList_.find(id);
+    if (it == usableBandsList_.end() && getNodeTypeById(id) == UE) {
+        // usable bands for this id not found: if it is a UE, look for its serving cell
+        MacNodeId cellId = binder_->getNextHop(id);
+        it = usableBandsList_.find(cellId);
+    }
+    return it;
 }
 
 UsableBands *AmcPilotAuto::getUsableBands(MacNodeId id)
 {
     EV << NOW << " AmcPilotAuto::getUsableBands - getting usable bands for node " << id;
 
-    bool found = false;
-    UsableBandsList::iterator it = usableBandsList_.find(id);
+    UsableBandsList::iterator it = findUsableBands(id);
     if (it != usableBandsList_.end()) {
-        found = true;
-    }
-    else {
-        // usable bands for this id not found
-        if (getNodeTypeById(id) == UE) {
-            // if it is a UE, look for its serving cell
-            MacNodeId cellId = binder_->getNextHop(id);
-            it = usableBandsList_.find(cellId);
-            if (it != usableBandsList_.end())
-                found = true;
-        }
-    }
-
-    if (found) {
         EV << " [";
         for (Band i : it->second) {
             EV << i << ",";
@@ -261,5 +261,13 @@ UsableBands *AmcPilotAuto::getUsableBands(MacNodeId id)
     return nullptr;
 }
 
+const UsableBandsMask *AmcPilotAuto::getUsableBandsMask(MacNodeId id)
+{
+    UsableBandsList::iterator it = findUsableBands(id);
+    if (it == usableBandsList_.end())
+        return nullptr;
+    return &usableBandsMaskList_.at(it->first);
+}
+
 } //namespace
 
@@ -31,6 +31,14 @@ namespace simu5g {
  */
 class AmcPilotAuto : public AmcPilot
 {
+  protected:
+
+    /*
+     * Returns the entry of usableBandsList_ that applies to the given node: its own one
+     * or, for a UE, the one of its serving eNB. Returns usableBandsList_.end() if none.
+     */
+    UsableBandsList::iterator findUsableBands(MacNodeId id);
+
   public:
 
     /**
@@ -70,6 +78,8 @@ class AmcPilotAuto : public AmcPilot
      */
     UsableBands *getUsableBands(MacNodeId id) override;
 
+    const UsableBandsMask *getUsableBandsMask(MacNodeId id) override;
+
     // Returns a vector with one CQI for each band (for the given user).
     std::vector<Cqi> getMultiBandCqi(MacNodeId id, const Direction dir, double carrierFrequency) override;
 };
@@ -52,6 +52,7 @@ class AmcPilotD2D : public AmcPilot
     std::vector<Cqi> getMultiBandCqi(MacNodeId id, const Direction dir, double carrierFrequency) override { std::vector<Cqi> result; return result; }
     void setUsableBands(MacNodeId id, UsableBands usableBands) override {}
     UsableBands *getUsableBands(MacNodeId id) override { return nullptr; }
+    const UsableBandsMask *getUsableBandsMask(MacNodeId id) override { return nullptr; }
 };
 
 } //namespace
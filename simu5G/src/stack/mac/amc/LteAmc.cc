@@ -9,10 +9,13 @@
 // and cannot be removed from it.
 //
 //
+#include <algorithm>
+
 #include <omnetpp.h>
 
 #include "stack/mac/amc/LteAmc.h"
 #include "stack/mac/LteMacEnb.h"
+#include "stack/sdap/common/QfiContextManager.h"
 
 // NOTE: AMC Pilots header file inclusions must go here
 #include "stack/mac/amc/AmcPilotAuto.h"
@@ -195,6 +198,10 @@ LteAmc& LteAmc::operator=(const LteAmc& other)
     mcsScaleDl_ = other.mcsScaleDl_;
     mcsScaleUl_ = other.mcsScaleUl_;
     mcsScaleD2D_ = other.mcsScaleD2D_;
+    targetBler_ = other.targetBler_;
+    cqiBackoffPerDecade_ = other.cqiBackoffPerDecade_;
+    qfiLinkAdaptation_ = other.qfiLinkAdaptation_;
+    cqiSubbandSize_ = other.cqiSubbandSize_;
     numAntennas_ = other.numAntennas_;
     remoteSet_ = other.remoteSet_;
     dlConnectedUe_ = other.dlConnectedUe_;
@@ -258,6 +265,13 @@ void LteAmc::initialize()
     allocationType_ = getRbAllocationType(mac_->par("rbAllocationType").stringValue());
     lb_ = mac_->par("summaryLowerBound");
     ub_ = mac_->par("summaryUpperBound");
+    targetBler_ = mac_->par("targetBler");
+    cqiBackoffPerDecade_ = mac_->par("cqiBackoffPerDecade");
+    qfiLinkAdaptation_ = mac_->par("qfiLinkAdaptation");
+    int cqiSubbandSize = mac_->par("cqiSubbandSize").intValue();
+    if (cqiSubbandSize < 0)
+        throw cRuntimeError("LteAmc::initialize - invalid cqiSubbandSize %d", cqiSubbandSize);
+    cqiSubbandSize_ = cqiSubbandSize;
 
     printParameters();
 
@@ -391,6 +405,10 @@ void LteAmc::pushFeedback(MacNodeId id, Direction dir, LteFeedback fb, double ca
     EV << "index: " << index << endl;
     (*history)[antenna].at(index).at(txMode).put(fb);
 
+    // the sub-band CQIs of this UE are rebuilt on the next lookup
+    subbandCqi_[dir][carrierFrequency].erase(id);
+    feedbackCount_[dir][carrierFrequency][id]++;
+
     // delete the old UserTxParam for this <UE_dir_carrierFreq>, so that it will be recomputed next time it's needed
     std::map<double, std::vector<UserTxParams>> *txParams = (dir == DL) ? &dlTxParams_ : (dir == UL) ? &ulTxParams_ : throw cRuntimeError("LteAmc::pushFeedback(): Unrecognized direction");
     if (txParams->find(carrierFrequency) != txParams->end() && txParams->at(carrierFrequency).at(index).isSet())
@@ -573,11 +591,71 @@ const UserTxParams& LteAmc::computeTxParams(MacNodeId id, const Direction dir, d
     id = nh;
 
     const UserTxParams& info = pilot_->computeTxParams(id, dir, carrierFrequency);
+
+    // per-QFI link adaptation: the grant of this UE is served with a more conservative CQI
+    if ((dir == DL || dir == UL) && !grantCqiBackoff_[dir].empty()) {
+        auto it = grantCqiBackoff_[dir].find(id);
+        if (it != grantCqiBackoff_[dir].end()) {
+            std::vector<Cqi> cqi = info.readCqiVector();
+            for (auto& c : cqi) {
+                if (c > 0)
+                    c = std::max(1, (int)c - (int)it->second);
+            }
+            EV << NOW << " LteAmc::computeTxParams CQI back-off: " << it->second << "\n";
+
+            UserTxParams& backoffInfo = backoffTxParams_[dir][{id, carrierFrequency}];
+            backoffInfo = info;
+            backoffInfo.writeCqi(cqi);
+            EV << NOW << " LteAmc::computeTxParams --------------::[  END  ]::--------------\n";
+            return backoffInfo;
+        }
+    }
     EV << NOW << " LteAmc::computeTxParams --------------::[  END  ]::--------------\n";
 
     return info;
 }
 
+unsigned int LteAmc::getCqiBackoff(MacCid cid)
+{
+    if (!qfiLinkAdaptation_)
+        return 0;
+
+    auto it = cidCqiBackoff_.find(cid);
+    if (it != cidCqiBackoff_.end())
+        return it->second;
+
+    // the QFI of a connection does not change: resolve it once
+    QfiContextManager *mgr = QfiContextManager::getInstance();
+    int qfi = mgr->getQfiForCid(cid);
+    const QfiContext *context = (qfi >= 0) ? mgr->getContextByQfi(qfi) : nullptr;
+    if (context == nullptr)
+        return 0;   // not registered yet, do not cache
+
+    // one back-off step per decade between the BLER target of the cell and the PER target of the QFI,
+    // as given in the QFI context file. QFIs without a PER target use the BLER target of the cell
+    double per = (context->packetErrorRate > 0) ? context->packetErrorRate : targetBler_;
+    double backoff = std::round(cqiBackoffPerDecade_ * log10(targetBler_ / per));
+    unsigned int cqiBackoff = (unsigned int)std::min(std::max(backoff, 0.0), 14.0);
+    EV << "LteAmc::getCqiBackoff - QFI " << qfi << " PER " << per << " CQI back-off " << cqiBackoff << endl;
+    cidCqiBackoff_[cid] = cqiBackoff;
+    return cqiBackoff;
+}
+
+void LteAmc::setGrantCqiBackoff(MacNodeId id, Direction dir, unsigned int backoff)
+{
+    if (backoff == 0 || (dir != DL && dir != UL))
+        return;
+
+    // a UE served for several QFIs in the same slot uses the most conservative CQI
+    unsigned int& grantBackoff = grantCqiBackoff_[dir][id];
+    grantBackoff = std::max(grantBackoff, backoff);
+}
+
+void LteAmc::resetGrantCqiBackoff(Direction dir)
+{
+    grantCqiBackoff_[dir].clear();
+}
+
 /*******************************************
 *      Scheduler interface functions      *
 *******************************************/
@@ -731,7 +809,7 @@ unsigned int LteAmc::computeBitsOnNRbs_MB(MacNodeId id, Band b, unsigned int blo
     EV << NOW << " LteAmc::computeBitsOnNRbs_MB Band: " << b << "\n";
     EV << NOW << " LteAmc::computeBitsOnNRbs_MB Direction: " << dirToA(dir) << "\n";
 
-    Cqi cqi = readMultiBandCqi(id, dir, carrierFrequency)[b];
+    Cqi cqi = readBandCqi(id, b, dir, carrierFrequency);
 
     // Acquiring current user scheduling information
     UserTxParams info = computeTxParams(id, dir, carrierFrequency);
@@ -798,6 +876,11 @@ UsableBands *LteAmc::getPilotUsableBands(MacNodeId id)
     return pilot_->getUsableBands(id);
 }
 
+const UsableBandsMask *LteAmc::getPilotUsableBandsMask(MacNodeId id)
+{
+    return pilot_->getUsableBandsMask(id);
+}
+
 unsigned int LteAmc::getItbsPerCqi(Cqi cqi, const Direction dir)
 {
     // CQI threshold table selection
@@ -1028,7 +1111,154 @@ Cqi LteAmc::readWbCqi(const CqiVector& cqi)
 
 std::vector<Cqi> LteAmc::readMultiBandCqi(MacNodeId id, const Direction dir, double carrierFrequency)
 {
-    return pilot_->getMultiBandCqi(id, dir, carrierFrequency);
+    if (cqiSubbandSize_ <= 1 || (dir != DL && dir != UL))
+        return pilot_->getMultiBandCqi(id, dir, carrierFrequency);
+
+    // each band gets the CQI of its sub-band
+    const std::vector<Cqi>& subbandCqi = readSubbandCqi(id, dir, carrierFrequency);
+    std::vector<Cqi> cqi;
+    cqi.reserve(subbandCqi.size() * cqiSubbandSize_);
+    for (Cqi c : subbandCqi)
+        cqi.insert(cqi.end(), cqiSubbandSize_, c);
+    cqi.resize(std::min<size_t>(cqi.size(), numBands_));
+    return cqi;
+}
+
+unsigned int LteAmc::getFeedbackCount(MacNodeId id, const Direction dir, double carrierFrequency)
+{
+    if (dir != DL && dir != UL)
+        throw cRuntimeError("LteAmc::getFeedbackCount(): Unrecognized direction");
+
+    // feedback is stored for the next hop
+    auto cit = feedbackCount_[dir].find(carrierFrequency);
+    if (cit == feedbackCount_[dir].end())
+        return 0;
+    auto it = cit->second.find(getNextHop(id));
+    return (it != cit->second.end()) ? it->second : 0;
+}
+
+const std::vector<Cqi>& LteAmc::readSubbandCqi(MacNodeId id, const Direction dir, double carrierFrequency)
+{
+    if (dir != DL && dir != UL)
+        throw cRuntimeError("LteAmc::readSubbandCqi(): Unrecognized direction");
+
+    // feedback is stored for the next hop
+    id = getNextHop(id);
+    std::vector<Cqi>& subbandCqi = subbandCqi_[dir][carrierFrequency][id];
+    if (!subbandCqi.empty())
+        return subbandCqi;
+
+    // a sub-band is reported with the lowest CQI of its bands, i.e. the highest one
+    // that can be decoded on all of them
+    std::vector<Cqi> bandCqi = pilot_->getMultiBandCqi(id, dir, carrierFrequency);
+    unsigned int size = std::max(cqiSubbandSize_, 1u);
+    subbandCqi.reserve((bandCqi.size() + size - 1) / size);
+    for (unsigned int b = 0; b < bandCqi.size(); b += size) {
+        auto end = bandCqi.begin() + std::min<size_t>(b + size, bandCqi.size());
+        subbandCqi.push_back(*std::min_element(bandCqi.begin() + b, end));
+    }
+    return subbandCqi;
+}
+
+Cqi LteAmc::readBandCqi(MacNodeId id, Band b, const Direction dir, double carrierFrequency)
+{
+    if (dir != DL && dir != UL)
+        return pilot_->getMultiBandCqi(id, dir, carrierFrequency).at(b);
+
+    return readSubbandCqi(id, dir, carrierFrequency).at(b / std::max(cqiSubbandSize_, 1u));
+}
+
+Cqi LteAmc::readGrantBandCqi(MacNodeId id, Band b, const Direction dir, double carrierFrequency)
+{
+    Cqi cqi = readBandCqi(id, b, dir, carrierFrequency);
+    auto it = grantCqiBackoff_[dir].find(getNextHop(id));
+    if (it != grantCqiBackoff_[dir].end() && cqi > 0)
+        cqi = std::max(1, (int)cqi - (int)it->second);
+    return cqi;
+}
+
+double LteAmc::getSubbandScaling(MacNodeId id, Band b, Codeword cw, const Direction dir, double carrierFrequency)
+{
+    // the transport block is rescaled by the ratio between the spectral efficiency of the
+    // sub-band CQI and that of the wideband CQI, so that the MCS tables, the layers and the
+    // CQI back-off of the grant are accounted for as in computeBytesOnNRbs()
+    const UserTxParams& info = computeTxParams(id, dir, carrierFrequency);
+    Cqi widebandCqi = info.readCqiVector().at(cw);
+    Cqi subbandCqi = readGrantBandCqi(id, b, dir, carrierFrequency);
+
+    unsigned int widebandBits = computeBitsPerRbBackground(widebandCqi, dir, carrierFrequency);
+    if (widebandBits == 0)
+        return 1.0;
+    unsigned int subbandBits = computeBitsPerRbBackground(subbandCqi, dir, carrierFrequency);
+
+    EV << NOW << " LteAmc::getSubbandScaling Node " << id << ", Band " << b << ", Codeword " << cw << " - wideband CQI " << widebandCqi << ", sub-band CQI " << subbandCqi << endl;
+    return (double)subbandBits / widebandBits;
+}
+
+unsigned int LteAmc::computeBytesOnSubband(MacNodeId id, Band b, unsigned int blocks, const Direction dir, double carrierFrequency)
+{
+    unsigned int bytes = computeBytesOnNRbs(id, b, blocks, dir, carrierFrequency);
+    if (cqiSubbandSize_ == 0 || bytes == 0 || (dir != DL && dir != UL))
+        return bytes;
+
+    return (unsigned int)(bytes * getSubbandScaling(id, b, 0, dir, carrierFrequency));
+}
+
+unsigned int LteAmc::computeBytesOnSubband(MacNodeId id, Band b, Codeword cw, unsigned int blocks, const Direction dir, double carrierFrequency)
+{
+    unsigned int bytes = computeBytesOnNRbs(id, b, cw, blocks, dir, carrierFrequency);
+    if (cqiSubbandSize_ == 0 || bytes == 0 || (dir != DL && dir != UL))
+        return bytes;
+
+    return (unsigned int)(bytes * getSubbandScaling(id, b, cw, dir, carrierFrequency));
+}
+
+UserTxParams LteAmc::computeGrantTxParams(MacNodeId id, const std::vector<std::pair<Band, unsigned int>>& bands, const Direction dir,
+        double carrierFrequency, std::vector<unsigned int>& cwBytes)
+{
+    UserTxParams info = computeTxParams(id, dir, carrierFrequency);
+    std::vector<Cqi> cqi = info.readCqiVector();
+    cwBytes.assign(cqi.size(), 0);
+
+    for (Codeword cw = 0; cw < cqi.size(); ++cw) {
+        unsigned int widebandBits = computeBitsPerRbBackground(cqi[cw], dir, carrierFrequency);
+        if (cqiSubbandSize_ == 0 || (dir != DL && dir != UL) || widebandBits == 0) {
+            for (const auto& [b, blocks] : bands)
+                cwBytes[cw] += computeBytesOnNRbs(id, b, cw, blocks, dir, carrierFrequency);
+            continue;
+        }
+
+        // average bits per block of the allocation, each block at the CQI of its sub-band
+        double bits = 0;
+        unsigned int totalBlocks = 0;
+        Cqi maxCqi = 1;
+        for (const auto& [b, blocks] : bands) {
+            Cqi bandCqi = readGrantBandCqi(id, b, dir, carrierFrequency);
+            bits += (double)computeBitsPerRbBackground(bandCqi, dir, carrierFrequency) * blocks;
+            totalBlocks += blocks;
+            maxCqi = std::max(maxCqi, bandCqi);
+        }
+        if (totalBlocks == 0)
+            continue;
+
+        Cqi effectiveCqi = 1;
+        for (Cqi c = 2; c <= maxCqi; ++c) {
+            if (computeBitsPerRbBackground(c, dir, carrierFrequency) <= bits / totalBlocks)
+                effectiveCqi = c;
+        }
+
+        // the transport block is sized on the effective CQI
+        double ratio = (double)computeBitsPerRbBackground(effectiveCqi, dir, carrierFrequency) / widebandBits;
+        for (const auto& [b, blocks] : bands)
+            cwBytes[cw] += (unsigned int)(computeBytesOnNRbs(id, b, cw, blocks, dir, carrierFrequency) * ratio);
+
+        EV << NOW << " LteAmc::computeGrantTxParams Node " << id << ", Codeword " << cw << " - wideband CQI " << cqi[cw]
+           << ", effective CQI " << effectiveCqi << " on " << totalBlocks << " blocks" << endl;
+        cqi[cw] = effectiveCqi;
+    }
+
+    info.writeCqi(cqi);
+    return info;
 }
 
 void LteAmc::writePmiWeight(const double weight)
@@ -1105,6 +1335,14 @@ void LteAmc::detachUser(MacNodeId nodeId, Direction dir)
     EV << "##################################" << endl;
     EV << "# LteAmc::detachUser. Id: " << nodeId << ", direction: " << dirToA(dir) << endl;
     EV << "##################################" << endl;
+
+    if (dir == DL || dir == UL) {
+        for (auto& [carrierFrequency, subbandCqi] : subbandCqi_[dir])
+            subbandCqi.erase(nodeId);
+        for (auto& [carrierFrequency, feedbackCount] : feedbackCount_[dir])
+            feedbackCount.erase(nodeId);
+    }
+
     try {
         ConnectedUesMap *connectedUe;
         std::map<double, std::vector<UserTxParams>> *userInfoVec;
@@ -1161,6 +1399,15 @@ void LteAmc::detachUser(MacNodeId nodeId, Direction dir)
         for (auto& item : *userInfoVec) {
             item.second.at(nodeIndex).restoreDefaultValues();
         }
+
+        // clear the per-QFI link adaptation state of this UE
+        eraseNodeCids(cidCqiBackoff_, nodeId);
+        if (dir == DL || dir == UL) {
+            grantCqiBackoff_[dir].erase(nodeId);
+            auto tit = backoffTxParams_[dir].lower_bound(std::make_pair(nodeId, 0.0));
+            while (tit != backoffTxParams_[dir].end() && tit->first.first == nodeId)
+                tit = backoffTxParams_[dir].erase(tit);
+        }
     }
     catch (std::exception& e) {
         throw cRuntimeError("Exception in LteAmc::detachUser(): %s", e.what());
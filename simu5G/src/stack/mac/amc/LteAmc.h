@@ -12,6 +12,8 @@
 #ifndef _LTE_LTEAMC_H_
 #define _LTE_LTEAMC_H_
 
+#include <map>
+
 #include <omnetpp.h>
 
 #include "common/cellInfo/CellInfo.h"
@@ -106,6 +108,45 @@ class LteAmc
 
     History_ *getHistory(Direction dir, double carrierFrequency);
 
+    /*
+     * Per-QFI link adaptation: grants of a QFI whose PER target is lower than the BLER target
+     * of the cell are served with a more conservative CQI. The PER target is the one of the
+     * QFI context, as read by the QfiContextManager from the QFI context file
+     */
+    bool qfiLinkAdaptation_ = false;
+    double targetBler_ = 0.01;
+    double cqiBackoffPerDecade_ = 1;
+
+    // cache of the CQI back-off of each connection
+    std::map<MacCid, unsigned int> cidCqiBackoff_;
+
+    // CQI back-off of the grant issued to each UE in the current slot (DL and UL), and
+    // the backed-off transmission parameters returned by computeTxParams() for that UE.
+    // The back-off is kept per UE and not per connection: all the connections served by the
+    // grant share the same transport block, hence the same MCS. The fallback is limited to the
+    // connections with data in the slot (see LteSchedulerEnb::scheduleUeGrant()): a UE carries
+    // its eMBB data at the CQI of its URLLC DRB only in the slots where that DRB is backlogged
+    std::map<MacNodeId, unsigned int> grantCqiBackoff_[2];
+    std::map<std::pair<MacNodeId, double>, UserTxParams> backoffTxParams_[2];
+
+    /*
+     * Sub-band CQI: the per-band CQIs reported by a UE are grouped into sub-bands of
+     * cqiSubbandSize_ bands, each one reported with a single CQI (0 disables sub-band scoring)
+     */
+    unsigned int cqiSubbandSize_ = 0;
+
+    // sub-band CQIs of each UE (DL and UL), rebuilt on the first lookup after a feedback
+    std::map<double, std::map<MacNodeId, std::vector<Cqi>>> subbandCqi_[2];
+
+    // number of feedbacks received from each UE (DL and UL), to let the schedulers detect CQI changes
+    std::map<double, std::map<MacNodeId, unsigned int>> feedbackCount_[2];
+
+    // CQI of the sub-band including band b, with the CQI back-off of the grant of the UE in the current slot
+    Cqi readGrantBandCqi(MacNodeId id, Band b, const Direction dir, double carrierFrequency);
+
+    // ratio between the bits per block of the sub-band CQI of band b and those of the wideband CQI of codeword cw
+    double getSubbandScaling(MacNodeId id, Band b, Codeword cw, const Direction dir, double carrierFrequency);
+
   public:
     LteAmc(LteMacEnb *mac, Binder *binder, CellInfo *cellInfo, int numAntennas);
     LteAmc(const LteAmc& other) { operator=(other); }
@@ -154,8 +195,20 @@ class LteAmc
     // multiband version of the above function. It returns the number of bytes that can fit in the given "blocks" of the given "band"
     virtual unsigned int computeBytesOnNRbs_MB(MacNodeId id, Band b, unsigned int blocks, const Direction dir, double carrierFrequency);
     virtual unsigned int computeBitsOnNRbs_MB(MacNodeId id, Band b, unsigned int blocks, const Direction dir, double carrierFrequency);
+
+    /*
+     * Per-QFI link adaptation
+     */
+    // returns the CQI back-off of the QFI of the given connection
+    unsigned int getCqiBackoff(MacCid cid);
+    // sets the CQI back-off used by computeTxParams() for the grant issued to the given UE in the current slot
+    void setGrantCqiBackoff(MacNodeId id, Direction dir, unsigned int backoff);
+    // clears the back-off of the grants of the previous slot
+    void resetGrantCqiBackoff(Direction dir);
+
     bool setPilotUsableBands(MacNodeId id, UsableBands usableBands);
     UsableBands *getPilotUsableBands(MacNodeId id);
+    const UsableBandsMask *getPilotUsableBandsMask(MacNodeId id);
 
     // utilities - do not involve pilot invocation
     unsigned int getItbsPerCqi(Cqi cqi, const Direction dir);
@@ -219,6 +272,28 @@ class LteAmc
     }
 
     std::vector<Cqi> readMultiBandCqi(MacNodeId id, const Direction dir, double carrierFrequency);
+    // returns the number of feedbacks received from the given UE (DL and UL only): the CQIs
+    // and the transmission parameters of the UE do not change as long as this number does not
+    unsigned int getFeedbackCount(MacNodeId id, const Direction dir, double carrierFrequency);
+
+    /*
+     * Sub-band CQI
+     */
+    unsigned int getCqiSubbandSize() const { return cqiSubbandSize_; }
+    // returns the CQI of each sub-band of the given UE (DL and UL only)
+    const std::vector<Cqi>& readSubbandCqi(MacNodeId id, const Direction dir, double carrierFrequency);
+    // returns the CQI of the sub-band including the given band
+    Cqi readBandCqi(MacNodeId id, Band b, const Direction dir, double carrierFrequency);
+    // as computeBytesOnNRbs(), but using the CQI of the sub-band including the given band.
+    // Falls back to computeBytesOnNRbs() when sub-band CQI is disabled
+    unsigned int computeBytesOnSubband(MacNodeId id, Band b, unsigned int blocks, const Direction dir, double carrierFrequency);
+    unsigned int computeBytesOnSubband(MacNodeId id, Band b, Codeword cw, unsigned int blocks, const Direction dir, double carrierFrequency);
+    // returns the transmission parameters of a grant on the given allocation (bands and blocks), and the bytes
+    // of its transport block on each codeword. With sub-band CQI, each codeword is given the effective CQI of the
+    // allocated blocks (the highest one not exceeding their average spectral efficiency) and the transport block
+    // is sized on it. Otherwise, the parameters of computeTxParams() and the bytes of computeBytesOnNRbs()
+    UserTxParams computeGrantTxParams(MacNodeId id, const std::vector<std::pair<Band, unsigned int>>& bands, const Direction dir,
+            double carrierFrequency, std::vector<unsigned int>& cwBytes);
 
     int getSystemNumBands() { return numBands_; }
 
@@ -23,6 +23,15 @@
 
 namespace simu5g {
 
+/// Usable bands as a bitmask indexed by band
+typedef std::vector<bool> UsableBandsMask;
+
+/// Returns true if the band is set in the usable bands mask
+inline bool isUsableBand(const UsableBandsMask& mask, Band band)
+{
+    return band < mask.size() && mask[band];
+}
+
 /**
  * @class UserTxParams
  *
@@ -0,0 +1,58 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include "stack/mac/buffer/LteMacBacklogCounter.h"
+
+namespace simu5g {
+
+using namespace omnetpp;
+
+template<typename Key>
+static void updateBacklog(std::map<Key, LteMacBacklogCounter::Backlog>& map, Key key, int64_t bytes, int64_t packets)
+{
+    auto it = map.find(key);
+    if (it == map.end()) {
+        if (packets <= 0)
+            throw cRuntimeError("LteMacBacklogCounter::update - removing packets from an empty backlog");
+        it = map.emplace(key, LteMacBacklogCounter::Backlog()).first;
+    }
+    it->second.bytes += bytes;
+    it->second.packets += packets;
+    if (it->second.packets < 0 || it->second.bytes < 0)
+        throw cRuntimeError("LteMacBacklogCounter::update - negative backlog");
+    if (it->second.packets == 0)
+        map.erase(it);
+}
+
+void LteMacBacklogCounter::update(MacNodeId nodeId, int qfi, int64_t bytes, int64_t packets)
+{
+    if (bytes == 0 && packets == 0)
+        return;
+
+    total_.bytes += bytes;
+    total_.packets += packets;
+    updateBacklog(ueBacklog_, nodeId, bytes, packets);
+    updateBacklog(qfiBacklog_, qfi, bytes, packets);
+}
+
+int64_t LteMacBacklogCounter::getQfiBytes(int qfi) const
+{
+    auto it = qfiBacklog_.find(qfi);
+    return (it != qfiBacklog_.end()) ? it->second.bytes : 0;
+}
+
+int64_t LteMacBacklogCounter::getUeBytes(MacNodeId nodeId) const
+{
+    auto it = ueBacklog_.find(nodeId);
+    return (it != ueBacklog_.end()) ? it->second.bytes : 0;
+}
+
+} //namespace
@@ -0,0 +1,74 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_LTEMACBACKLOGCOUNTER_H_
+#define _LTE_LTEMACBACKLOGCOUNTER_H_
+
+#include <omnetpp.h>
+#include "common/LteCommon.h"
+
+namespace simu5g {
+
+using namespace omnetpp;
+
+/**
+ * @class LteMacBacklogCounter
+ * @brief Aggregated backlog of a set of MAC buffers
+ *
+ * Keeps the total number of queued bytes, the per-QFI bytes and the set of
+ * backlogged UEs of all the LteMacBuffer objects attached to it. Buffers notify
+ * every change of their content, so that the aggregates never need a recount.
+ */
+class LteMacBacklogCounter
+{
+  public:
+    struct Backlog
+    {
+        int64_t bytes = 0;
+        int64_t packets = 0;
+    };
+
+    /**
+     * Accounts a change in the content of one of the attached buffers
+     *
+     * @param nodeId owner of the buffer
+     * @param qfi QFI of the buffer
+     * @param bytes variation of the occupancy
+     * @param packets variation of the number of queued packets
+     */
+    void update(MacNodeId nodeId, int qfi, int64_t bytes, int64_t packets);
+
+    /// total queued bytes
+    int64_t getBytes() const { return total_.bytes; }
+
+    /// queued bytes for the given QFI
+    int64_t getQfiBytes(int qfi) const;
+
+    /// queued bytes for the given UE
+    int64_t getUeBytes(MacNodeId nodeId) const;
+
+    /// number of UEs with at least one queued packet
+    unsigned int getBackloggedUesNumber() const { return ueBacklog_.size(); }
+
+    const std::map<MacNodeId, Backlog>& getUeBacklog() const { return ueBacklog_; }
+    const std::map<int, Backlog>& getQfiBacklog() const { return qfiBacklog_; }
+
+  private:
+    Backlog total_;
+
+    // only UEs/QFIs with a non-empty backlog are stored
+    std::map<MacNodeId, Backlog> ueBacklog_;
+    std::map<int, Backlog> qfiBacklog_;
+};
+
+} //namespace
+
+#endif
@@ -26,8 +26,39 @@ LteMacBuffer::LteMacBuffer(const LteMacQueue& queue)
 
 
 
+LteMacBuffer::LteMacBuffer(const LteMacBuffer& queue) : processed_(queue.processed_), queueOccupancy_(0), queueLength_(0)
+{
+    operator=(queue);
+}
+
+LteMacBuffer::~LteMacBuffer()
+{
+    setBacklogCounter(nullptr, NODEID_NONE, 0);
+}
+
+void LteMacBuffer::setBacklogCounter(LteMacBacklogCounter *counter, MacNodeId nodeId, int qfi)
+{
+    if (counter_ != nullptr)
+        counter_->update(counterNodeId_, counterQfi_, -(int64_t)queueOccupancy_, -queueLength_);
+
+    counter_ = counter;
+    counterNodeId_ = nodeId;
+    counterQfi_ = qfi;
+
+    if (counter_ != nullptr)
+        counter_->update(counterNodeId_, counterQfi_, queueOccupancy_, queueLength_);
+}
+
 LteMacBuffer& LteMacBuffer::operator=(const LteMacBuffer& queue)
 {
+    if (this == &queue)
+        return *this;
+
+    // the counter stays attached to this buffer, only its content changes
+    if (counter_ != nullptr)
+        counter_->update(counterNodeId_, counterQfi_,
+                (int64_t)queue.queueOccupancy_ - queueOccupancy_, queue.queueLength_ - queueLength_);
+
     queueOccupancy_ = queue.queueOccupancy_;
     queueLength_ = queue.queueLength_;
     Queue_ = queue.Queue_;
@@ -44,6 +75,8 @@ void LteMacBuffer::pushBack(PacketInfo pkt)
     queueLength_++;
     queueOccupancy_ += pkt.first;
     Queue_.push_back(pkt);
+    if (counter_ != nullptr)
+        counter_->update(counterNodeId_, counterQfi_, pkt.first, 1);
 }
 
 void LteMacBuffer::pushFront(PacketInfo pkt)
@@ -51,6 +84,8 @@ void LteMacBuffer::pushFront(PacketInfo pkt)
     queueLength_++;
     queueOccupancy_ += pkt.first;
     Queue_.push_front(pkt);
+    if (counter_ != nullptr)
+        counter_->update(counterNodeId_, counterQfi_, pkt.first, 1);
 }
 
 PacketInfo LteMacBuffer::popFront()
@@ -63,6 +98,8 @@ PacketInfo LteMacBuffer::popFront()
     processed_++;
     queueLength_--;
     queueOccupancy_ -= pkt.first;
+    if (counter_ != nullptr)
+        counter_->update(counterNodeId_, counterQfi_, -(int64_t)pkt.first, -1);
     return pkt;
 }
 
@@ -75,10 +112,12 @@ PacketInfo LteMacBuffer::popBack()
     Queue_.pop_back();
     queueLength_--;
     queueOccupancy_ -= pkt.first;
+    if (counter_ != nullptr)
+        counter_->update(counterNodeId_, counterQfi_, -(int64_t)pkt.first, -1);
     return pkt;
 }
 
-PacketInfo& LteMacBuffer::front()
+PacketInfo LteMacBuffer::front() const
 {
     if (queueLength_ <= 0)
         throw cRuntimeError("Packet queue is empty");
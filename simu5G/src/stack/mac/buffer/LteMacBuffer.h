@@ -14,6 +14,7 @@
 
 #include <omnetpp.h>
 #include "common/LteCommon.h"
+#include "stack/mac/buffer/LteMacBacklogCounter.h"
 
 namespace simu5g {
 
@@ -38,9 +39,27 @@ class LteMacBuffer
      * Copy Constructors
      */
     LteMacBuffer(const LteMacQueue& queue);
+    LteMacBuffer(const LteMacBuffer& queue);
     LteMacBuffer& operator=(const LteMacBuffer& queue);
     LteMacBuffer *dup() const;
 
+    /**
+     * Destructor removes the remaining content
+     * from the attached backlog counter
+     */
+    ~LteMacBuffer();
+
+    /**
+     * setBacklogCounter() attaches the buffer to a backlog counter,
+     * which is then notified of every change of the buffer content.
+     * Copies of the buffer are never attached.
+     *
+     * @param counter backlog counter (nullptr to detach)
+     * @param nodeId owner of the buffer
+     * @param qfi QFI of the buffer
+     */
+    void setBacklogCounter(LteMacBacklogCounter *counter, MacNodeId nodeId, int qfi);
+
     /**
      * pushBack() inserts a new packet
      * at the back of the queue (standard operation)
@@ -79,11 +98,12 @@ class LteMacBuffer
     /**
      * front() returns the packet in front
      * of the queue without performing actual extraction.
+     * To change its size, pop it and push it back to the front.
      *
      * @return zero-size packet if queue is empty,
      *             pkt on successful operation
      */
-    PacketInfo& front();
+    PacketInfo front() const;
 
     /**
      * back() returns the packet at the back
@@ -161,6 +181,11 @@ class LteMacBuffer
 
     /// List of packets
     std::list<PacketInfo> Queue_;
+
+    /// Backlog counter notified of the changes (not owned)
+    LteMacBacklogCounter *counter_ = nullptr;
+    MacNodeId counterNodeId_ = NODEID_NONE;
+    int counterQfi_ = 0;
 };
 
 } //namespace
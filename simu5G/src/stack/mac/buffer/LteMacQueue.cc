@@ -9,6 +9,7 @@
 // and cannot be removed from it.
 //
 
+#include <algorithm>
 #include <climits>
 #include "stack/mac/buffer/LteMacQueue.h"
 #include "stack/rlc/am/packet/LteRlcAmPdu.h"
@@ -28,6 +29,12 @@ LteMacQueue::LteMacQueue(const LteMacQueue& queue)
     operator=(queue);
 }
 
+LteMacQueue::~LteMacQueue()
+{
+    // remove the contribution of the queue from the pool
+    accountInPool(-1);
+}
+
 LteMacQueue& LteMacQueue::operator=(const LteMacQueue& queue)
 {
     cPacketQueue::operator=(queue);
@@ -41,13 +48,15 @@ LteMacQueue *LteMacQueue::dup() const
 }
 
 // ENQUEUE
-bool LteMacQueue::pushBack(cPacket *pkt)
+bool LteMacQueue::pushBack(cPacket *pkt, int64_t extraSpace)
 {
     Packet *pktAux = check_and_cast<Packet *>(pkt);
-    if (!isEnqueueablePacket(pktAux))
+    if (!isEnqueueablePacket(pktAux, extraSpace))
         return false; // packet queue full or we have discarded fragments for this main packet
 
+    int64_t oldOccupancy = getQueueOccupancy();
     cPacketQueue::insert(pkt);
+    updatePool(oldOccupancy);
     return true;
 }
 
@@ -57,18 +66,57 @@ bool LteMacQueue::pushFront(cPacket *pkt)
     if (!isEnqueueablePacket(pktAux))
         return false; // packet queue full or we have discarded fragments for this main packet
 
+    int64_t oldOccupancy = getQueueOccupancy();
     cPacketQueue::insertBefore(cPacketQueue::front(), pkt);
+    updatePool(oldOccupancy);
     return true;
 }
 
 cPacket *LteMacQueue::popFront()
 {
-    return getQueueLength() > 0 ? cPacketQueue::pop() : nullptr;
+    if (getQueueLength() == 0)
+        return nullptr;
+    int64_t oldOccupancy = getQueueOccupancy();
+    cPacket *pkt = cPacketQueue::pop();
+    updatePool(oldOccupancy);
+    return pkt;
 }
 
 cPacket *LteMacQueue::popBack()
 {
-    return getQueueLength() > 0 ? cPacketQueue::remove(cPacketQueue::back()) : nullptr;
+    if (getQueueLength() == 0)
+        return nullptr;
+    int64_t oldOccupancy = getQueueOccupancy();
+    cPacket *pkt = cPacketQueue::remove(cPacketQueue::back());
+    updatePool(oldOccupancy);
+    return pkt;
+}
+
+void LteMacQueue::attachPool(LteMacQueuePool *pool, int priorityLevel)
+{
+    accountInPool(-1);
+    pool_ = pool;
+    poolLevel_ = priorityLevel;
+    accountInPool(1);
+}
+
+void LteMacQueue::accountInPool(int sign, int64_t occupancy)
+{
+    if (pool_ == nullptr || queueSize_ == 0)
+        return;
+    pool_->unusedSpace[poolLevel_] += sign * std::max<int64_t>(queueSize_ - occupancy, 0);
+    pool_->borrowedSpace += sign * std::max<int64_t>(occupancy - queueSize_, 0);
+}
+
+void LteMacQueue::accountInPool(int sign)
+{
+    accountInPool(sign, getQueueOccupancy());
+}
+
+void LteMacQueue::updatePool(int64_t oldOccupancy)
+{
+    accountInPool(-1, oldOccupancy);
+    accountInPool(1);
 }
 
 simtime_t LteMacQueue::getHolTimestamp() const
@@ -86,7 +134,7 @@ int64_t LteMacQueue::getQueueSize() const
     return queueSize_;
 }
 
-bool LteMacQueue::isEnqueueablePacket(Packet *pkt) {
+bool LteMacQueue::isEnqueueablePacket(Packet *pkt, int64_t extraSpace) {
 
     auto chunk = pkt->peekAtFront<Chunk>();
     auto pdu = dynamicPtrCast<const LteRlcAmPdu>(chunk);
@@ -106,7 +154,7 @@ bool LteMacQueue::isEnqueueablePacket(Packet *pkt) {
     if (pdu != nullptr) { // for AM we need to check if all fragments will fit
         if (pdu->getTotalFragments() > 1) {
             int remainingFrags = (pdu->getLastSn() - pdu->getSnoFragment() + 1);
-            bool allFragsWillFit = (remainingFrags * pkt->getByteLength()) + getByteLength() < queueSize_;
+            bool allFragsWillFit = (remainingFrags * pkt->getByteLength()) + getByteLength() < queueSize_ + extraSpace;
             bool enqueable = (pdu->getSnoMainPacket() != lastUnenqueueableMainSno) && allFragsWillFit;
             if (allFragsWillFit && !enqueable) {
                 EV_DEBUG << "PDU would fit but discarded fragments before - rejecting fragment: " << pdu->getSnoMainPacket() << ":" << pdu->getSnoFragment() << std::endl;
@@ -119,7 +167,7 @@ bool LteMacQueue::isEnqueueablePacket(Packet *pkt) {
     }
 
     // no fragments or unknown type -- can always be enqueued if there is enough space in the queue
-    return pkt->getByteLength() + getByteLength() < queueSize_;
+    return pkt->getByteLength() + getByteLength() < queueSize_ + extraSpace;
 }
 
 int LteMacQueue::getQueueLength() const
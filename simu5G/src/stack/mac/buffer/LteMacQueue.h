@@ -22,6 +22,17 @@ namespace simu5g {
 
 using namespace omnetpp;
 
+/**
+ * Running account of the MAC queues of a node that share their unused space:
+ * unused space of the queues of each priority level, and space used by the queues
+ * beyond their own size
+ */
+struct LteMacQueuePool
+{
+    std::map<int, int64_t> unusedSpace;
+    int64_t borrowedSpace = 0;
+};
+
 /**
  * @class LteMacQueue
  * @brief Queue for MAC SDU packets
@@ -55,6 +66,19 @@ class LteMacQueue : public cPacketQueue
     LteMacQueue(const LteMacQueue& queue);
     LteMacQueue& operator=(const LteMacQueue& queue);
     LteMacQueue *dup() const override;
+    ~LteMacQueue() override;
+
+    /**
+     * Adds this queue to the shared pool of its node. The pool is updated
+     * at every insertion and extraction, until the queue is deleted
+     *
+     * @param pool shared pool of the node
+     * @param priorityLevel priority level of the queue (lower value means higher priority)
+     */
+    void attachPool(LteMacQueuePool *pool, int priorityLevel);
+
+    LteMacQueuePool *getPool() const { return pool_; }
+    int getPoolLevel() const { return poolLevel_; }
 
     /**
      * pushBack() inserts a new packet in the back
@@ -62,10 +86,11 @@ class LteMacQueue : public cPacketQueue
      * if there is enough space left
      *
      * @param pkt packet to insert
+     * @param extraSpace space borrowed beyond the queue size (shared buffer pool)
      * @return false if queue is full,
      *            true on successful insertion
      */
-    bool pushBack(cPacket *pkt);
+    bool pushBack(cPacket *pkt, int64_t extraSpace = 0);
 
     /**
      * pushFront() inserts a new packet in the front
@@ -140,12 +165,30 @@ class LteMacQueue : public cPacketQueue
      *    b) we have enough space in the queue to hold all remaining fragments of the same packet
      *
      */
-    bool isEnqueueablePacket(inet::Packet *pkt);
+    bool isEnqueueablePacket(inet::Packet *pkt, int64_t extraSpace = 0);
     unsigned int lastUnenqueueableMainSno; //<seq. number of
 
+    /**
+     * Adds (sign 1) or removes (sign -1) the contribution of the queue, with the
+     * current or the given occupancy, to the shared pool, if any
+     */
+    void accountInPool(int sign);
+    void accountInPool(int sign, int64_t occupancy);
+
+    /**
+     * Accounts the change of occupancy of the queue in the shared pool, if any
+     *
+     * @param oldOccupancy occupancy before the change
+     */
+    void updatePool(int64_t oldOccupancy);
+
   private:
     /// Size of queue
     int queueSize_;
+
+    /// Shared pool of the node (not owned) and priority level of the queue in it
+    LteMacQueuePool *pool_ = nullptr;
+    int poolLevel_ = 0;
 };
 
 } //namespace
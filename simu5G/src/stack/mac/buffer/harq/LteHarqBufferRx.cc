@@ -26,13 +26,14 @@ simsignal_t LteHarqBufferRx::macCellThroughputSignal_[2] = { cComponent::registe
 simsignal_t LteHarqBufferRx::macDelaySignal_[2] = { cComponent::registerSignal("macDelayDl"), cComponent::registerSignal("macDelayUl") };
 simsignal_t LteHarqBufferRx::macThroughputSignal_[2] = { cComponent::registerSignal("macThroughputDl"), cComponent::registerSignal("macThroughputUl") };
 
-LteHarqBufferRx::LteHarqBufferRx(unsigned int num, LteMacBase *owner, Binder *binder, MacNodeId srcId)
+LteHarqBufferRx::LteHarqBufferRx(unsigned int num, LteMacBase *owner, Binder *binder, MacNodeId srcId, double carrierFrequency)
     : binder_(binder), macOwner_(owner), numHarqProcesses_(num), srcId_(srcId), processes_(num, nullptr), isMulticast_(false)
 {
     initMacUe();
 
+    slotDuration_ = binder_->getSlotDurationFromNumerologyIndex(binder_->getNumerologyIndexFromCarrierFreq(carrierFrequency));
     for (unsigned int i = 0; i < numHarqProcesses_; i++) {
-        processes_[i] = new LteHarqProcessRx(i, macOwner_, binder);
+        processes_[i] = new LteHarqProcessRx(i, macOwner_, binder, slotDuration_);
     }
 
     // Signals initialization: these are used to gather statistics
@@ -46,9 +47,10 @@ LteHarqBufferRx::LteHarqBufferRx(unsigned int num, LteMacBase *owner, Binder *bi
     }
 }
 
-LteHarqBufferRx::LteHarqBufferRx(Binder *binder, LteMacBase *owner, unsigned int num, MacNodeId srcId)
+LteHarqBufferRx::LteHarqBufferRx(Binder *binder, LteMacBase *owner, unsigned int num, MacNodeId srcId, double carrierFrequency)
     : binder_(binder), macOwner_(owner), numHarqProcesses_(num), srcId_(srcId), processes_(num, nullptr), isMulticast_(false)
 {
+    slotDuration_ = binder_->getSlotDurationFromNumerologyIndex(binder_->getNumerologyIndexFromCarrierFreq(carrierFrequency));
 }
 
 void LteHarqBufferRx::insertPdu(Codeword cw, inet::Packet *pkt)
@@ -67,32 +69,60 @@ void LteHarqBufferRx::insertPdu(Codeword cw, inet::Packet *pkt)
     unsigned char acid = uInfo->getAcid();
     // TODO add codeword to insertPdu
     processes_[acid]->insertPdu(cw, pkt);
+    schedulePendingFeedback(acid, cw);
     // debug output
     EV << "H-ARQ RX: new PDU (id " << pdu->getId()
        << " ) inserted into process " << (int)acid << endl;
 }
 
-void LteHarqBufferRx::sendFeedback()
+void LteHarqBufferRx::schedulePendingFeedback(unsigned char acid, Codeword cw)
 {
-    for (unsigned int i = 0; i < numHarqProcesses_; i++) {
-        for (Codeword cw = 0; cw < MAX_CODEWORDS; ++cw) {
-            if (processes_[i]->isEvaluated(cw)) {
-                auto pkt = processes_[i]->createFeedback(cw);
-                auto hfb = pkt->peekAtFront<LteHarqFeedback>();
-
-                // debug output:
-                auto uInfo = pkt->getTag<UserControlInfo>();
-                const char *r = hfb->getResult() ? "ACK" : "NACK";
-                EV << "H-ARQ RX: feedback sent to TX process "
-                   << (int)hfb->getAcid() << " Codeword  " << (int)cw
-                   << " of node with id "
-                   << uInfo->getDestId()
-                   << " result: " << r << endl;
-
-                macOwner_->takeObj(pkt);
-                macOwner_->sendLowerPackets(pkt);
-            }
+    if (processes_[acid]->getUnitStatus(cw) == RXHARQ_PDU_EVALUATING)
+        pendingFeedback_.push_back({acid, cw, processes_[acid]->getRxTime(cw)});
+}
+
+bool LteHarqBufferRx::popDueFeedback(unsigned char& acid, Codeword& cw)
+{
+    while (!pendingFeedback_.empty()) {
+        const PendingFeedback& next = pendingFeedback_.front();
+        LteHarqProcessRx *process = processes_[next.acid];
+
+        // the unit has been reset (or refilled) after this entry was queued
+        if (process->getUnitStatus(next.cw) != RXHARQ_PDU_EVALUATING || process->getRxTime(next.cw) != next.rxTime) {
+            pendingFeedback_.pop_front();
+            continue;
         }
+        // entries behind this one are not due either
+        if (!process->isEvaluated(next.cw))
+            return false;
+
+        acid = next.acid;
+        cw = next.cw;
+        pendingFeedback_.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void LteHarqBufferRx::sendFeedback()
+{
+    unsigned char acid;
+    Codeword cw;
+    while (popDueFeedback(acid, cw)) {
+        auto pkt = processes_[acid]->createFeedback(cw);
+        auto hfb = pkt->peekAtFront<LteHarqFeedback>();
+
+        // debug output:
+        auto uInfo = pkt->getTag<UserControlInfo>();
+        const char *r = hfb->getResult() ? "ACK" : "NACK";
+        EV << "H-ARQ RX: feedback sent to TX process "
+           << (int)hfb->getAcid() << " Codeword  " << (int)cw
+           << " of node with id "
+           << uInfo->getDestId()
+           << " result: " << r << endl;
+
+        macOwner_->takeObj(pkt);
+        macOwner_->sendLowerPackets(pkt);
     }
 }
 
@@ -12,6 +12,8 @@
 #ifndef _LTE_LTEHARQBUFFERRX_H_
 #define _LTE_LTEHARQBUFFERRX_H_
 
+#include <deque>
+
 #include "stack/mac/LteMacBase.h"
 #include "stack/mac/buffer/harq/LteHarqProcessRx.h"
 
@@ -53,6 +55,22 @@ class LteHarqBufferRx
     /// flag for multicast flows
     bool isMulticast_;
 
+    /// slot duration of the carrier this buffer receives on
+    double slotDuration_ = 0;
+
+    /*
+     * Units waiting for their H-ARQ feedback. Since the evaluation delay is the same for
+     * all the processes of the buffer, entries are in order of feedback due time.
+     * The reception time allows to discard entries whose unit has been reset meanwhile.
+     */
+    struct PendingFeedback
+    {
+        unsigned char acid;
+        Codeword cw;
+        simtime_t rxTime;
+    };
+    std::deque<PendingFeedback> pendingFeedback_;
+
     // Statistics
     static unsigned int totalCellRcvdBytes_;
     unsigned int totalRcvdBytes_ = 0;
@@ -71,10 +89,20 @@ class LteHarqBufferRx
     opp_component_ptr<LteMacBase> macUe_;
 
   protected:
-    LteHarqBufferRx(Binder *binder, LteMacBase *owner, unsigned int num, MacNodeId srcId);
+    LteHarqBufferRx(Binder *binder, LteMacBase *owner, unsigned int num, MacNodeId srcId, double carrierFrequency);
+
+    /**
+     * Queues the given unit for feedback, if it has accepted a PDU for evaluation
+     */
+    void schedulePendingFeedback(unsigned char acid, Codeword cw);
+
+    /**
+     * Returns the next unit whose feedback is due in this slot, if any, and removes it from the queue
+     */
+    bool popDueFeedback(unsigned char& acid, Codeword& cw);
 
   public:
-    LteHarqBufferRx(unsigned int num, LteMacBase *owner, Binder *binder, MacNodeId srcId);
+    LteHarqBufferRx(unsigned int num, LteMacBase *owner, Binder *binder, MacNodeId srcId, double carrierFrequency);
 
     /**
      * Insertion of a new PDU coming from PHY layer into
@@ -154,8 +182,7 @@ class LteHarqBufferRx
 
   protected:
     /**
-     * Checks for all processes if the PDU has been evaluated and sends
-     * feedback if affirmative.
+     * Sends the feedback of the units whose PDU has been evaluated
      */
     virtual void sendFeedback();
 
@@ -34,12 +34,12 @@ UnitList LteHarqBufferTx::firstReadyForRtx()
     simtime_t oldestTxTime = NOW + 1;
     simtime_t currentTxTime = 0;
 
-    for (unsigned int i = 0; i < numProc_; i++) {
-        if (processes_[i]->hasReadyUnits()) {
-            currentTxTime = processes_[i]->getOldestUnitTxTime();
-            if (currentTxTime < oldestTxTime) {
+    for (const auto& [dir, acids] : readyProcesses_) {
+        for (unsigned char acid : acids) {
+            currentTxTime = processes_[acid]->getOldestUnitTxTime();
+            if (currentTxTime < oldestTxTime || (currentTxTime == oldestTxTime && acid < oldestProcessAcid)) {
                 oldestTxTime = currentTxTime;
-                oldestProcessAcid = i;
+                oldestProcessAcid = acid;
             }
         }
     }
@@ -101,6 +101,7 @@ void LteHarqBufferTx::markSelected(UnitList unitIds, unsigned char availableTbs)
     }
 
     selectedAcid_ = acid;
+    updateReadyIndex(acid);
 
     // debug output
     EV << "H-ARQ TX: process " << (int)selectedAcid_ << " has been selected for retransmission" << endl;
@@ -214,6 +215,7 @@ void LteHarqBufferTx::receiveHarqFeedback(Packet *pkt)
     bool reset = processes_[acid]->pduFeedback(harqResult, cw);
     if (reset)
         numEmptyProc_++;
+    updateReadyIndex(acid);
 
     // debug output
     const char *ack = result ? "ACK" : "NACK";
@@ -256,6 +258,7 @@ void LteHarqBufferTx::dropProcess(unsigned char acid)
     // if a process contains units in BUFFERED state, then all units of this
     // process are either empty or in BUFFERED state (ready).
     numEmptyProc_++;
+    updateReadyIndex(acid);
 }
 
 void LteHarqBufferTx::selfNack(unsigned char acid, Codeword cw)
@@ -268,6 +271,7 @@ void LteHarqBufferTx::selfNack(unsigned char acid, Codeword cw)
     }
     if (reset)
         numEmptyProc_++;
+    updateReadyIndex(acid);
 }
 
 void LteHarqBufferTx::forceDropProcess(unsigned char acid)
@@ -276,6 +280,7 @@ void LteHarqBufferTx::forceDropProcess(unsigned char acid)
     if (acid == selectedAcid_)
         selectedAcid_ = HARQ_NONE;
     numEmptyProc_++;
+    updateReadyIndex(acid);
 }
 
 void LteHarqBufferTx::forceDropUnit(unsigned char acid, Codeword cw)
@@ -286,6 +291,17 @@ void LteHarqBufferTx::forceDropUnit(unsigned char acid, Codeword cw)
             selectedAcid_ = HARQ_NONE;
         numEmptyProc_++;
     }
+    updateReadyIndex(acid);
+}
+
+void LteHarqBufferTx::updateReadyIndex(unsigned char acid)
+{
+    for (auto& [dir, acids] : readyProcesses_)
+        acids.erase(acid);
+
+    LteHarqProcessTx *process = processes_[acid];
+    for (Codeword cw : process->readyUnitsIds())
+        readyProcesses_[process->getPduDirection(cw)].insert(acid);
 }
 
 BufferStatus LteHarqBufferTx::getBufferStatus()
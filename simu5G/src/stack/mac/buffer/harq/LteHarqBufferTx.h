@@ -12,6 +12,8 @@
 #ifndef _LTE_LTEHARQBUFFERTX_H_
 #define _LTE_LTEHARQBUFFERTX_H_
 
+#include <map>
+#include <set>
 #include <vector>
 #include "stack/mac/packet/LteHarqFeedback_m.h"
 #include "stack/mac/buffer/harq/LteHarqProcessTx.h"
@@ -37,6 +39,10 @@ class LteHarqBufferTx : noncopyable
     unsigned char selectedAcid_; // @ insert, @ marksel, @ sendseldn
     MacNodeId nodeId_; // UE nodeId for which this buffer has been created
 
+    // processes with units ready for RTX, per direction of their PDUs. Updated by the methods of
+    // this class changing the status of a process, see updateReadyIndex()
+    std::map<Direction, std::set<unsigned char>> readyProcesses_;
+
   protected:
     /**
      * Protected Base Constructor.
@@ -82,6 +88,15 @@ class LteHarqBufferTx : noncopyable
      */
     UnitList firstReadyForRtx();
 
+    /**
+     * Returns the IDs of the H-ARQ processes having units ready for retransmission
+     * with a PDU for the given direction, in increasing order.
+     *
+     * @param dir direction of the PDU (e.g. UL, D2D, D2D_MULTI)
+     * @return set of process IDs
+     */
+    const std::set<unsigned char>& getReadyProcesses(Direction dir) { return readyProcesses_[dir]; }
+
     /**
      * Returns the identifier of the H-ARQ process containing the unit with
      * passed id.
@@ -209,6 +224,13 @@ class LteHarqBufferTx : noncopyable
      * @return true if the id is in the list, false otherwise.
      */
     bool isInUnitList(unsigned char acid, Codeword cw, UnitList unitIds);
+
+    /**
+     * Updates the entries of the given process in readyProcesses_ after a change of its status
+     *
+     * @param acid the H-ARQ process
+     */
+    void updateReadyIndex(unsigned char acid);
 };
 
 } //namespace
@@ -21,8 +21,10 @@ namespace simu5g {
 
 using namespace omnetpp;
 
-LteHarqProcessRx::LteHarqProcessRx(unsigned char acid, LteMacBase *owner, Binder *binder) : acid_(acid), macOwner_(owner), binder_(binder),  maxHarqRtx_(owner->par("maxHarqRtx")), harqFbEvaluationTimer_(owner->par("harqFbEvaluationTimer"))
+LteHarqProcessRx::LteHarqProcessRx(unsigned char acid, LteMacBase *owner, Binder *binder, double slotDuration) : acid_(acid), macOwner_(owner), binder_(binder),  maxHarqRtx_(owner->par("maxHarqRtx")), harqFbEvaluationTimer_(owner->par("harqFbEvaluationTimer"))
 {
+    fbEvaluationDelay_ = slotDuration * (harqFbEvaluationTimer_ - 1);
+
     pdu_.resize(MAX_CODEWORDS, nullptr);
     status_.resize(MAX_CODEWORDS, RXHARQ_PDU_EMPTY);
     rxTime_.resize(MAX_CODEWORDS, 0);
@@ -55,6 +57,13 @@ void LteHarqProcessRx::insertPdu(Codeword cw, Packet *pkt)
     // store new received PDU
     pdu_.at(cw) = pkt;
     result_.at(cw) = lteInfo->getDeciderResult();
+    // an adaptive retransmission carries only a fraction of the coded bits of the PDU: the decoding
+    // probability computed by the PHY, which refers to the full allocation, is scaled by that fraction
+    double codingRatio = pdu->getRtxCodingRatio();
+    if (result_.at(cw) && codingRatio < 1.0 && macOwner_->uniform(0.0, 1.0) >= codingRatio) {
+        EV << "LteHarqProcessRx::insertPdu - adaptive RTX with coding ratio " << codingRatio << " not decoded" << endl;
+        result_.at(cw) = false;
+    }
     status_.at(cw) = RXHARQ_PDU_EVALUATING;
     rxTime_.at(cw) = NOW;
 
@@ -63,19 +72,7 @@ void LteHarqProcessRx::insertPdu(Codeword cw, Packet *pkt)
 
 bool LteHarqProcessRx::isEvaluated(Codeword cw)
 {
-    if (status_.at(cw) == RXHARQ_PDU_EVALUATING) {
-        // get carrier frequency from the control info included in pdu_
-        auto lteInfo = pdu_[cw]->getTag<UserControlInfo>();
-        double carrierFreq = lteInfo->getCarrierFrequency();
-
-        // obtain numerology and corresponding slot duration
-        NumerologyIndex numerologyIndex = binder_->getNumerologyIndexFromCarrierFreq(carrierFreq);
-        double slotDuration = binder_->getSlotDurationFromNumerologyIndex(numerologyIndex);
-
-        if ((NOW - rxTime_.at(cw)) >= slotDuration * (harqFbEvaluationTimer_ - 1))
-            return true;
-    }
-    return false;
+    return status_.at(cw) == RXHARQ_PDU_EVALUATING && (NOW - rxTime_.at(cw)) >= fbEvaluationDelay_;
 }
 
 //LteHarqFeedback *LteHarqProcessRx::createFeedback(Codeword cw)
@@ -72,15 +72,18 @@ class LteHarqProcessRx
     /// Number of slots for sending back HARQ Feedback
     unsigned short harqFbEvaluationTimer_;
 
+    /// Time needed to evaluate a PDU (depends on the slot duration of the carrier)
+    inet::simtime_t fbEvaluationDelay_;
+
   public:
 
     /**
      * Constructor.
      *
      * @param acid process identifier
-     * @param
+     * @param slotDuration slot duration of the carrier the process receives on
      */
-    LteHarqProcessRx(unsigned char acid, LteMacBase *owner, Binder *binder);
+    LteHarqProcessRx(unsigned char acid, LteMacBase *owner, Binder *binder, double slotDuration);
 
     /**
      * Inserts a PDU into the process and evaluates it (corrupted or correct).
@@ -129,6 +132,14 @@ class LteHarqProcessRx
         return status_.at(cw);
     }
 
+    /**
+     * @return the reception time of the PDU buffered in the codeword
+     */
+    inet::simtime_t getRxTime(Codeword cw) const
+    {
+        return rxTime_.at(cw);
+    }
+
     /**
      * @return whole buffer status
      */
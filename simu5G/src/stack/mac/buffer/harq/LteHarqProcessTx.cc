@@ -108,6 +108,11 @@ bool LteHarqProcessTx::hasReadyUnits()
     return false;
 }
 
+Direction LteHarqProcessTx::getPduDirection(Codeword cw)
+{
+    return units_[cw]->getPduDirection();
+}
+
 simtime_t LteHarqProcessTx::getOldestUnitTxTime()
 {
     simtime_t oldestTxTime = NOW + 1;
@@ -135,6 +140,18 @@ CwList LteHarqProcessTx::readyUnitsIds()
     return ul;
 }
 
+CwList LteHarqProcessTx::readyUnitsIds(Direction dir)
+{
+    CwList ul;
+
+    for (Codeword i = 0; i < numHarqUnits_; i++) {
+        if (units_[i]->isReady() && units_[i]->getPduDirection() == dir) {
+            ul.push_back(i);
+        }
+    }
+    return ul;
+}
+
 CwList LteHarqProcessTx::emptyUnitsIds()
 {
     CwList ul;
@@ -236,6 +253,11 @@ bool LteHarqProcessTx::isUnitMarked(Codeword cw)
     return units_[cw]->isMarked();
 }
 
+void LteHarqProcessTx::setRtxCodingRatio(Codeword cw, double ratio)
+{
+    units_[cw]->setRtxCodingRatio(ratio);
+}
+
 bool LteHarqProcessTx::isDropped()
 {
     return dropped_;
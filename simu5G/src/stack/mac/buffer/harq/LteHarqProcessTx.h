@@ -109,6 +109,11 @@ class LteHarqProcessTx : noncopyable
      */
     bool hasReadyUnits();
 
+    /**
+     * Returns the direction of the PDU in the given unit (e.g. UL, D2D, D2D_MULTI)
+     */
+    Direction getPduDirection(Codeword cw);
+
     /**
      * Returns the TX time of the unit which is not retransmitting for
      * the longest period of time, inside this process (the oldest
@@ -126,6 +131,15 @@ class LteHarqProcessTx : noncopyable
      */
     CwList readyUnitsIds();
 
+    /**
+     * Returns a list of IDs of ready for retransmission units of
+     * this process carrying a PDU for the given direction.
+     *
+     * @param dir direction of the PDU (e.g. UL, D2D, D2D_MULTI)
+     * @return list of unit IDs which are ready for RTX in that direction
+     */
+    CwList readyUnitsIds(Direction dir);
+
     /**
      * Returns a list of IDs of empty units inside this process.
      *
@@ -179,6 +193,7 @@ class LteHarqProcessTx : noncopyable
     int64_t getPduLength(Codeword cw);
     simtime_t getTxTime(Codeword cw);
     bool isUnitMarked(Codeword cw);
+    void setRtxCodingRatio(Codeword cw, double ratio);
     bool isDropped();
 
     /**
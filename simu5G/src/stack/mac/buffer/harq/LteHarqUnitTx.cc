@@ -68,6 +68,7 @@ void LteHarqUnitTx::insertPdu(Packet *pkt)
         throw cRuntimeError("mismatch in cw settings");
 
     lteInfo->setCw(cw_);
+    pduDir_ = (Direction)lteInfo->getDirection();
 }
 
 void LteHarqUnitTx::markSelected()
@@ -96,6 +97,12 @@ Packet *LteHarqUnitTx::extractPdu()
     EV << "LteHarqUnitTx::extractPdu - ndi set to " << ((transmissions_ == 1) ? "true" : "false") << endl;
 
     auto extractedPdu = pdu_->dup();
+    // the coding ratio only applies to the copy being sent, the buffered PDU is left untouched
+    auto macPdu = extractedPdu->removeAtFront<LteMacPdu>();
+    macPdu->setRtxCodingRatio(rtxCodingRatio_);
+    extractedPdu->insertAtFront(macPdu);
+    rtxCodingRatio_ = 1.0;
+
     macOwner_->takeObj(extractedPdu);
     return extractedPdu;
 }
@@ -108,6 +115,7 @@ bool LteHarqUnitTx::pduFeedback(HarqAcknowledgment a)
     auto lteInfo = pdu_->getTag<UserControlInfo>();
     short unsigned int dir = lteInfo->getDirection();
     unsigned int ntx = transmissions_;
+    MacCid cid = idToMacCid(lteInfo->getDestId(), lteInfo->getLcid());
     if (!(status_ == TXHARQ_PDU_WAITING))
         throw cRuntimeError("Feedback sent to an H-ARQ unit not waiting for it");
 
@@ -192,6 +200,10 @@ bool LteHarqUnitTx::pduFeedback(HarqAcknowledgment a)
     if (reset) {
         ue->emit(macPacketLossSignal_[dir_], sample);
         nodeB_->emit(macCellPacketLossSignal_[dir_], sample);
+
+        // per-QFI accounting of the DL PDUs
+        if (dir == DL)
+            check_and_cast<LteMacEnb *>(macOwner_.get())->recordHarqOutcome(cid, ntx, a == HARQNACK);
     }
 
     return reset;
@@ -261,6 +273,7 @@ void LteHarqUnitTx::resetUnit()
 
     status_ = TXHARQ_PDU_EMPTY;
     pduLength_ = 0;
+    rtxCodingRatio_ = 1.0;
 }
 
 } //namespace
@@ -62,9 +62,15 @@ class LteHarqUnitTx : noncopyable
 
     TxHarqPduStatus status_ = TXHARQ_PDU_EMPTY;
 
+    /// Direction of the carried pdu (UL, D2D or D2D_MULTI on UEs), read once at insertion
+    Direction pduDir_ = UNKNOWN_DIRECTION;
+
     /// TTI at which the pdu has been transmitted
     simtime_t txTime_;
 
+    /// Coding ratio of the next (adaptive) retransmission, applied at extraction
+    double rtxCodingRatio_ = 1.0;
+
     // reference to the eNB module
     opp_component_ptr<cModule> nodeB_;
 
@@ -190,6 +196,15 @@ class LteHarqUnitTx : noncopyable
         return status_ == TXHARQ_PDU_SELECTED;
     }
 
+    /**
+     * Sets the fraction of the PDU coded bits carried by the next transmission,
+     * when a retransmission is sent on fewer resources than the original one.
+     */
+    virtual void setRtxCodingRatio(double ratio)
+    {
+        rtxCodingRatio_ = ratio;
+    }
+
     virtual long getMacPduId()
     {
         return pduId_;
@@ -200,6 +215,11 @@ class LteHarqUnitTx : noncopyable
         return status_;
     }
 
+    Direction getPduDirection() const
+    {
+        return pduDir_;
+    }
+
     virtual ~LteHarqUnitTx();
 
   protected:
@@ -0,0 +1,66 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include "stack/mac/buffer/harq_d2d/LteD2DMulticastGroups.h"
+
+namespace simu5g {
+
+using namespace omnetpp;
+
+void LteD2DMulticastGroups::registerTransmitter(int32_t groupId, MacNodeId txId)
+{
+    if (groupId < 0)
+        throw cRuntimeError("LteD2DMulticastGroups::registerTransmitter - invalid group %d for node %hu", groupId, num(txId));
+
+    auto it = transmitterGroup_.find(txId);
+    if (it != transmitterGroup_.end()) {
+        if (it->second == groupId)
+            return;
+        // the transmitter moved to a different group
+        groups_[it->second].transmitters.erase(txId);
+        it->second = groupId;
+    }
+    else
+        transmitterGroup_[txId] = groupId;
+
+    groups_[groupId].transmitters.insert(txId);
+}
+
+const LteD2DMulticastGroups::Group& LteD2DMulticastGroups::recordOutcome(int32_t groupId, MacNodeId txId, bool delivered)
+{
+    // outcomes may reach the eNodeB before any BSR carrying the group
+    registerTransmitter(groupId, txId);
+
+    Group& group = groups_[groupId];
+    if (delivered)
+        ++group.delivered;
+    else
+        ++group.lost;
+    return group;
+}
+
+void LteD2DMulticastGroups::removeNode(MacNodeId nodeId)
+{
+    auto it = transmitterGroup_.find(nodeId);
+    if (it == transmitterGroup_.end())
+        return;
+
+    groups_[it->second].transmitters.erase(nodeId);
+    transmitterGroup_.erase(it);
+}
+
+const LteD2DMulticastGroups::Group *LteD2DMulticastGroups::getGroup(int32_t groupId) const
+{
+    auto it = groups_.find(groupId);
+    return (it != groups_.end()) ? &it->second : nullptr;
+}
+
+} //namespace
@@ -0,0 +1,77 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_LTED2DMULTICASTGROUPS_H_
+#define _LTE_LTED2DMULTICASTGROUPS_H_
+
+#include <omnetpp.h>
+#include "common/LteCommon.h"
+
+namespace simu5g {
+
+using namespace omnetpp;
+
+/**
+ * @class LteD2DMulticastGroups
+ * @brief D2D multicast groups known by the eNodeB
+ *
+ * A multicast transmission is scheduled with a single grant to its transmitter
+ * and is never retransmitted, hence the eNodeB keeps no per-receiver H-ARQ
+ * state for it. This table only records which group each transmitter serves
+ * (learned from its D2D_MULTI BSRs) and counts the outcomes of the group
+ * transmissions. Each outcome is reported once by the transmitter, which
+ * aggregates the feedback of the receivers, hence neither the signalling nor
+ * the state depend on the number of group members.
+ */
+class LteD2DMulticastGroups
+{
+  public:
+    struct Group
+    {
+        std::set<MacNodeId> transmitters;
+        unsigned long delivered = 0;
+        unsigned long lost = 0;
+
+        /// fraction of the group transmissions delivered to all the receivers
+        double getDeliveryRatio() const
+        {
+            unsigned long total = delivered + lost;
+            return (total > 0) ? (double)delivered / total : 0.0;
+        }
+    };
+
+    /// records that txId transmits to the given group
+    void registerTransmitter(int32_t groupId, MacNodeId txId);
+
+    /**
+     * Accounts the outcome of one multicast transmission
+     *
+     * @return the updated group
+     */
+    const Group& recordOutcome(int32_t groupId, MacNodeId txId, bool delivered);
+
+    /// removes the node from the transmitters of all groups (e.g. at handover)
+    void removeNode(MacNodeId nodeId);
+
+    const Group *getGroup(int32_t groupId) const;
+
+    const std::map<int32_t, Group>& getGroups() const { return groups_; }
+
+  private:
+    std::map<int32_t, Group> groups_;
+
+    // last group reported by each transmitter
+    std::map<MacNodeId, int32_t> transmitterGroup_;
+};
+
+} //namespace
+
+#endif
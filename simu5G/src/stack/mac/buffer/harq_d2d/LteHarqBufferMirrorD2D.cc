@@ -23,6 +23,12 @@ LteHarqBufferMirrorD2D::LteHarqBufferMirrorD2D(unsigned int numProc, unsigned ch
         processes_[i] = new LteHarqProcessMirrorD2D(MAX_CODEWORDS, maxHarqRtx_, macOwner);
 }
 
+LteHarqBufferMirrorD2D::~LteHarqBufferMirrorD2D()
+{
+    for (auto *process : processes_)
+        delete process;
+}
+
 void LteHarqBufferMirrorD2D::receiveHarqFeedback(inet::Packet *pkt)
 {
     EV << "LteHarqBufferMirrorD2D::receiveHarqFeedback - start" << endl;
@@ -54,6 +60,16 @@ void LteHarqBufferMirrorD2D::markSelectedAsWaiting()
     }
 }
 
+bool LteHarqBufferMirrorD2D::hasPendingUnits()
+{
+    for (auto *process : processes_) {
+        for (auto status : process->getProcessStatus()) {
+            if (status == TXHARQ_PDU_BUFFERED || status == TXHARQ_PDU_SELECTED)
+                return true;
+        }
+    }
+    return false;
+}
 
 } //namespace
 
@@ -47,6 +47,9 @@ class LteHarqBufferMirrorD2D
      * @param nodeId UE nodeId for which this buffer has been created
      */
     LteHarqBufferMirrorD2D(unsigned int numProc, unsigned char maxHarqRtx, LteMacEnb *macOwner);
+    LteHarqBufferMirrorD2D(const LteHarqBufferMirrorD2D& other) = delete;
+    LteHarqBufferMirrorD2D& operator=(const LteHarqBufferMirrorD2D& other) = delete;
+    ~LteHarqBufferMirrorD2D();
 
     /**
      * Manages H-ARQ feedback sent to a certain H-ARQ unit and checks if
@@ -60,6 +63,9 @@ class LteHarqBufferMirrorD2D
     unsigned int getProcesses() { return numProc_; }
     void markSelectedAsWaiting();
 
+    /// returns true if any unit is buffered for, or selected for, retransmission
+    bool hasPendingUnits();
+
 };
 
 } //namespace
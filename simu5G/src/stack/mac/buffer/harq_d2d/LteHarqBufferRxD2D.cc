@@ -26,14 +26,14 @@ simsignal_t LteHarqBufferRxD2D::macThroughputD2D_ = cComponent::registerSignal("
 simsignal_t LteHarqBufferRxD2D::macDelayD2D_ = cComponent::registerSignal("macDelayD2D");
 simsignal_t LteHarqBufferRxD2D::macCellThroughputD2D_ = cComponent::registerSignal("macCellThroughputD2D");
 
-LteHarqBufferRxD2D::LteHarqBufferRxD2D(unsigned int num, LteMacBase *owner, Binder *binder, MacNodeId srcId, bool isMulticast)
-    : LteHarqBufferRx(binder, owner, num, srcId)
+LteHarqBufferRxD2D::LteHarqBufferRxD2D(unsigned int num, LteMacBase *owner, Binder *binder, MacNodeId srcId, double carrierFrequency, bool isMulticast)
+    : LteHarqBufferRx(binder, owner, num, srcId, carrierFrequency)
 {
     initMacUe();
     isMulticast_ = isMulticast;
 
     for (unsigned int i = 0; i < numHarqProcesses_; i++) {
-        processes_[i] = new LteHarqProcessRxD2D(i, macOwner_, binder);
+        processes_[i] = new LteHarqProcessRxD2D(i, macOwner_, binder, slotDuration_);
     }
 
     // Signals initialization: these are used to gather statistics
@@ -64,46 +64,46 @@ void LteHarqBufferRxD2D::insertPdu(Codeword cw, Packet *pkt)
     unsigned char acid = uInfo->getAcid();
     // TODO add codeword to insertPdu
     processes_[acid]->insertPdu(cw, pkt);
+    schedulePendingFeedback(acid, cw);
     // debug output
     EV << "H-ARQ RX: new PDU (id " << pdu->getId() << " ) inserted into process " << (int)acid << endl;
 }
 
 void LteHarqBufferRxD2D::sendFeedback()
 {
-    for (unsigned int i = 0; i < numHarqProcesses_; i++) {
-        for (Codeword cw = 0; cw < MAX_CODEWORDS; ++cw) {
-            if (processes_[i]->isEvaluated(cw)) {
-                // create a copy of the feedback to be sent to the eNB
-                auto pkt = check_and_cast<LteHarqProcessRxD2D *>(processes_[i])->createFeedbackMirror(cw);
-                if (pkt == nullptr) {
-                    EV << NOW << "LteHarqBufferRxD2D::sendFeedback - cw " << cw << " of process " << i
-                       << " contains a PDU belonging to a multicast/broadcast connection. Don't send feedback mirror." << endl;
-                }
-                else {
-                    macOwner_->sendLowerPackets(pkt);
-                }
-
-                auto pktHbf = (processes_[i])->createFeedback(cw);
+    unsigned char i;
+    Codeword cw;
+    while (popDueFeedback(i, cw)) {
+        // create a copy of the feedback to be sent to the eNB
+        auto pkt = check_and_cast<LteHarqProcessRxD2D *>(processes_[i])->createFeedbackMirror(cw);
+        if (pkt == nullptr) {
+            EV << NOW << "LteHarqBufferRxD2D::sendFeedback - cw " << cw << " of process " << (int)i
+               << " contains a PDU belonging to a multicast/broadcast connection. Report the outcome to the transmitter." << endl;
+            check_and_cast<LteHarqProcessRxD2D *>(processes_[i])->reportMulticastOutcome(cw);
+        }
+        else {
+            macOwner_->sendLowerPackets(pkt);
+        }
 
-                if (pktHbf == nullptr) {
-                    EV << NOW << "LteHarqBufferRxD2D::sendFeedback - cw " << cw << " of process " << i
-                       << " contains a PDU belonging to a multicast/broadcast connection. Don't send feedback." << endl;
-                    continue;
-                }
+        auto pktHbf = (processes_[i])->createFeedback(cw);
 
-                auto hfb = pktHbf->peekAtFront<LteHarqFeedback>();
-                // debug output:
-                auto cInfo = pktHbf->getTag<UserControlInfo>();
-                const char *r = hfb->getResult() ? "ACK" : "NACK";
-                EV << "H-ARQ RX: feedback sent to TX process "
-                   << (int)hfb->getAcid() << " Codeword  " << (int)cw
-                   << " of node with id "
-                   << cInfo->getDestId()
-                   << " result: " << r << endl;
-
-                macOwner_->sendLowerPackets(pktHbf);
-            }
+        if (pktHbf == nullptr) {
+            EV << NOW << "LteHarqBufferRxD2D::sendFeedback - cw " << cw << " of process " << (int)i
+               << " contains a PDU belonging to a multicast/broadcast connection. Don't send feedback." << endl;
+            continue;
         }
+
+        auto hfb = pktHbf->peekAtFront<LteHarqFeedback>();
+        // debug output:
+        auto cInfo = pktHbf->getTag<UserControlInfo>();
+        const char *r = hfb->getResult() ? "ACK" : "NACK";
+        EV << "H-ARQ RX: feedback sent to TX process "
+           << (int)hfb->getAcid() << " Codeword  " << (int)cw
+           << " of node with id "
+           << cInfo->getDestId()
+           << " result: " << r << endl;
+
+        macOwner_->sendLowerPackets(pktHbf);
     }
 }
 
@@ -41,13 +41,12 @@ class LteHarqBufferRxD2D : public LteHarqBufferRx
     static inet::simsignal_t macThroughputD2D_;
 
     /**
-     * Checks for all processes if the PDU has been evaluated and sends
-     * feedback if affirmative.
+     * Sends the feedback of the units whose PDU has been evaluated
      */
     void sendFeedback() override;
 
   public:
-    LteHarqBufferRxD2D(unsigned int num, LteMacBase *owner, Binder *binder, MacNodeId srcId, bool isMulticast = false);
+    LteHarqBufferRxD2D(unsigned int num, LteMacBase *owner, Binder *binder, MacNodeId srcId, double carrierFrequency, bool isMulticast = false);
 
     /*
      * Insertion of a new PDU coming from PHY layer into
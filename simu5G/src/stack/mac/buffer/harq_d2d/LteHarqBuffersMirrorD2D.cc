@@ -0,0 +1,143 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#include <algorithm>
+
+#include "stack/mac/buffer/harq_d2d/LteHarqBuffersMirrorD2D.h"
+
+namespace simu5g {
+
+using namespace omnetpp;
+
+LteHarqBuffersMirrorD2D::~LteHarqBuffersMirrorD2D()
+{
+    for (auto& entry : entries_)
+        delete entry.buffer_;
+}
+
+LteHarqBufferMirrorD2D *LteHarqBuffersMirrorD2D::find(const D2DPair& pair) const
+{
+    auto it = slotIndex_.find(pair);
+    return (it != slotIndex_.end()) ? entries_[it->second].buffer_ : nullptr;
+}
+
+LteHarqBufferMirrorD2D *LteHarqBuffersMirrorD2D::at(const D2DPair& pair) const
+{
+    LteHarqBufferMirrorD2D *buffer = find(pair);
+    if (buffer == nullptr)
+        throw cRuntimeError("LteHarqBuffersMirrorD2D::at - no mirror buffer for pair <%hu,%hu>", num(pair.first), num(pair.second));
+    return buffer;
+}
+
+void LteHarqBuffersMirrorD2D::insert(const D2DPair& pair, LteHarqBufferMirrorD2D *buffer)
+{
+    if (slotIndex_.find(pair) != slotIndex_.end())
+        throw cRuntimeError("LteHarqBuffersMirrorD2D::insert - mirror buffer for pair <%hu,%hu> already exists", num(pair.first), num(pair.second));
+
+    Slot slot;
+    if (!freeSlots_.empty()) {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else {
+        slot = entries_.size();
+        entries_.emplace_back();
+    }
+    entries_[slot].pair_ = pair;
+    entries_[slot].buffer_ = buffer;
+    slotIndex_[pair] = slot;
+
+    adjacency_[pair.first].push_back(slot);
+    if (pair.second != pair.first)
+        adjacency_[pair.second].push_back(slot);
+}
+
+void LteHarqBuffersMirrorD2D::unlink(MacNodeId nodeId, Slot slot)
+{
+    auto it = adjacency_.find(nodeId);
+    if (it == adjacency_.end())
+        return;
+    std::vector<Slot>& slots = it->second;
+    auto sit = std::find(slots.begin(), slots.end(), slot);
+    if (sit != slots.end()) {
+        *sit = slots.back();
+        slots.pop_back();
+    }
+    if (slots.empty())
+        adjacency_.erase(it);
+}
+
+void LteHarqBuffersMirrorD2D::erase(Slot slot)
+{
+    Entry& entry = entries_.at(slot);
+    if (entry.buffer_ == nullptr)
+        return;
+
+    unlink(entry.pair_.first, slot);
+    unlink(entry.pair_.second, slot);
+    slotIndex_.erase(entry.pair_);
+    pending_.erase(slot);
+
+    delete entry.buffer_;
+    entry.buffer_ = nullptr;
+    freeSlots_.push_back(slot);
+}
+
+void LteHarqBuffersMirrorD2D::erase(const D2DPair& pair)
+{
+    auto it = slotIndex_.find(pair);
+    if (it != slotIndex_.end())
+        erase(it->second);
+}
+
+void LteHarqBuffersMirrorD2D::eraseNode(MacNodeId nodeId)
+{
+    auto it = adjacency_.find(nodeId);
+    if (it == adjacency_.end())
+        return;
+
+    // erase() updates the adjacency list of the node, hence work on a copy
+    std::vector<Slot> slots = it->second;
+    for (Slot slot : slots)
+        erase(slot);
+}
+
+void LteHarqBuffersMirrorD2D::markPending(const D2DPair& pair)
+{
+    auto it = slotIndex_.find(pair);
+    if (it != slotIndex_.end())
+        pending_.insert(it->second);
+}
+
+std::vector<LteHarqBuffersMirrorD2D::Slot> LteHarqBuffersMirrorD2D::getPendingSlots()
+{
+    std::vector<Slot> slots;
+    slots.reserve(pending_.size());
+    for (auto it = pending_.begin(); it != pending_.end(); ) {
+        if (entries_[*it].buffer_->hasPendingUnits()) {
+            slots.push_back(*it);
+            ++it;
+        }
+        else {
+            it = pending_.erase(it);
+        }
+    }
+    return slots;
+}
+
+void LteHarqBuffersMirrorD2D::markSelectedAsWaiting()
+{
+    // units can only be selected for retransmission in pending slots
+    for (Slot slot : pending_)
+        entries_[slot].buffer_->markSelectedAsWaiting();
+}
+
+} //namespace
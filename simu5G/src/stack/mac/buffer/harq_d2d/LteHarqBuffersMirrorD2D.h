@@ -0,0 +1,101 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_LTEHARQBUFFERSMIRRORD2D_H_
+#define _LTE_LTEHARQBUFFERSMIRRORD2D_H_
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "common/LteCommon.h"
+#include "stack/mac/buffer/harq_d2d/LteHarqBufferMirrorD2D.h"
+
+namespace simu5g {
+
+typedef std::pair<MacNodeId, MacNodeId> D2DPair;
+
+/*
+ * LteHarqBuffersMirrorD2D stores the "mirror" H-ARQ buffers of the D2D pairs
+ * <sender,receiver> served by an eNodeB on one carrier.
+ * Buffers are kept in a dense vector of slots. Each node lists the slots of its
+ * pairs, so that removing a node only touches its own pairs, and the slots that
+ * may need a retransmission are tracked apart, so that the retransmission
+ * scheduling only visits them.
+ */
+class LteHarqBuffersMirrorD2D
+{
+  public:
+    typedef unsigned int Slot;
+
+  private:
+    struct Entry
+    {
+        D2DPair pair_;
+        LteHarqBufferMirrorD2D *buffer_ = nullptr;
+    };
+
+    /// mirror buffers, indexed by slot (free slots have a null buffer)
+    std::vector<Entry> entries_;
+    std::vector<Slot> freeSlots_;
+
+    /// slot of each pair
+    std::map<D2DPair, Slot> slotIndex_;
+
+    /// slots of the pairs where each node is either the sender or the receiver
+    std::map<MacNodeId, std::vector<Slot>> adjacency_;
+
+    /// slots that received a NACK since their last idle check
+    std::set<Slot> pending_;
+
+    void unlink(MacNodeId nodeId, Slot slot);
+    void erase(Slot slot);
+
+  public:
+    LteHarqBuffersMirrorD2D() {}
+    LteHarqBuffersMirrorD2D(const LteHarqBuffersMirrorD2D& other) = delete;
+    LteHarqBuffersMirrorD2D& operator=(const LteHarqBuffersMirrorD2D& other) = delete;
+    ~LteHarqBuffersMirrorD2D();
+
+    /// returns the mirror buffer of the given pair, or nullptr if it does not exist
+    LteHarqBufferMirrorD2D *find(const D2DPair& pair) const;
+    /// returns the mirror buffer of the given pair, which must exist
+    LteHarqBufferMirrorD2D *at(const D2DPair& pair) const;
+
+    /// stores the mirror buffer of a new pair, taking its ownership
+    void insert(const D2DPair& pair, LteHarqBufferMirrorD2D *buffer);
+    /// deletes the mirror buffer of the given pair, if any
+    void erase(const D2DPair& pair);
+    /// deletes the mirror buffers of all the pairs of the given node
+    void eraseNode(MacNodeId nodeId);
+
+    /// notifies that the buffer of the given pair received feedback, i.e. it may need a retransmission
+    void markPending(const D2DPair& pair);
+
+    /**
+     * Returns the slots whose buffers have units buffered for (or selected for)
+     * retransmission. Slots found idle are dropped from the pending set
+     */
+    std::vector<Slot> getPendingSlots();
+
+    const D2DPair& getPair(Slot slot) const { return entries_.at(slot).pair_; }
+    LteHarqBufferMirrorD2D *getBuffer(Slot slot) const { return entries_.at(slot).buffer_; }
+
+    /// marks the units selected for retransmission in this slot as waiting for feedback
+    void markSelectedAsWaiting();
+
+    unsigned int size() const { return slotIndex_.size(); }
+    bool empty() const { return slotIndex_.empty(); }
+};
+
+} //namespace
+
+#endif
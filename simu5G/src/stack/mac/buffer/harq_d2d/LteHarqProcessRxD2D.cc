@@ -12,6 +12,7 @@
 #include "stack/mac/buffer/harq_d2d/LteHarqProcessRxD2D.h"
 #include "stack/mac/LteMacBase.h"
 #include "stack/mac/LteMacEnb.h"
+#include "stack/mac/LteMacUeD2D.h"
 #include "common/LteControlInfo.h"
 #include "stack/mac/packet/LteHarqFeedback_m.h"
 #include "stack/mac/packet/LteMacPdu.h"
@@ -20,8 +21,8 @@ namespace simu5g {
 
 using namespace omnetpp;
 
-LteHarqProcessRxD2D::LteHarqProcessRxD2D(unsigned char acid, LteMacBase *owner, Binder *binder)
-    : LteHarqProcessRx(acid, owner, binder)
+LteHarqProcessRxD2D::LteHarqProcessRxD2D(unsigned char acid, LteMacBase *owner, Binder *binder, double slotDuration)
+    : LteHarqProcessRx(acid, owner, binder, slotDuration)
 {
 }
 
@@ -126,5 +127,22 @@ Packet *LteHarqProcessRxD2D::createFeedbackMirror(Codeword cw)
     return pkt;
 }
 
+void LteHarqProcessRxD2D::reportMulticastOutcome(Codeword cw)
+{
+    if (!isEvaluated(cw))
+        throw cRuntimeError("Cannot report the outcome of a PDU not in EVALUATING state");
+
+    auto pduInfo = pdu_.at(cw)->getTag<UserControlInfo>();
+    auto pdu = pdu_.at(cw)->peekAtFront<LteMacPdu>();
+
+    // the transmitter may have left the simulation
+    LteMacUeD2D *txMac = dynamic_cast<LteMacUeD2D *>(getMacByMacNodeId(binder_, pduInfo->getSourceId()));
+    if (txMac == nullptr)
+        return;
+
+    txMac->recordMulticastOutcome(pdu->getMacPduId(), pduInfo->getMulticastGroupId(), pduInfo->getCarrierFrequency(),
+            acid_, cw, pdu->getByteLength(), result_.at(cw));
+}
+
 } //namespace
 
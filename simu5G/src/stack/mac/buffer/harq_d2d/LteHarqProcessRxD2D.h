@@ -34,9 +34,9 @@ class LteHarqProcessRxD2D : public LteHarqProcessRx
      * Constructor.
      *
      * @param acid process identifier
-     * @param
+     * @param slotDuration slot duration of the carrier the process receives on
      */
-    LteHarqProcessRxD2D(unsigned char acid, LteMacBase *owner, Binder *binder);
+    LteHarqProcessRxD2D(unsigned char acid, LteMacBase *owner, Binder *binder, double slotDuration);
 
     /**
      * Creates a feedback message based on the evaluation result for this PDU.
@@ -52,6 +52,13 @@ class LteHarqProcessRxD2D : public LteHarqProcessRx
      */
     virtual inet::Packet *createFeedbackMirror(Codeword cw);
 
+    /**
+     * Reports the evaluation result of a multicast PDU to its transmitter, on the feedback
+     * resource shared by the receivers of the group. The transmitter aggregates the results
+     * of all the receivers and reports the outcome of the group transmission to the eNB
+     */
+    virtual void reportMulticastOutcome(Codeword cw);
+
 };
 
 } //namespace
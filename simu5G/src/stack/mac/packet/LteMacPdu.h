@@ -31,6 +31,7 @@ class LteMacPdu : public LteMacPdu_Base
     void copy(const LteMacPdu& other) {
         macPduLength_ = other.macPduLength_;
         macPduId_ = other.macPduId_;
+        rtxCodingRatio_ = other.rtxCodingRatio_;
         sduList_ = other.sduList_->dup();
         take(sduList_);
         // duplicate MacControlElementsList (includes BSRs)
@@ -78,6 +79,9 @@ class LteMacPdu : public LteMacPdu_Base
     int64_t macPduId_;
     static int64_t numMacPdus_;
 
+    /// Fraction of the coded bits of the PDU carried by an adaptive retransmission (1 if not shrunk)
+    double rtxCodingRatio_ = 1.0;
+
   public:
 
     /**
@@ -284,6 +288,17 @@ class LteMacPdu : public LteMacPdu_Base
         return macPduId_;
     }
 
+    double getRtxCodingRatio() const
+    {
+        return rtxCodingRatio_;
+    }
+
+    void setRtxCodingRatio(double ratio)
+    {
+        handleChange();
+        rtxCodingRatio_ = ratio;
+    }
+
     void setHeaderLength(unsigned int headerLength) override
     {
         LteMacPdu_Base::setHeaderLength(headerLength);
@@ -26,6 +26,8 @@ class LteSchedulingGrant : public LteSchedulingGrant_Base
 {
   private:
     void copy(const LteSchedulingGrant& other) {
+        // the grant owns its UserTxParams: release the current one before copying
+        delete userTxParams;
         if (other.userTxParams != nullptr) {
             userTxParams = other.userTxParams->dup();
         }
@@ -89,9 +91,14 @@ class LteSchedulingGrant : public LteSchedulingGrant_Base
         return userTxParams;
     }
 
+    // the granted blocks only list the allocated bands, any other band has 0 blocks
     const unsigned int getBlocks(Remote antenna, Band b) const
     {
-        return grantedBlocks.at(antenna).at(b);
+        auto it = grantedBlocks.find(antenna);
+        if (it == grantedBlocks.end())
+            return 0;
+        auto jt = it->second.find(b);
+        return (jt != it->second.end()) ? jt->second : 0;
     }
 
     void setBlocks(Remote antenna, Band b, const unsigned int blocks)
@@ -0,0 +1,213 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_BANDSCOREINDEX_H_
+#define _LTE_BANDSCOREINDEX_H_
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace simu5g {
+
+/**
+ * Per-band ranking of the UEs by score (e.g. bytes per block on the band, see LteMaxCiMultiband).
+ *
+ * The ranking is kept across slots: a UE is only repositioned when its scores change (e.g. on a
+ * CQI report) or when it enters or leaves the set of backlogged UEs, instead of being rebuilt
+ * every slot. The scores are expected to take few distinct values (they derive from the CQI), so
+ * each band keeps one bucket of UEs per score: repositioning a UE on a band costs a binary search
+ * in its bucket, with no allocation once the buckets are in place.
+ * The changes are applied at the start of the next pass: when more than a quarter of the UEs
+ * changed, the buckets are refilled from scratch instead, which is cheaper than repositioning
+ * each UE (see tests/bench/MaxCiMultibandBench.cc).
+ * A UE with score 0 on a band is not ranked on that band. Among UEs with the same score, the one
+ * with the highest ID comes first.
+ */
+template<typename Id>
+class BandScoreIndex
+{
+  public:
+    typedef std::pair<unsigned int, Id> Entry;
+
+  protected:
+    // distinct scores seen so far, from the highest, and position of each score in levels_
+    std::vector<unsigned int> levels_;
+    std::vector<int> levelOf_;
+
+    // for each band and level, the UEs with that score on the band, from the highest ID
+    std::vector<std::vector<std::vector<Id>>> bands_;
+
+    // scores of each UE, one per band
+    std::map<Id, std::vector<unsigned int>> scores_;
+
+    // UEs changed since the last pass, with the scores they are ranked with (empty if not ranked)
+    std::map<Id, std::vector<unsigned int>> changed_;
+
+    // search position (level, UE in the bucket) of each band in the current pass
+    std::vector<std::pair<size_t, size_t>> cursors_;
+
+    // returns the bucket of the given score on the band, adding a level to all the bands for a new score
+    std::vector<Id>& getBucket(unsigned int band, unsigned int score)
+    {
+        if (score >= levelOf_.size())
+            levelOf_.resize(score + 1, -1);
+        if (levelOf_[score] < 0) {
+            auto pos = std::lower_bound(levels_.begin(), levels_.end(), score, std::greater<unsigned int>()) - levels_.begin();
+            levels_.insert(levels_.begin() + pos, score);
+            for (auto& buckets : bands_)
+                buckets.insert(buckets.begin() + pos, std::vector<Id>());
+            for (size_t l = pos; l < levels_.size(); l++)
+                levelOf_[levels_[l]] = l;
+        }
+        return bands_[band][levelOf_[score]];
+    }
+
+    void insert(unsigned int band, unsigned int score, Id id)
+    {
+        std::vector<Id>& ids = getBucket(band, score);
+        ids.insert(std::lower_bound(ids.begin(), ids.end(), id, std::greater<Id>()), id);
+    }
+
+    void erase(unsigned int band, unsigned int score, Id id)
+    {
+        std::vector<Id>& ids = getBucket(band, score);
+        auto it = std::lower_bound(ids.begin(), ids.end(), id, std::greater<Id>());
+        if (it != ids.end() && *it == id)
+            ids.erase(it);
+    }
+
+    // repositions the changed UEs, or refills all the buckets if many UEs changed
+    void applyChanges()
+    {
+        if (changed_.empty())
+            return;
+
+        if (changed_.size() * 4 > scores_.size()) {
+            for (auto& buckets : bands_) {
+                for (auto& ids : buckets)
+                    ids.clear();
+            }
+            // in decreasing ID order, each UE is appended to its buckets
+            for (auto it = scores_.rbegin(); it != scores_.rend(); ++it) {
+                for (unsigned int i = 0; i < bands_.size(); i++) {
+                    if (it->second[i] > 0)
+                        getBucket(i, it->second[i]).push_back(it->first);
+                }
+            }
+        }
+        else {
+            for (const auto& [id, previous] : changed_) {
+                auto it = scores_.find(id);
+                for (unsigned int i = 0; i < bands_.size(); i++) {
+                    unsigned int before = previous.empty() ? 0 : previous[i];
+                    unsigned int after = (it == scores_.end()) ? 0 : it->second[i];
+                    if (before == after)
+                        continue;
+                    if (before > 0)
+                        erase(i, before, id);
+                    if (after > 0)
+                        insert(i, after, id);
+                }
+            }
+        }
+        changed_.clear();
+    }
+
+  public:
+    /**
+     * Drops all the UEs and sets the number of bands
+     */
+    void reset(unsigned int numBands)
+    {
+        levels_.clear();
+        levelOf_.clear();
+        bands_.assign(numBands, std::vector<std::vector<Id>>());
+        scores_.clear();
+        changed_.clear();
+        cursors_.clear();
+    }
+
+    unsigned int getNumBands() const { return bands_.size(); }
+
+    /**
+     * Inserts a UE or updates its scores, one per band
+     */
+    void update(Id id, const std::vector<unsigned int>& scores)
+    {
+        auto it = scores_.find(id);
+        if (it == scores_.end()) {
+            changed_.emplace(id, std::vector<unsigned int>());
+            it = scores_.emplace(id, std::vector<unsigned int>()).first;
+        }
+        else
+            changed_.emplace(id, it->second);
+        it->second.assign(bands_.size(), 0);
+        std::copy_n(scores.begin(), std::min(scores.size(), bands_.size()), it->second.begin());
+    }
+
+    /**
+     * Removes a UE from all the bands
+     */
+    void remove(Id id)
+    {
+        auto it = scores_.find(id);
+        if (it == scores_.end())
+            return;
+        changed_.emplace(id, std::move(it->second));
+        scores_.erase(it);
+    }
+
+    bool contains(Id id) const { return scores_.find(id) != scores_.end(); }
+
+    size_t size() const { return scores_.size(); }
+
+    /// UEs in ID order, with their scores
+    const std::map<Id, std::vector<unsigned int>>& getScores() const { return scores_; }
+
+    /**
+     * Starts a pass of band assignments: the search on each band restarts from its best UE.
+     * No UE can be updated or removed until the end of the pass
+     */
+    void startPass()
+    {
+        applyChanges();
+        cursors_.assign(bands_.size(), { 0, 0 });
+    }
+
+    /**
+     * Returns in entry the best UE on the band among the ones for which excluded() returns false.
+     * A UE excluded during a pass must stay excluded until its end, so that it is skipped only once
+     * @return false if no UE is left on the band
+     */
+    template<typename Excluded>
+    bool getBest(unsigned int band, Excluded excluded, Entry& entry)
+    {
+        auto& [level, pos] = cursors_.at(band);
+        const auto& buckets = bands_[band];
+        for ( ; level < buckets.size(); level++, pos = 0) {
+            for ( ; pos < buckets[level].size(); pos++) {
+                Id id = buckets[level][pos];
+                if (!excluded(id)) {
+                    entry = { levels_[level], id };
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+} //namespace
+
+#endif
@@ -0,0 +1,89 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_GRANTSPLIT_H_
+#define _LTE_GRANTSPLIT_H_
+
+#include <algorithm>
+#include <vector>
+
+namespace simu5g {
+
+/**
+ * Splits the bytes of a UE grant across its connections (see LteSchedulerEnb::scheduleUeGrant()).
+ *
+ * The strict priority connections (e.g. QFI 4) are served first, up to their needs and in the given
+ * order. The remaining bytes are split across the other connections in proportion to their weights,
+ * without exceeding the needs of each connection: what a connection cannot use is shared among the
+ * other ones.
+ *
+ * @param bytes Bytes to split
+ * @param weights Weight of each connection
+ * @param strict Whether each connection has strict priority over the weighted ones
+ * @param needs Bytes each connection can use at most
+ * @param split Filled with the bytes given to each connection
+ */
+inline void splitGrantBytes(unsigned int bytes, const std::vector<double>& weights, const std::vector<bool>& strict,
+        const std::vector<unsigned int>& needs, std::vector<unsigned int>& split)
+{
+    split.assign(weights.size(), 0);
+    for (size_t i = 0; i < weights.size() && bytes > 0; i++) {
+        if (!strict[i])
+            continue;
+        split[i] = std::min(needs[i], bytes);
+        bytes -= split[i];
+    }
+
+    std::vector<bool> open(weights.size());
+    double openWeight = 0;
+    for (size_t i = 0; i < weights.size(); i++) {
+        open[i] = !strict[i] && needs[i] > 0;
+        if (open[i])
+            openWeight += weights[i];
+    }
+
+    while (bytes > 0 && openWeight > 0) {
+        unsigned int assigned = 0;
+        bool saturated = false;
+        for (size_t i = 0; i < weights.size(); i++) {
+            if (!open[i])
+                continue;
+            unsigned int quota = std::min(needs[i] - split[i], (unsigned int)(bytes * weights[i] / openWeight));
+            split[i] += quota;
+            assigned += quota;
+            saturated = saturated || split[i] == needs[i];
+        }
+        bytes -= assigned;
+
+        // the connections that reached their need leave the remaining bytes to the other ones
+        for (size_t i = 0; i < weights.size(); i++) {
+            if (open[i] && split[i] == needs[i]) {
+                open[i] = false;
+                openWeight -= weights[i];
+            }
+        }
+        if (!saturated) {
+            // rounding leftover: give it to the connections in the given order
+            for (size_t i = 0; i < weights.size() && bytes > 0; i++) {
+                if (!open[i])
+                    continue;
+                unsigned int extra = std::min(needs[i] - split[i], bytes);
+                split[i] += extra;
+                bytes -= extra;
+            }
+            break;
+        }
+    }
+}
+
+} //namespace
+
+#endif
@@ -0,0 +1,105 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+#ifndef _LTE_LCGPACKING_H_
+#define _LTE_LCGPACKING_H_
+
+#include <algorithm>
+
+namespace simu5g {
+
+/**
+ * Inserts a connection in a LCG map (see LteMacBase::registerLcgConnection()), keeping the
+ * connections of each traffic class sorted by priority level (the lower, the higher the priority).
+ * Connections with the same priority level are kept in registration order.
+ *
+ * @param lcgMap Multimap from traffic class to connection
+ * @param tClass Traffic class of the connection
+ * @param entry Connection to insert
+ * @param priorityLevel Returns the priority level of a connection of the map
+ * @return the position of the inserted connection
+ */
+template<typename LcgMapType, typename PriorityLevelFn>
+typename LcgMapType::iterator insertByPriorityLevel(LcgMapType& lcgMap, const typename LcgMapType::key_type& tClass,
+        const typename LcgMapType::mapped_type& entry, PriorityLevelFn priorityLevel)
+{
+    // insert before the first connection of the same class with a lower priority
+    int level = priorityLevel(entry);
+    auto range = lcgMap.equal_range(tClass);
+    auto pos = range.first;
+    while (pos != range.second && priorityLevel(pos->second) <= level)
+        ++pos;
+    return lcgMap.emplace_hint(pos, tClass, entry);
+}
+
+/**
+ * Packs a UE grant on its connections, visited in priority order (see LcgScheduler::schedule()).
+ *
+ * Each connection takes as much of the grant as it needs, leaving any remainder to the next
+ * one. The first connection served also pays for the MAC header. The grant is filled as soon as
+ * it cannot carry a minimum SDU anymore, so that the scheduler stops visiting connections.
+ */
+class LcgGrantPacker
+{
+  protected:
+    unsigned int availableBytes_;
+    unsigned int macHeader_;
+    unsigned int minSduBytes_;
+    bool first_ = true;
+
+  public:
+    /**
+     * @param availableBytes Size of the grant
+     * @param macHeader Size of the MAC header, paid by the first connection served
+     * @param minSduBytes The grant is filled when it has no more than these bytes left (besides the MAC header)
+     */
+    LcgGrantPacker(unsigned int availableBytes, unsigned int macHeader, unsigned int minSduBytes) :
+        availableBytes_(availableBytes), macHeader_(macHeader), minSduBytes_(minSduBytes)
+    {
+    }
+
+    /**
+     * Returns true if the grant cannot carry a minimum SDU anymore
+     */
+    bool isFilled() const { return availableBytes_ <= (first_ ? macHeader_ : 0) + minSduBytes_; }
+
+    /**
+     * Returns true if no connection has been served yet
+     */
+    bool isFirst() const { return first_; }
+
+    /**
+     * Returns true if the given bytes (RLC headers included) fit the rest of the grant
+     */
+    bool fits(unsigned int bytes) const { return bytes + (first_ ? macHeader_ : 0) <= availableBytes_; }
+
+    unsigned int getAvailableBytes() const { return availableBytes_; }
+
+    /**
+     * Serves a connection needing the given bytes (RLC headers included).
+     * @return the bytes given to the connection, MAC header excluded
+     */
+    unsigned int serve(unsigned int bytes)
+    {
+        if (bytes == 0 || isFilled())
+            return 0;
+
+        unsigned int header = first_ ? macHeader_ : 0;
+        unsigned int taken = std::min(bytes + header, availableBytes_);
+        availableBytes_ -= taken;
+        first_ = false;
+        return taken - header;
+    }
+};
+
+} //namespace
+
+#endif
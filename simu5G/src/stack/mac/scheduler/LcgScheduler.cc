@@ -11,6 +11,7 @@
 
 #include "stack/mac/scheduler/LcgScheduler.h"
 #include "stack/mac/buffer/LteMacBuffer.h"
+#include "stack/mac/scheduler/LcgPacking.h"
 
 namespace simu5g {
 
@@ -53,7 +54,9 @@ ScheduleList& LcgScheduler::schedule(unsigned int availableBytes, Direction gran
     // phase), if false, provide a best effort service (LCP second phase)
     bool priorityService = true;
 
-    bool firstSdu = true;
+    // connections of a traffic class are sorted by priority level, hence the grant is packed on
+    // them in priority order, any remainder going to the next QFI
+    LcgGrantPacker packer(availableBytes, MAC_HEADER, RLC_HEADER_UM);
 
     LcgMap& lcgMap = mac_->getLcgMap();
 
@@ -61,7 +64,7 @@ ScheduleList& LcgScheduler::schedule(unsigned int availableBytes, Direction gran
         return scheduleList_;
 
     // for all traffic classes
-    for (unsigned short i = 0; i < UNKNOWN_TRAFFIC_TYPE; ++i) {
+    for (unsigned short i = 0; i < UNKNOWN_TRAFFIC_TYPE && !packer.isFilled(); ++i) {
         // Prepare the iterators to cycle the entire scheduling set
         std::pair<LcgMap::iterator, LcgMap::iterator> it_pair;
         it_pair = lcgMap.equal_range((LteTrafficClass)i);
@@ -121,14 +124,11 @@ ScheduleList& LcgScheduler::schedule(unsigned int availableBytes, Direction gran
                 continue; // go to next connection
             }
             else {
-                // we need to consider also the size of RLC and MAC headers
+                // we need to consider also the size of RLC headers, the MAC header is paid by the first connection served
                 if (connDesc.getRlcType() == UM)
                     toServe += RLC_HEADER_UM;
                 else if (connDesc.getRlcType() == AM)
                     toServe += RLC_HEADER_AM;
-
-                if (firstSdu)
-                    toServe += MAC_HEADER;
             }
 
             // get a pointer to the appropriate status element: we need a tracing element
@@ -188,87 +188,35 @@ ScheduleList& LcgScheduler::schedule(unsigned int availableBytes, Direction gran
                 EV << NOW << " LcgScheduler::schedule Bucket size: " << bucket << " bytes (max size " << maximumBucketSize << " bytes) - AFTER SERVICE " << endl;
             }
 
-            EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << ", remaining grant: " << availableBytes << " bytes " << endl;
+            EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << ", remaining grant: " << packer.getAvailableBytes() << " bytes " << endl;
             EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << " buffer Size: " << toServe << " bytes " << endl;
 
-            int minBytes = firstSdu ? MAC_HEADER + RLC_HEADER_UM : RLC_HEADER_UM;
-
             // If priority service: (availableBytes>0) && (desc->buffer_.occupancy() > 0) && (desc->parameters_.bucket_ > 0)
             // If best effort service: (availableBytes>0) && (desc->buffer_.occupancy() > 0)
-            if ((availableBytes > minBytes) && (toServe > 0)
-                && (!priorityService || true /*TODO (desc->parameters_.bucket_ > 0)*/))
-            {
-                // Check if it is possible to serve the sdu, depending on the constraint
-                // of the type of service
-                // Priority service:
-                //    ( sdu->size() <= availableBytes) && ( sdu->size() <= desc->parameters_.bucket_)
-                // Best Effort service:
-                //    ( sdu->size() <= availableBytes) && (!priorityService_)
-
-                if ((toServe <= availableBytes) /*&& ( !priorityService || ( sduSize <= 0) ) // TODO desc->parameters_.bucket_*/) {
-                    // remove SDU from virtual buffer
-                    vQueue->popFront();
-
-                    if (priorityService) {
-                    }
-
-                    // check if there is space for a SDU
-                    int alloc = toServe;
-                    if (firstSdu) {
-                        alloc -= MAC_HEADER;
-                        firstSdu = false;
-                    }
-
-                    // update the tracing element
-                    elem->occupancy_ = vQueue->getQueueOccupancy();
-                    elem->sentData_ += alloc;
+            if (!packer.isFilled() && toServe > 0) {
+                // the connection is served up to its whole backlog, otherwise it takes the rest of the grant
+                bool whole = packer.fits(toServe);
+                unsigned int sent = packer.serve(toServe);
 
-                    if (connDesc.getRlcType() == UM)
-                        alloc -= RLC_HEADER_UM;
-                    else if (connDesc.getRlcType() == AM)
-                        alloc -= RLC_HEADER_AM;
+                // update the tracing element
+                elem->sentData_ += sent;
 
-                    if (alloc > 0)
-                        elem->sentSdus_++;
+                int alloc = sent;
+                if (connDesc.getRlcType() == UM)
+                    alloc -= RLC_HEADER_UM;
+                else if (connDesc.getRlcType() == AM)
+                    alloc -= RLC_HEADER_AM;
 
-                    availableBytes -= toServe;
+                // check if there is space for a SDU
+                if (alloc > 0)
+                    elem->sentSdus_++;
 
-                    while (!vQueue->isEmpty()) {
-                        // remove SDUs from virtual buffer
+                // update buffer
+                if (whole) {
+                    while (!vQueue->isEmpty())
                         vQueue->popFront();
-                    }
-
-                    toServe = 0;
-
-                    EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << ",  SDU of size " << elem->sentData_ << " selected for transmission" << endl;
-                    EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << ", remaining grant: " << availableBytes << " bytes" << endl;
-                    EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << " buffer Size: " << toServe << " bytes" << endl;
                 }
                 else {
-
-                    if (priorityService) {
-                    }
-
-                    int alloc = availableBytes;
-                    if (firstSdu) {
-                        alloc -= MAC_HEADER;
-                        firstSdu = false;
-                    }
-
-                    // update the tracing element
-                    elem->occupancy_ = vQueue->getQueueOccupancy();
-                    elem->sentData_ += alloc;
-
-                    if (connDesc.getRlcType() == UM)
-                        alloc -= RLC_HEADER_UM;
-                    else if (connDesc.getRlcType() == AM)
-                        alloc -= RLC_HEADER_AM;
-
-                    // check if there is space for a SDU
-                    if (alloc > 0)
-                        elem->sentSdus_++;
-
-                    // update buffer
                     while (alloc > 0) {
                         // update pkt info
                         PacketInfo newPktInfo = vQueue->popFront();
@@ -281,21 +229,15 @@ ScheduleList& LcgScheduler::schedule(unsigned int availableBytes, Direction gran
                             alloc -= newPktInfo.first;
                         }
                     }
-
-                    toServe -= availableBytes;
-                    availableBytes = 0;
-
-                    EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << ",  SDU of size " << elem->sentData_ << " selected for transmission" << endl;
-                    EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << ", remaining grant: " << availableBytes << " bytes" << endl;
-                    EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << " buffer Size: " << toServe << " bytes" << endl;
                 }
-            }
+                elem->occupancy_ = vQueue->getQueueOccupancy();
+                toServe -= sent;
 
-            // check if flow is still backlogged
-            if (availableBytes > minBytes) {
-                // TODO the priority is higher when the associated integer is lower ( e.g. priority 2 is
-                // greater than 4 )
+                EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << ",  SDU of size " << elem->sentData_ << " selected for transmission" << endl;
+                EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << ", remaining grant: " << packer.getAvailableBytes() << " bytes" << endl;
+                EV << NOW << " LcgScheduler::schedule - Node " << mac_->getMacNodeId() << " buffer Size: " << toServe << " bytes" << endl;
             }
+
             if (elem->sentSdus_ > 0) {
                 // update the last schedule time
                 lastExecutionTime_ = NOW;
@@ -330,6 +272,10 @@ ScheduleList& LcgScheduler::schedule(unsigned int availableBytes, Direction gran
                 i = 0;
                 EV << "LcgScheduler::schedule - Node" << mac_->getMacNodeId() << ", Starting best effort service" << endl;
             }
+
+            // stop as soon as the grant cannot carry a minimum SDU
+            if (packer.isFilled())
+                break;
         } // END of connections cycle
     } // END of Traffic Classes cycle
 
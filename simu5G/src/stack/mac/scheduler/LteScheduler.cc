@@ -42,6 +42,21 @@ void LteScheduler::initializeBandLimit()
     }
 }
 
+void LteScheduler::setBandwidthPart(unsigned int index)
+{
+    bandwidthPart_ = &(mac_->getBandwidthParts().at(index));
+    bandwidthPartIndex_ = index;
+    numerologyIndex_ = bandwidthPart_->numerologyIndex;
+
+    // bands of the carrier outside the BWP are marked as not usable
+    bwpBandLimit_ = *bandLimit_;
+    for (auto& elem : bwpBandLimit_) {
+        if (elem.band_ < bandwidthPart_->firstBand || elem.band_ > bandwidthPart_->lastBand)
+            elem.limit_.assign(elem.limit_.size(), -2);
+    }
+    bandLimit_ = &bwpBandLimit_;
+}
+
 void LteScheduler::initializeSchedulerPeriodCounter(NumerologyIndex maxNumerologyIndex)
 {
     // 2^(maxNumerologyIndex - numerologyIndex)
@@ -74,6 +89,22 @@ unsigned int LteScheduler::requestGrant(MacCid cid, unsigned int bytes, bool& te
     return eNbScheduler_->scheduleGrant(cid, bytes, terminate, active, eligible, carrierFrequency_, bandLim);
 }
 
+unsigned int LteScheduler::requestUeGrant(const std::vector<std::pair<MacCid, double>>& shares, unsigned int bytes, bool& terminate, bool& active, bool& eligible,
+        std::vector<unsigned int>& grantedBytes, BandLimitVector *bandLim)
+{
+    if (bandLim == nullptr) {
+        // reset the band limit vector used for requesting grants
+        for (unsigned int i = 0; i < bandLimit_->size(); i++) {
+            // copy the element
+            slotReqGrantBandLimit_[i].band_ = bandLimit_->at(i).band_;
+            slotReqGrantBandLimit_[i].limit_ = bandLimit_->at(i).limit_;
+        }
+        bandLim = &slotReqGrantBandLimit_;
+    }
+
+    return eNbScheduler_->scheduleUeGrant(shares, bytes, terminate, active, eligible, carrierFrequency_, grantedBytes, bandLim);
+}
+
 unsigned int LteScheduler::requestGrantBackground(MacCid bgCid, unsigned int bytes, bool& terminate, bool& active, bool& eligible, BandLimitVector *bandLim)
 {
     if (bandLim == nullptr) {
@@ -145,7 +176,9 @@ bool LteScheduler::scheduleRacRequests()
         slotRacBandLimit_[i].limit_ = bandLimit_->at(i).limit_;
     }
 
-    return eNbScheduler_->racschedule(carrierFrequency_, &slotRacBandLimit_);
+    // with bandwidth parts, only the requests for this BWP
+    int bandwidthPart = (bandwidthPart_ != nullptr) ? (int)bandwidthPartIndex_ : -1;
+    return eNbScheduler_->racschedule(carrierFrequency_, &slotRacBandLimit_, bandwidthPart);
 }
 
 void LteScheduler::schedule()
@@ -169,8 +202,12 @@ void LteScheduler::buildCarrierActiveConnectionSet()
 
     const UeSet& carrierUeSet = binder_->getCarrierUeSet(carrierFrequency_);
     for (auto& activeConnection : *activeConnectionSet_) {
-        if (carrierUeSet.find(MacCidToNodeId(activeConnection)) != carrierUeSet.end())
-            carrierActiveConnectionSet_.insert(activeConnection);
+        if (carrierUeSet.find(MacCidToNodeId(activeConnection)) == carrierUeSet.end())
+            continue;
+        // with bandwidth parts, only connections whose QFI is mapped onto this BWP
+        if (bandwidthPart_ != nullptr && mac_->getBandwidthPart(activeConnection) != bandwidthPartIndex_)
+            continue;
+        carrierActiveConnectionSet_.insert(activeConnection);
     }
 }
 
@@ -88,6 +88,13 @@ class LteScheduler
     //! Set of bands available for this carrier
     BandLimitVector *bandLimit_ = nullptr;
 
+    //! Bandwidth part handled by this scheduler (nullptr if it handles the whole carrier) and its index
+    const BandwidthPart *bandwidthPart_ = nullptr;
+    unsigned int bandwidthPartIndex_ = 0;
+
+    //! Set of bands available for this bandwidth part (bands outside the BWP are not usable)
+    BandLimitVector bwpBandLimit_;
+
     //! Set of bands available for this carrier for retransmissions (reset on every slot)
     BandLimitVector slotRacBandLimit_;
 
@@ -140,6 +147,17 @@ class LteScheduler
      */
     void initializeBandLimit();
 
+    /*
+     * Restricts this scheduler to the given bandwidth part of its carrier
+     * (to be called after initializeBandLimit())
+     */
+    void setBandwidthPart(unsigned int index);
+
+    /**
+     * Returns the bandwidth part handled by this scheduler, nullptr if it handles the whole carrier
+     */
+    const BandwidthPart *getBandwidthPart() { return bandwidthPart_; }
+
     /*
      * Set the period counter
      */
@@ -190,6 +208,10 @@ class LteScheduler
     /// Performs request of grant to the eNbScheduler
     virtual unsigned int requestGrant(MacCid cid, unsigned int bytes, bool& terminate, bool& active, bool& eligible, std::vector<BandLimit> *bandLim = nullptr);
 
+    /// Performs request of a single grant for several connections of the same UE to the eNbScheduler
+    virtual unsigned int requestUeGrant(const std::vector<std::pair<MacCid, double>>& shares, unsigned int bytes, bool& terminate, bool& active, bool& eligible,
+            std::vector<unsigned int>& grantedBytes, std::vector<BandLimit> *bandLim = nullptr);
+
     /// Performs request of background grant to the eNbScheduler
     virtual unsigned int requestGrantBackground(MacCid bgCid, unsigned int bytes, bool& terminate, bool& active, bool& eligible, std::vector<BandLimit> *bandLim = nullptr);
 
@@ -207,6 +229,13 @@ class LteScheduler
     {
     }
 
+    /**
+     * Releases the per-connection state kept for the given UE (called on detach or handover)
+     */
+    virtual void removeConnections(MacNodeId nodeId)
+    {
+    }
+
   protected:
 
     /*
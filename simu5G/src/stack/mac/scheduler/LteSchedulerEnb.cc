@@ -11,6 +11,7 @@
 //
 
 #include "stack/mac/scheduler/LteSchedulerEnb.h"
+#include "stack/mac/scheduler/GrantSplit.h"
 #include "stack/mac/allocator/LteAllocationModule.h"
 #include "stack/mac/allocator/LteAllocationModuleFrequencyReuse.h"
 #include "stack/mac/scheduler/LteScheduler.h"
@@ -34,6 +35,9 @@ using namespace omnetpp;
 // Initialize statistics
 simsignal_t LteSchedulerEnb::avgServedBlocksDlSignal_ = cComponent::registerSignal("avgServedBlocksDl");
 simsignal_t LteSchedulerEnb::avgServedBlocksUlSignal_ = cComponent::registerSignal("avgServedBlocksUl");
+simsignal_t LteSchedulerEnb::servedBytesPerBlockSignal_[2] = { cComponent::registerSignal("servedBytesPerBlockDl"), cComponent::registerSignal("servedBytesPerBlockUl") };
+simsignal_t LteSchedulerEnb::rbUtilizationSignal_[2] = { cComponent::registerSignal("rbUtilizationDl"), cComponent::registerSignal("rbUtilizationUl") };
+simsignal_t LteSchedulerEnb::txEnergySignal_[2] = { cComponent::registerSignal("txEnergyDl"), cComponent::registerSignal("txEnergyUl") };
 
 LteSchedulerEnb::LteSchedulerEnb() : mac_(nullptr)
 {
@@ -61,17 +65,7 @@ LteSchedulerEnb& LteSchedulerEnb::operator=(const LteSchedulerEnb& other)
 
     // Copy schedulers
     SchedDiscipline discipline = mac_->getSchedDiscipline(direction_);
-
-    const CarrierInfoMap *carriers = mac_->getCellInfo()->getCarrierInfoMap();
-    LteScheduler *newSched = nullptr;
-    for (auto& item : *carriers) {
-        newSched = getScheduler(discipline);
-        newSched->setEnbScheduler(this);
-        newSched->setCarrierFrequency(item.second.carrierFrequency);
-        newSched->setNumerologyIndex(item.second.numerologyIndex);     // set periodicity for this scheduler according to numerology
-        newSched->initializeBandLimit();
-        scheduler_.push_back(newSched);
-    }
+    createSchedulers(discipline);
 
     // Copy Allocator
     if (discipline == ALLOCATOR_BESTFIT)                                            // NOTE: create this type of allocator for every scheduler using Frequency Reuse
@@ -102,19 +96,9 @@ void LteSchedulerEnb::initialize(Direction dir, LteMacEnb *mac, Binder *binder)
     harqTxBuffers_ = mac_->getHarqTxBuffers();
     harqRxBuffers_ = mac_->getHarqRxBuffers();
 
-    // Create LteScheduler. One per carrier
+    // Create LteScheduler. One per carrier (or one per bandwidth part of each carrier)
     SchedDiscipline discipline = mac_->getSchedDiscipline(direction_);
-
-    LteScheduler *newSched = nullptr;
-    const CarrierInfoMap *carriers = mac_->getCellInfo()->getCarrierInfoMap();
-    for (auto& item : *carriers) {
-        newSched = getScheduler(discipline);
-        newSched->setEnbScheduler(this);
-        newSched->setCarrierFrequency(item.second.carrierFrequency);
-        newSched->setNumerologyIndex(item.second.numerologyIndex);     // set periodicity for this scheduler according to numerology
-        newSched->initializeBandLimit();
-        scheduler_.push_back(newSched);
-    }
+    createSchedulers(discipline);
 
     // Create Allocator
     if (discipline == ALLOCATOR_BESTFIT)                                            // NOTE: create this type of allocator for every scheduler using Frequency Reuse
@@ -125,6 +109,45 @@ void LteSchedulerEnb::initialize(Direction dir, LteMacEnb *mac, Binder *binder)
     initializeAllocator();
 }
 
+void LteSchedulerEnb::createSchedulers(SchedDiscipline discipline)
+{
+    const std::vector<BandwidthPart>& bandwidthParts = mac_->getBandwidthParts();
+    unsigned int numBands = mac_->getCellInfo()->getNumBands();
+
+    LteScheduler *newSched = nullptr;
+    const CarrierInfoMap *carriers = mac_->getCellInfo()->getCarrierInfoMap();
+    for (auto& item : *carriers) {
+        if (bandwidthParts.empty()) {
+            newSched = getScheduler(discipline);
+            newSched->setEnbScheduler(this);
+            newSched->setCarrierFrequency(item.second.carrierFrequency);
+            newSched->setNumerologyIndex(item.second.numerologyIndex);     // set periodicity for this scheduler according to numerology
+            newSched->initializeBandLimit();
+            scheduler_.push_back(newSched);
+            continue;
+        }
+
+        // one scheduler per bandwidth part, each one with its own discipline and numerology.
+        // The UEs follow the slot timing of the carrier, hence a BWP cannot use a numerology
+        // larger than the carrier's one: a BWP with a smaller numerology is scheduled once per BWP slot
+        for (unsigned int i = 0; i < bandwidthParts.size(); i++) {
+            const BandwidthPart& bwp = bandwidthParts[i];
+            if (bwp.lastBand >= numBands)
+                throw cRuntimeError("LteSchedulerEnb::createSchedulers - bandwidth part %d exceeds the %d bands of the cell", i, numBands);
+            if (bwp.numerologyIndex > item.second.numerologyIndex)
+                throw cRuntimeError("LteSchedulerEnb::createSchedulers - numerology %d of bandwidth part %d exceeds numerology %d of carrier [%f]",
+                        bwp.numerologyIndex, i, item.second.numerologyIndex, item.second.carrierFrequency);
+
+            newSched = getScheduler(bwp.discipline);
+            newSched->setEnbScheduler(this);
+            newSched->setCarrierFrequency(item.second.carrierFrequency);
+            newSched->initializeBandLimit();
+            newSched->setBandwidthPart(i);
+            scheduler_.push_back(newSched);
+        }
+    }
+}
+
 void LteSchedulerEnb::initializeSchedulerPeriodCounter(NumerologyIndex maxNumerologyIndex)
 {
     for (const auto& schedulerItem : scheduler_)
@@ -139,10 +162,17 @@ std::map<double, LteMacScheduleList> *LteSchedulerEnb::schedule()
     for (auto & [key, value] : scheduleList_)
         value.clear();
     allocatedCws_.clear();
+    sharedGrantBytes_.clear();
 
     // clean the allocator
     resetAllocator();
 
+    // clean the per-QFI CQI back-off of the grants of the previous slot
+    mac_->getAmc()->resetGrantCqiBackoff(direction_);
+
+    // TDD: no resources for this direction in the current slot
+    bool idleSlot = !mac_->isTddSlotUsable(direction_);
+
     // schedule one carrier at a time
     LteScheduler *scheduler = nullptr;
     for (auto & schedulerPtr : scheduler_) {
@@ -154,6 +184,17 @@ std::map<double, LteMacScheduleList> *LteSchedulerEnb::schedule()
             EV << " LteSchedulerEnb::schedule - not my turn (counter=" << counter << ")" << endl;
             continue;
         }
+        if (idleSlot) {
+            EV << " LteSchedulerEnb::schedule - TDD slot not usable in " << dirToA(direction_) << endl;
+            continue;
+        }
+
+        // restrict the allocation to the bands of the BWP handled by this scheduler
+        const BandwidthPart *bwp = scheduler->getBandwidthPart();
+        if (bwp != nullptr) {
+            EV << " LteSchedulerEnb::schedule - bandwidth part [" << bwp->firstBand << "-" << bwp->lastBand << "]" << endl;
+            allocator_->setActiveBands(bwp->firstBand, bwp->lastBand);
+        }
 
         // scheduling of RAC requests, retransmissions, and transmissions
         EV << "________________________start RAC+RTX _______________________________" << endl;
@@ -164,10 +205,17 @@ std::map<double, LteMacScheduleList> *LteSchedulerEnb::schedule()
             scheduler->schedule();
             EV << "____________________________ end SCHED ________________________________" << endl;
         }
+        if (bwp != nullptr)
+            allocator_->resetActiveBands();
     }
 
     // record assigned resource blocks statistics
-    resourceBlockStatistics();
+    if (!idleSlot)
+        resourceBlockStatistics();
+
+    // let the neighbouring cells know the bands used in this slot
+    if (mac_->isInterCellCoordinationEnabled())
+        publishBandLoad();
 
     return &scheduleList_;
 }
@@ -178,6 +226,20 @@ std::map<double, LteMacScheduleList> *LteSchedulerEnb::schedule()
  */
 unsigned int LteSchedulerEnb::scheduleGrant(MacCid cid, unsigned int bytes, bool& terminate, bool& active, bool& eligible, double carrierFrequency, BandLimitVector *bandLim, Remote antenna, bool limitBl)
 {
+    std::vector<unsigned int> grantedBytes;
+    return scheduleUeGrant({ { cid, 1.0 } }, bytes, terminate, active, eligible, carrierFrequency, grantedBytes, bandLim, antenna, limitBl);
+}
+
+unsigned int LteSchedulerEnb::scheduleUeGrant(const std::vector<std::pair<MacCid, double>>& shares, unsigned int bytes, bool& terminate, bool& active, bool& eligible, double carrierFrequency,
+        std::vector<unsigned int>& grantedBytes, BandLimitVector *bandLim, Remote antenna, bool limitBl)
+{
+    grantedBytes.assign(shares.size(), 0);
+    if (shares.empty())
+        return 0;
+
+    // the first connection of the UE gives the direction and the link adaptation of the grant
+    MacCid cid = shares.front().first;
+
     // Get the node ID and logical connection ID
     MacNodeId nodeId = MacCidToNodeId(cid);
     LogicalCid flowId = MacCidToLcid(cid);
@@ -193,6 +255,18 @@ unsigned int LteSchedulerEnb::scheduleGrant(MacCid cid, unsigned int bytes, bool
     }
     // else dir == DL
 
+    // per-QFI link adaptation: a transport block has a single MCS, hence the grant is served with the
+    // CQI back-off of the strictest QFI among the connections of the UE having data to send. An empty
+    // URLLC DRB does not lower the MCS of the eMBB data of the UE
+    unsigned int cqiBackoff = 0;
+    LteMacBufferMap *buffers = (dir == DL) ? vbuf_ : bsrbuf_;
+    for (const auto& share : shares) {
+        auto bit = buffers->find(share.first);
+        if (bit != buffers->end() && !bit->second->isEmpty())
+            cqiBackoff = std::max(cqiBackoff, mac_->getAmc()->getCqiBackoff(share.first));
+    }
+    mac_->getAmc()->setGrantCqiBackoff(nodeId, dir, cqiBackoff);
+
     // Get user transmission parameters
     const UserTxParams& txParams = mac_->getAmc()->computeTxParams(nodeId, dir, carrierFrequency);
     const std::set<Band>& allowedBands = txParams.readBands();
@@ -349,11 +423,17 @@ unsigned int LteSchedulerEnb::scheduleGrant(MacCid cid, unsigned int bytes, bool
         return totalAllocatedBytes; // return the total number of served bytes
     }
 
-    // Get virtual buffer reference
-    LteMacBuffer *conn = ((dir == DL) ? vbuf_->at(cid) : bsrbuf_->at(cid));
-
-    // get the buffer size
-    unsigned int queueLength = conn->getQueueOccupancy(); // in bytes
+    // Get virtual buffer references
+    std::vector<LteMacBuffer *> conns;
+    unsigned int queueLength = 0; // in bytes
+    unsigned int backloggedConns = 0;
+    for (const auto& share : shares) {
+        LteMacBuffer *conn = ((dir == DL) ? vbuf_->at(share.first) : bsrbuf_->at(share.first));
+        conns.push_back(conn);
+        queueLength += conn->getQueueOccupancy();
+        if (!conn->isEmpty())
+            backloggedConns++;
+    }
     if (queueLength == 0) {
         active = false;
         EV << "LteSchedulerEnb::scheduleGrant - scheduled connection is no longer active. Exiting grant " << endl;
@@ -366,7 +446,7 @@ unsigned int LteSchedulerEnb::scheduleGrant(MacCid cid, unsigned int bytes, bool
     for ( ; cw < numCodewords; ++cw) {
         EV << "LteSchedulerEnb::grant @@@@@ CODEWORD " << cw << " @@@@@" << endl;
 
-        queueLength += MAC_HEADER + RLC_HEADER_UM;  // TODO RLC may be either UM or AM
+        queueLength += MAC_HEADER + RLC_HEADER_UM * backloggedConns;  // TODO RLC may be either UM or AM
         toServe = (queueLength <= bytes) ? queueLength : bytes; // do not serve more bytes than the maximum number of bytes requested
         EV << "LteSchedulerEnb::scheduleGrant bytes to be allocated: " << toServe << endl;
 
@@ -400,7 +480,7 @@ unsigned int LteSchedulerEnb::scheduleGrant(MacCid cid, unsigned int bytes, bool
                 int b1 = allocator_->getBlocks(antenna, b, nodeId);
                 // limit eventually allocated blocks on other codeword to limit for current cw
                 bandAvailableBlocks = (limitBl ? (b1 > limit ? limit : b1) : b1);
-                bandAvailableBytes = mac_->getAmc()->computeBytesOnNRbs(nodeId, b, cw, bandAvailableBlocks, dir, carrierFrequency);
+                bandAvailableBytes = mac_->getAmc()->computeBytesOnSubband(nodeId, b, cw, bandAvailableBlocks, dir, carrierFrequency);
             }
             else { // if limit is expressed in blocks, limit value must be passed to availableBytes function
                 bandAvailableBlocks = allocator_->availableBlocks(nodeId, antenna, b);
@@ -471,25 +551,41 @@ unsigned int LteSchedulerEnb::scheduleGrant(MacCid cid, unsigned int bytes, bool
 
         // === update virtual buffer === //
 
-        unsigned int consumedBytes = (cwAllocatedBytes == 0) ? 0 : cwAllocatedBytes - (MAC_HEADER + RLC_HEADER_UM);  // TODO RLC may be either UM or AM
-
-        // number of bytes to be consumed from the virtual buffer
-        while (!conn->isEmpty() && consumedBytes > 0) {
-
-            unsigned int vPktSize = conn->front().first;
-            if (vPktSize <= consumedBytes) {
-                // serve the entire vPkt, remove pkt info
-                conn->popFront();
-                consumedBytes -= vPktSize;
-                EV << "LteSchedulerEnb::grant - the first SDU/BSR is served entirely, remove it from the virtual buffer, remaining bytes to serve[" << consumedBytes << "]" << endl;
-            }
-            else {
-                // serve partial vPkt, update pkt info
-                PacketInfo newPktInfo = conn->popFront();
-                newPktInfo.first = newPktInfo.first - consumedBytes;
-                conn->pushFront(newPktInfo);
-                consumedBytes = 0;
-                EV << "LteSchedulerEnb::grant - the first SDU/BSR is partially served, update its size [" << newPktInfo.first << "]" << endl;
+        // the bytes after the MAC header are split across the connections, each one with its RLC header
+        // the URLLC connections (QFI 4) keep their strict priority within the grant of the UE
+        std::vector<unsigned int> needs, cwSplit;
+        std::vector<double> weights;
+        std::vector<bool> strict;
+        for (size_t c = 0; c < conns.size(); c++) {
+            needs.push_back(conns[c]->isEmpty() ? 0 : conns[c]->getQueueOccupancy() + RLC_HEADER_UM);
+            weights.push_back(shares[c].second);
+            strict.push_back(QfiContextManager::getInstance()->getQfiForCid(shares[c].first) == 4);
+        }
+        splitGrantBytes((cwAllocatedBytes > MAC_HEADER) ? cwAllocatedBytes - MAC_HEADER : 0, weights, strict, needs, cwSplit);
+
+        for (size_t c = 0; c < conns.size(); c++) {
+            LteMacBuffer *conn = conns[c];
+            grantedBytes[c] += cwSplit[c];
+            unsigned int consumedBytes = (cwSplit[c] > RLC_HEADER_UM) ? cwSplit[c] - RLC_HEADER_UM : 0;  // TODO RLC may be either UM or AM
+
+            // number of bytes to be consumed from the virtual buffer
+            while (!conn->isEmpty() && consumedBytes > 0) {
+
+                unsigned int vPktSize = conn->front().first;
+                if (vPktSize <= consumedBytes) {
+                    // serve the entire vPkt, remove pkt info
+                    conn->popFront();
+                    consumedBytes -= vPktSize;
+                    EV << "LteSchedulerEnb::grant - the first SDU/BSR is served entirely, remove it from the virtual buffer, remaining bytes to serve[" << consumedBytes << "]" << endl;
+                }
+                else {
+                    // serve partial vPkt, update pkt info
+                    PacketInfo newPktInfo = conn->popFront();
+                    newPktInfo.first = newPktInfo.first - consumedBytes;
+                    conn->pushFront(newPktInfo);
+                    consumedBytes = 0;
+                    EV << "LteSchedulerEnb::grant - the first SDU/BSR is partially served, update its size [" << newPktInfo.first << "]" << endl;
+                }
             }
         }
 
@@ -508,14 +604,24 @@ unsigned int LteSchedulerEnb::scheduleGrant(MacCid cid, unsigned int bytes, bool
                 LteMacScheduleList newScheduleList;
                 scheduleList_[carrierFrequency] = newScheduleList;
             }
-            // create entry in the schedule list for this pair <cid,cw>
-            std::pair<unsigned int, Codeword> scListId(cid, cw);
-            if (scheduleList_[carrierFrequency].find(scListId) == scheduleList_[carrierFrequency].end())
-                scheduleList_[carrierFrequency][scListId] = 0;
-
-            // if direction is DL , then schedule list contains number of to-be-transmitted SDUs ,
-            // otherwise it contains the number of granted blocks
-            scheduleList_[carrierFrequency][scListId] += ((dir == DL) ? vQueueItemCounter : cwAllocatedBlocks);
+            if (dir == DL) {
+                // create entry in the schedule list for each served pair <cid,cw>, containing the number
+                // of to-be-transmitted SDUs. When the UE grant is shared, each connection requests its own bytes
+                for (size_t c = 0; c < shares.size(); c++) {
+                    if (cwSplit[c] == 0 && shares.size() > 1)
+                        continue;
+                    std::pair<unsigned int, Codeword> scListId(shares[c].first, cw);
+                    scheduleList_[carrierFrequency][scListId] += vQueueItemCounter;
+                    if (shares.size() > 1)
+                        sharedGrantBytes_[{carrierFrequency, shares[c].first}] += cwSplit[c];
+                }
+            }
+            else {
+                // in UL the UE receives a single grant containing the number of granted blocks,
+                // and shares it among its connections by itself
+                std::pair<unsigned int, Codeword> scListId(cid, cw);
+                scheduleList_[carrierFrequency][scListId] += cwAllocatedBlocks;
+            }
 
             EV << "LteSchedulerEnb::grant CODEWORD IS NOW BUSY: GO TO NEXT CODEWORD." << endl;
             if (allocatedCws_.at(nodeId) == MAX_CODEWORDS) {
@@ -853,6 +959,71 @@ unsigned int LteSchedulerEnb::readRbOccupation(const MacNodeId id, double carrie
     return ret;
 }
 
+unsigned int LteSchedulerEnb::readUeAllocationSummary(const MacNodeId id, double carrierFrequency, UeAllocationSummary& summary)
+{
+    summary.rbMap.clear();
+    summary.bands.clear();
+
+    const LteAllocationModule::AllocatedRbsPerUeInfo *info = allocator_->getAllocatedRbsPerUe(id);
+    if (info == nullptr)
+        return 0;
+
+    Band startingBand = mac_->getCellInfo()->getCarrierStartingBand(carrierFrequency);
+    Band lastBand = mac_->getCellInfo()->getCarrierLastBand(carrierFrequency);
+
+    unsigned int blocks = 0;
+    std::map<Band, unsigned int> bandBlocks;
+    for (const auto& [antenna, bandMap] : info->ueAllocatedRbsMap_) {
+        for (auto it = bandMap.lower_bound(startingBand); it != bandMap.end() && it->first <= lastBand; ++it) {
+            if (it->second == 0)
+                continue;    // blocks removed after the allocation
+            summary.rbMap[antenna][it->first - startingBand] = it->second;
+            bandBlocks[it->first] += it->second;
+            blocks += it->second;
+        }
+    }
+    summary.bands.assign(bandBlocks.begin(), bandBlocks.end());
+    return blocks;
+}
+
+void LteSchedulerEnb::publishBandLoad()
+{
+    unsigned int numBands = mac_->getCellInfo()->getNumBands();
+    std::vector<double> load(numBands, 0.0);
+    std::vector<double> edgeLoad(numBands, 0.0);
+    unsigned int edgeBytes = 0;
+
+    UeAllocationSummary summary;
+    for (auto it = allocator_->getAllocatedBlocksUeBegin(); it != allocator_->getAllocatedBlocksUeEnd(); ++it) {
+        if (it->second.allocatedBlocks_ == 0)
+            continue;
+
+        bool edge = false;
+        for (auto *scheduler : scheduler_) {
+            double carrierFrequency = scheduler->getCarrierFrequency();
+            if (readUeAllocationSummary(it->first, carrierFrequency, summary) == 0)
+                continue;
+
+            bool carrierEdge = mac_->isCellEdgeUe(mac_->getAmc()->computeTxParams(it->first, direction_, carrierFrequency));
+            for (const auto& [band, blocks] : summary.bands) {
+                load[band] += blocks;
+                if (carrierEdge)
+                    edgeLoad[band] += blocks;
+            }
+            edge = edge || carrierEdge;
+        }
+        if (edge)
+            edgeBytes += it->second.allocatedBytes_;
+    }
+
+    // a logical band holds one block per antenna: report the fraction of the band in use
+    for (unsigned int b = 0; b < numBands; b++) {
+        load[b] = std::min(load[b], 1.0);
+        edgeLoad[b] = std::min(edgeLoad[b], 1.0);
+    }
+    mac_->storeBandLoadReport(direction_, std::move(load), std::move(edgeLoad), edgeBytes);
+}
+
 /*
  * OFDMA frame management
  */
@@ -882,7 +1053,7 @@ unsigned int LteSchedulerEnb::availableBytes(const MacNodeId id,
     if (limit != -1)
         blocks = (blocks > limit) ? limit : blocks;
 
-    unsigned int bytes = mac_->getAmc()->computeBytesOnNRbs(id, b, cw, blocks, dir, carrierFrequency);
+    unsigned int bytes = mac_->getAmc()->computeBytesOnSubband(id, b, cw, blocks, dir, carrierFrequency);
     EV << "LteSchedulerEnb::availableBytes MacNodeId " << id << " blocks [" << blocks << "], bytes [" << bytes << "]" << endl;
 
     return bytes;
@@ -937,7 +1108,7 @@ LteScheduler *LteSchedulerEnb::getScheduler(SchedDiscipline discipline)
 
     switch (discipline) {
         case DRR:
-            return new LteDrr(binder_);
+            return new LteDrr(binder_, mac_->par("drrQuantum").intValue(), mac_->par("drrQfiWeightBase").doubleValue());
         case PF:
             return new LtePf(binder_, mac_->par("pfAlpha").doubleValue());
         case MAXCI:
@@ -954,7 +1125,8 @@ LteScheduler *LteSchedulerEnb::getScheduler(SchedDiscipline discipline)
             return new QoSAwareScheduler(binder_, mac_->par("pfAlpha").doubleValue());
 
         case LYAPUNOV_SCHEDULER:
-            return new LyapunovScheduler(binder_, mac_->par("lyAlpha").doubleValue(), mac_->par("lyBeta").doubleValue());
+            return new LyapunovScheduler(binder_, mac_->par("lyAlpha").doubleValue(), mac_->par("lyBeta").doubleValue(), mac_->par("lyEnergyWeight").doubleValue(),
+                    mac_->par("lyUeScoring").boolValue(), mac_->par("lyMaxMutedDelay").doubleValue());
 
 
         default:
@@ -966,8 +1138,11 @@ LteScheduler *LteSchedulerEnb::getScheduler(SchedDiscipline discipline)
 void LteSchedulerEnb::resourceBlockStatistics(bool sleep)
 {
     if (sleep) {
-        if (direction_ == DL)
+        if (direction_ == DL) {
             mac_->emit(avgServedBlocksDlSignal_, (long)0);
+            mac_->emit(rbUtilizationSignal_[DL], 0.0);
+            mac_->emit(txEnergySignal_[DL], 0.0);
+        }
         return;
     }
     // Get a reference to the beginning and the end of the map which stores the blocks allocated
@@ -995,6 +1170,21 @@ void LteSchedulerEnb::resourceBlockStatistics(bool sleep)
         mac_->emit(avgServedBlocksUlSignal_, allocatedBlocks);
     else
         throw cRuntimeError("LteSchedulerEnb::resourceBlockStatistics(): Unrecognized direction %d", direction_);
+
+    // fraction of the blocks in use, and transmit energy of the slot (a slot without allocations is muted)
+    if (resourceBlocks_ > 0)
+        mac_->emit(rbUtilizationSignal_[direction_], allocatedBlocks / resourceBlocks_);
+    mac_->emit(txEnergySignal_[direction_], mac_->getSlotTxEnergy(allocatedBlocks));
+
+    // spectral efficiency of the slot, as bytes allocated per block
+    unsigned int ueBlocks = 0;
+    unsigned int ueBytes = 0;
+    for (auto it = allocator_->getAllocatedBlocksUeBegin(); it != allocator_->getAllocatedBlocksUeEnd(); ++it) {
+        ueBlocks += it->second.allocatedBlocks_;
+        ueBytes += it->second.allocatedBytes_;
+    }
+    if (ueBlocks > 0)
+        mac_->emit(servedBytesPerBlockSignal_[direction_], (double)ueBytes / ueBlocks);
 }
 
 ActiveSet *LteSchedulerEnb::readActiveConnections()
@@ -1004,15 +1194,14 @@ ActiveSet *LteSchedulerEnb::readActiveConnections()
 
 void LteSchedulerEnb::removeActiveConnections(MacNodeId nodeId)
 {
-    for (auto it = activeConnectionSet_.begin(); it != activeConnectionSet_.end(); ) {
-        MacCid cid = *it;
-        if (MacCidToNodeId(cid) == nodeId) {
-            EV << NOW << "LteSchedulerEnb::removeActiveConnections CID removed " << cid << endl;
-            it = activeConnectionSet_.erase(it);
-        }
-        else
-            ++it;
+    for (auto it = lowerBoundNodeCid(activeConnectionSet_, nodeId); it != activeConnectionSet_.end() && MacCidToNodeId(*it) == nodeId; ) {
+        EV << NOW << "LteSchedulerEnb::removeActiveConnections CID removed " << *it << endl;
+        it = activeConnectionSet_.erase(it);
     }
+
+    // release the per-connection state of the scheduling agents
+    for (auto *scheduler : scheduler_)
+        scheduler->removeConnections(nodeId);
 }
 
 } //namespace
@@ -82,7 +82,7 @@ class LteSchedulerEnb
     // System allocator, carries out the block-allocation functions.
     LteAllocationModule *allocator_ = nullptr;
 
-    // Scheduling agent. One per carrier
+    // Scheduling agent. One per carrier (or one per bandwidth part of each carrier)
     std::vector<LteScheduler *> scheduler_;
 
     // Operational Direction. Set via initialize().
@@ -116,6 +116,13 @@ class LteSchedulerEnb
     /// Statistics
     static simsignal_t avgServedBlocksDlSignal_;
     static simsignal_t avgServedBlocksUlSignal_;
+    static simsignal_t servedBytesPerBlockSignal_[2];
+    static simsignal_t rbUtilizationSignal_[2];
+    static simsignal_t txEnergySignal_[2];
+
+    // bytes granted in the current slot to the connections sharing a UE grant (see scheduleUeGrant()),
+    // per <carrier frequency, cid>
+    std::map<std::pair<double, MacCid>, unsigned int> sharedGrantBytes_;
 
     // pre-made BandLimit structure used when no band limit is given to the scheduler
     std::vector<BandLimit> emptyBandLim_;
@@ -227,6 +234,26 @@ class LteSchedulerEnb
      */
     unsigned int readRbOccupation(const MacNodeId id, double carrierFrequency, RbMap& rbMap);
 
+    /*
+     * Summary of the blocks allocated to a UE on a carrier in the current slot.
+     * Only the allocated bands are listed, so that computing the bytes of a grant from it
+     * does not require scanning all the bands of the carrier.
+     */
+    struct UeAllocationSummary
+    {
+        // allocated blocks per antenna and band (band indexes relative to the carrier). Unlike
+        // readRbOccupation(), the bands with 0 blocks are not listed
+        RbMap rbMap;
+        // allocated bands and corresponding blocks, summed over the antennas
+        std::vector<std::pair<Band, unsigned int>> bands;
+    };
+
+    /**
+     * Fills the allocation summary of the given UE on the given carrier.
+     * @return the number of allocated blocks
+     */
+    unsigned int readUeAllocationSummary(const MacNodeId id, double carrierFrequency, UeAllocationSummary& summary);
+
     /**
      * Schedules retransmission for the Harq Process of the given UE on a set of logical bands.
      * Each band also has an assigned limit amount of bytes: no more than the specified
@@ -265,8 +292,33 @@ class LteSchedulerEnb
     virtual unsigned int scheduleGrant(MacCid cid, unsigned int bytes, bool& terminate, bool& active, bool& eligible, double carrierFrequency,
             BandLimitVector *bandLim = nullptr, Remote antenna = MACRO, bool limitBl = false);
 
+    /**
+     * Schedules capacity for several connections of the same UE (e.g. its DRBs) with a single allocation,
+     * as scheduleGrant() would do for one connection holding the backlog of all of them. The granted
+     * bytes are then split across the connections by splitGrantBytes(): the URLLC ones (QFI 4) are
+     * served first, the other ones in proportion to their weights, without exceeding the backlog of
+     * each one. scheduleGrant() is the case of a single connection.
+     *
+     * @param shares Connections of the UE with their weights. The first one gives the direction and the
+     *               link adaptation of the grant, and in UL it holds the single grant sent to the UE
+     * @param grantedBytes Filled with the bytes granted to each connection, in the order of shares
+     * @return The number of bytes that have been actually granted to the UE.
+     */
+    virtual unsigned int scheduleUeGrant(const std::vector<std::pair<MacCid, double>>& shares, unsigned int bytes, bool& terminate, bool& active, bool& eligible,
+            double carrierFrequency, std::vector<unsigned int>& grantedBytes, BandLimitVector *bandLim = nullptr, Remote antenna = MACRO, bool limitBl = false);
+
     virtual unsigned int scheduleGrantBackground(MacCid bgCid, unsigned int bytes, bool& terminate, bool& active, bool& eligible, double carrierFrequency,
             BandLimitVector *bandLim = nullptr, Remote antenna = MACRO, bool limitBl = false);
+
+    /**
+     * Returns the DL bytes (RLC header included) granted in the current slot on the given carrier to a
+     * connection that shared its UE grant with other connections, 0 if it was granted alone.
+     */
+    unsigned int getSharedGrantBytes(double carrierFrequency, MacCid cid) const
+    {
+        auto it = sharedGrantBytes_.find({carrierFrequency, cid});
+        return (it != sharedGrantBytes_.end()) ? it->second : 0;
+    }
     /*
      * Getter for active connection set
      */
@@ -295,9 +347,10 @@ class LteSchedulerEnb
 
     /**
      * Updates the current schedule list with RAC requests (only for UL).
+     * With bandwidth parts, only the requests for the given BWP are served (all of them if -1).
      * @return TRUE if OFDM space is exhausted.
      */
-    virtual bool racschedule(double carrierFrequency, BandLimitVector *bandLim = nullptr) = 0;
+    virtual bool racschedule(double carrierFrequency, BandLimitVector *bandLim = nullptr, int bandwidthPart = -1) = 0;
 
     /**
      * Updates the current schedule list with HARQ retransmissions.
@@ -320,6 +373,12 @@ class LteSchedulerEnb
      */
     void resourceBlockStatistics(bool sleep = false);
 
+    /**
+     * Publishes the per-band load of the current slot, and the one due to cell-edge UEs,
+     * for the inter-cell coordination with the neighbouring cells.
+     */
+    void publishBandLoad();
+
     /**
      * Initializes the blocks-related structures allocation
      */
@@ -376,6 +435,13 @@ class LteSchedulerEnb
      * @param discipline scheduler discipline
      */
     LteScheduler *getScheduler(SchedDiscipline discipline);
+
+    /**
+     * Creates the scheduling agents: one per carrier or, if bandwidth parts
+     * are configured, one per bandwidth part of each carrier.
+     * @param discipline scheduler discipline used when no BWP is configured
+     */
+    void createSchedulers(SchedDiscipline discipline);
 };
 
 } //namespace
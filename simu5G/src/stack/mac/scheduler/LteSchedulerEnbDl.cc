@@ -19,6 +19,19 @@ namespace simu5g {
 
 using namespace omnetpp;
 
+simsignal_t LteSchedulerEnbDl::harqRtxLatencyDlSignal_ = cComponent::registerSignal("harqRtxLatencyDl");
+simsignal_t LteSchedulerEnbDl::harqAdaptiveRtxDlSignal_ = cComponent::registerSignal("harqAdaptiveRtxDl");
+
+void LteSchedulerEnbDl::initializeAdaptiveRtx()
+{
+    adaptiveRtx_ = mac_->par("adaptiveRtx").boolValue();
+    rtxMinCodingRatio_ = mac_->par("rtxMinCodingRatio").doubleValue();
+    maxHarqRtx_ = mac_->par("maxHarqRtx").intValue();
+
+    if (rtxMinCodingRatio_ <= 0 || rtxMinCodingRatio_ > 1)
+        throw cRuntimeError("LteSchedulerEnbDl::initializeAdaptiveRtx - rtxMinCodingRatio must be in (0,1], found %f", rtxMinCodingRatio_);
+}
+
 bool LteSchedulerEnbDl::checkEligibility(MacNodeId id, Codeword& cw, double carrierFrequency)
 {
     HarqTxBuffers *harqTxBuff = mac_->getHarqTxBuffers(carrierFrequency);
@@ -124,7 +137,8 @@ unsigned int LteSchedulerEnbDl::schedulePerAcidRtx(MacNodeId nodeId, double carr
     Plane plane = allocator_->getOFDMPlane(nodeId);
     allocator_->setRemoteAntenna(plane, antenna);
 
-    // blocks to allocate for each band
+    // bands where blocks are allocated, with the blocks to allocate for each of them
+    std::vector<unsigned int> assignedBands;
     std::vector<unsigned int> assignedBlocks;
     // bytes which blocks from the preceding vector are supposed to satisfy
     std::vector<unsigned int> assignedBytes;
@@ -168,7 +182,7 @@ unsigned int LteSchedulerEnbDl::schedulePerAcidRtx(MacNodeId nodeId, double carr
 
             // limit eventually allocated blocks on other codeword to limit for current cw
             //b1 = (limitBl ? (b1>limit?limit:b1) : b1);
-            available = (b1 == 0) ? 0 : mac_->getAmc()->computeBytesOnNRbs(nodeId, b, remappedCw, b1, direction_, carrierFrequency);
+            available = (b1 == 0) ? 0 : mac_->getAmc()->computeBytesOnSubband(nodeId, b, remappedCw, b1, direction_, carrierFrequency);
         }
         else
             available = availableBytes(nodeId, antenna, b, remappedCw, direction_, carrierFrequency, (limitBl) ? limit : -1);                                                                                                                                   // available space
@@ -197,32 +211,52 @@ unsigned int LteSchedulerEnbDl::schedulePerAcidRtx(MacNodeId nodeId, double carr
             EV << NOW << "LteSchedulerEnbDl::rtxAcid Assigned blocks: " << blocks << endl;
 
             // assign only on the first codeword
-            assignedBlocks.push_back(blocks);
-            assignedBytes.push_back(allocation);
+            if (allocation > 0) {
+                assignedBands.push_back(i);
+                assignedBlocks.push_back(blocks);
+                assignedBytes.push_back(allocation);
+            }
         }
 
         if (bytes == 0)
             break;
     }
 
+    bool adaptive = false;
     if (bytes > 0) {
-        // process couldn't be served
-        EV << NOW << "LteSchedulerEnbDl::rtxAcid Cannot serve HARQ Process" << acid << endl;
-        return 0;
+        // adaptive RTX: send the PDU on the blocks found, at a higher code rate, as long as they carry
+        // enough coded bits at the current MCS. The last attempt is never shrunk, since no further
+        // redundancy version could complete the decoding
+        int64_t pduLength = currHarq->pduLength(acid, cw);
+        bool lastAttempt = currHarq->getProcess(acid)->getTransmissions(cw) >= maxHarqRtx_;
+        if (!adaptiveRtx_ || lastAttempt || allocatedCw != 0 || pduLength - bytes < rtxMinCodingRatio_ * pduLength) {
+            // process couldn't be served
+            EV << NOW << "LteSchedulerEnbDl::rtxAcid Cannot serve HARQ Process" << acid << endl;
+            return 0;
+        }
+        EV << NOW << "LteSchedulerEnbDl::rtxAcid adaptive RTX for HARQ Process " << (int)acid << ": " << pduLength - bytes << " of " << pduLength << " bytes at the current MCS" << endl;
+        adaptive = true;
+        // the receiver decodes the RTX at a higher code rate, see LteHarqProcessRx::insertPdu()
+        currHarq->getProcess(acid)->setRtxCodingRatio(cw, (double)(pduLength - bytes) / pduLength);
     }
 
     // record the allocation if performed
     size = assignedBlocks.size();
     // For each LB with assigned blocks
     for (unsigned int i = 0; i < size; ++i) {
+        BandLimit& elem = bandLim->at(assignedBands.at(i));
         if (allocatedCw == 0) {
             // allocate the blocks
-            allocator_->addBlocks(antenna, bandLim->at(i).band_, nodeId, assignedBlocks.at(i), assignedBytes.at(i));
+            allocator_->addBlocks(antenna, elem.band_, nodeId, assignedBlocks.at(i), assignedBytes.at(i));
         }
         // store the amount
-        bandLim->at(i).limit_.at(remappedCw) = assignedBytes.at(i);
+        elem.limit_.at(remappedCw) = assignedBytes.at(i);
     }
 
+    // time elapsed since the previous (failed) transmission of the PDU
+    mac_->emit(harqRtxLatencyDlSignal_, NOW - currHarq->getProcess(acid)->getTxTime(cw));
+    mac_->emit(harqAdaptiveRtxDlSignal_, adaptive ? 1 : 0);
+
     UnitList signal;
     signal.first = acid;
     signal.second.push_back(cw);
@@ -504,39 +538,27 @@ bool LteSchedulerEnbDl::rtxscheduleBackground(double carrierFrequency, BandLimit
 
 bool LteSchedulerEnbDl::getBandLimit(std::vector<BandLimit> *bandLimit, MacNodeId ueId)
 {
-    bandLimit->clear();
-
     // get usable bands for this user
-    UsableBands *usableBands = mac_->getAmc()->getPilotUsableBands(ueId);
+    const UsableBandsMask *usableBands = mac_->getAmc()->getPilotUsableBandsMask(ueId);
     if (usableBands == nullptr) {
         // leave the bandLimit empty
+        bandLimit->clear();
         return false;
     }
 
     // check the number of codewords
     unsigned int numCodewords = 1;
     unsigned int numBands = mac_->getCellInfo()->getNumBands();
-    // for each band of the band vector provided
+
+    // the vector is reused across calls: only the limits are rewritten
+    bandLimit->resize(numBands);
     for (unsigned int i = 0; i < numBands; i++) {
-        BandLimit elem;
+        BandLimit& elem = bandLimit->at(i);
         elem.band_ = Band(i);
 
-        int limit = -2;
-
-        // check whether band i is in the set of usable bands
-        for (auto band : *usableBands) {
-            if (band == i) {
-                // band i must be marked as unlimited
-                limit = -1;
-                break;
-            }
-        }
-
-        elem.limit_.clear();
-        for (unsigned int j = 0; j < numCodewords; j++)
-            elem.limit_.push_back(limit);
-
-        bandLimit->push_back(elem);
+        // bands not in the set of usable bands are skipped, the others are unlimited
+        int limit = isUsableBand(*usableBands, elem.band_) ? -1 : -2;
+        elem.limit_.assign(numCodewords, limit);
     }
 
     return true;
@@ -31,6 +31,19 @@ class LteSchedulerEnbDl : public LteSchedulerEnb
 
   protected:
 
+    /// Adaptive retransmissions: a RTX may be sent on fewer resources than needed for the
+    /// whole PDU at the current MCS, carrying only a part of the coded bits
+    bool adaptiveRtx_ = false;
+
+    /// Minimum fraction of the PDU that an adaptive RTX must carry at the current MCS
+    double rtxMinCodingRatio_ = 0.5;
+
+    /// Maximum number of HARQ retransmissions (the last one is never shrunk)
+    unsigned int maxHarqRtx_ = 3;
+
+    static simsignal_t harqRtxLatencyDlSignal_;
+    static simsignal_t harqAdaptiveRtxDlSignal_;
+
     //---------------------------------------------
 
     /**
@@ -43,7 +56,7 @@ class LteSchedulerEnbDl : public LteSchedulerEnb
      */
     bool checkEligibility(MacNodeId id, Codeword& cw, double carrierFrequency) override;
 
-    bool racschedule(double carrierFrequency, BandLimitVector *bandLim = nullptr) override { return false; }
+    bool racschedule(double carrierFrequency, BandLimitVector *bandLim = nullptr, int bandwidthPart = -1) override { return false; }
 
     /**
      * Updates current schedule list with HARQ retransmissions.
@@ -76,6 +89,13 @@ class LteSchedulerEnbDl : public LteSchedulerEnb
 
     bool getBandLimit(std::vector<BandLimit> *bandLimit, MacNodeId ueId);
 
+  public:
+
+    /**
+     * Reads the adaptive retransmission parameters from the MAC module (called by e/gNb at init)
+     */
+    void initializeAdaptiveRtx();
+
 };
 
 } //namespace
@@ -9,10 +9,14 @@
 // and cannot be removed from it.
 //
 
+#include <algorithm>
+#include <tuple>
+
 #include "stack/mac/scheduler/LteSchedulerEnbUl.h"
 #include "stack/mac/LteMacEnb.h"
 #include "stack/mac/LteMacEnbD2D.h"
 #include "stack/mac/buffer/harq/LteHarqBufferRx.h"
+#include "stack/mac/buffer/LteMacBuffer.h"
 #include "stack/mac/allocator/LteAllocationModule.h"
 #include "stack/phy/LtePhyBase.h"
 
@@ -20,6 +24,11 @@ namespace simu5g {
 
 using namespace omnetpp;
 
+simsignal_t LteSchedulerEnbUl::ulAccessDelaySignal_ = cComponent::registerSignal("ulAccessDelay");
+simsignal_t LteSchedulerEnbUl::racGrantDelaySignal_ = cComponent::registerSignal("racGrantDelay");
+simsignal_t LteSchedulerEnbUl::preGrantAccessDelaySignal_ = cComponent::registerSignal("preGrantAccessDelay");
+simsignal_t LteSchedulerEnbUl::preGrantWastedBytesSignal_ = cComponent::registerSignal("preGrantWastedBytes");
+
 bool LteSchedulerEnbUl::checkEligibility(MacNodeId id, Codeword& cw, double carrierFrequency)
 {
     HarqRxBuffers *harqRxBuff = mac_->getHarqRxBuffers(carrierFrequency);
@@ -66,7 +75,7 @@ void LteSchedulerEnbUl::updateHarqDescs()
     }
 }
 
-bool LteSchedulerEnbUl::racschedule(double carrierFrequency, BandLimitVector *bandLim)
+bool LteSchedulerEnbUl::racschedule(double carrierFrequency, BandLimitVector *bandLim, int bandwidthPart)
 {
     EV << NOW << " LteSchedulerEnbUl::racschedule --------------------::[ START RAC-SCHEDULE ]::--------------------" << endl;
     EV << NOW << " LteSchedulerEnbUl::racschedule eNodeB: " << mac_->getMacCellId() << " Direction: " << (direction_ == UL ? "UL" : "DL") << endl;
@@ -75,101 +84,112 @@ bool LteSchedulerEnbUl::racschedule(double carrierFrequency, BandLimitVector *ba
     unsigned int numBands = mac_->getCellInfo()->getNumBands();
     unsigned int racAllocatedBlocks = 0;
 
+    // band limit shared by all the requests of the slot. The bands allowed to each UE are
+    // checked while allocating, so that the limit is never modified
+    BandLimitVector allBandsLim;
+    if (bandLim == nullptr) {
+        for (unsigned int i = 0; i < numBands; i++) {
+            BandLimit elem;
+            elem.band_ = Band(i);
+            for (unsigned int j = 0; j < MAX_CODEWORDS; j++)
+                elem.limit_[j] = -1;
+            allBandsLim.push_back(elem);
+        }
+        bandLim = &allBandsLim;
+    }
+
+    // the blocks of the configured grants the UEs transmit on are allocated first
+    if (preGrantPeriodic_)
+        racAllocatedBlocks += allocateConfiguredGrants(carrierFrequency, bandwidthPart);
+
     auto map_it = racStatus_.find(carrierFrequency);
-    if (map_it != racStatus_.end()) {
+    if (map_it != racStatus_.end() && !map_it->second.empty()) {
         RacStatus& racStatus = map_it->second;
-        for (const auto& [nodeId, _] : racStatus) {
-            EV << NOW << " LteSchedulerEnbUl::racschedule handling RAC for node " << nodeId << endl;
-
-            const UserTxParams& txParams = mac_->getAmc()->computeTxParams(nodeId, UL, carrierFrequency);    // get the user info
-            const std::set<Band>& allowedBands = txParams.readBands();
-            BandLimitVector tempBandLim;
-            std::string bands_msg = "BAND_LIMIT_SPECIFIED";
-            if (bandLim == nullptr) {
-                // Create a vector of band limit using all bands
-                // FIXME: bandLim is never deleted
-
-                // for each band of the band vector provided
-                for (unsigned int i = 0; i < numBands; i++) {
-                    BandLimit elem;
-                    // copy the band
-                    elem.band_ = Band(i);
-                    EV << "Putting band " << i << endl;
-                    for (unsigned int j = 0; j < MAX_CODEWORDS; j++) {
-                        if (allowedBands.find(elem.band_) != allowedBands.end()) {
-                            elem.limit_[j] = -1;
-                        }
-                        else {
-                            elem.limit_[j] = -2;
-                        }
-                    }
-                    tempBandLim.push_back(elem);
-                }
-                bandLim = &tempBandLim;
-            }
-            else {
-                // for each band of the band vector provided
-                for (unsigned int i = 0; i < numBands; i++) {
-                    BandLimit& elem = bandLim->at(i);
-                    for (unsigned int j = 0; j < MAX_CODEWORDS; j++) {
-                        if (elem.limit_[j] == -2)
-                            continue;
-
-                        if (allowedBands.find(elem.band_) != allowedBands.end()) {
-                            elem.limit_[j] = -1;
-                        }
-                        else {
-                            elem.limit_[j] = -2;
-                        }
-                    }
-                }
-            }
 
-            // FIXME default behavior
-            // try to allocate one block to selected UE on at least one logical band of MACRO antenna, first codeword
+        // serve the requests of the slot in QFI priority order, the oldest first within the same priority.
+        // With bandwidth parts, the requests for the other BWPs are left to their schedulers
+        std::vector<std::tuple<int, simtime_t, MacNodeId>> requests;
+        requests.reserve(racStatus.size());
+        for (const auto& [nodeId, request] : racStatus) {
+            if (bandwidthPart < 0 || request.bandwidthPart == bandwidthPart)
+                requests.emplace_back(request.priorityLevel, request.arrival, nodeId);
+        }
+        std::sort(requests.begin(), requests.end());
+
+        // FIXME default behavior
+        // try to allocate one block to selected UE on at least one logical band of MACRO antenna, first codeword
+        const unsigned int cw = 0;
+        const unsigned int blocks = 1;
 
-            const unsigned int cw = 0;
-            const unsigned int blocks = 1;
+        // OFDM planes without free bands: their remaining requests are kept for the next slot
+        std::set<Plane> fullPlanes;
 
+        for (const auto& [priorityLevel, arrival, nodeId] : requests) {
+            Plane plane = allocator_->getOFDMPlane(nodeId);
+            if (fullPlanes.find(plane) != fullPlanes.end())
+                continue;
+
+            EV << NOW << " LteSchedulerEnbUl::racschedule handling RAC for node " << nodeId << " priority level " << priorityLevel << endl;
+
+            // the TX parameters are only computed once a free band is found
+            const std::set<Band> *allowedBands = nullptr;
+            bool bandAvailable = false;
             bool allocation = false;
 
             unsigned int size = bandLim->size();
             for (Band b = 0; b < size; ++b) {
                 // if the limit flag is set to skip, jump off
-                int limit = bandLim->at(b).limit_.at(cw);
-                if (limit == -2) {
+                if (bandLim->at(b).limit_.at(cw) == -2) {
                     EV << "LteSchedulerEnbUl::racschedule - skipping logical band according to limit value" << endl;
                     continue;
                 }
 
-                if (allocator_->availableBlocks(nodeId, MACRO, b) > 0) {
-                    unsigned int bytes = mac_->getAmc()->computeBytesOnNRbs(nodeId, b, cw, blocks, UL, carrierFrequency);
-                    if (bytes > 0) {
+                if (allocator_->availableBlocks(nodeId, MACRO, b) == 0)
+                    continue;
+                bandAvailable = true;
+
+                if (allowedBands == nullptr)
+                    allowedBands = &mac_->getAmc()->computeTxParams(nodeId, UL, carrierFrequency).readBands();
+                if (allowedBands->find(bandLim->at(b).band_) == allowedBands->end())
+                    continue;
 
-                        allocator_->addBlocks(MACRO, b, nodeId, 1, bytes);
-                        racAllocatedBlocks++;
+                unsigned int bytes = mac_->getAmc()->computeBytesOnSubband(nodeId, b, cw, blocks, UL, carrierFrequency);
+                if (bytes > 0) {
+                    allocator_->addBlocks(MACRO, b, nodeId, 1, bytes);
+                    racAllocatedBlocks++;
 
-                        EV << NOW << "LteSchedulerEnbUl::racschedule UE: " << nodeId << "Handled RAC on band: " << b << endl;
+                    EV << NOW << "LteSchedulerEnbUl::racschedule UE: " << nodeId << "Handled RAC on band: " << b << endl;
 
-                        allocation = true;
-                        break;
-                    }
+                    allocation = true;
+                    break;
                 }
             }
 
+            if (!bandAvailable) {
+                EV << NOW << " LteSchedulerEnbUl::racschedule no free band left, RAC for node " << nodeId << " deferred" << endl;
+                fullPlanes.insert(plane);
+                continue;
+            }
+
             if (allocation) {
                 // create scList id for current cid/codeword
                 MacCid cid = idToMacCid(nodeId, SHORT_BSR);  // build the cid. Since this grant will be used for a BSR,
                                                              // we use the LCID corresponding to the SHORT_BSR
                 std::pair<unsigned int, Codeword> scListId = {cid, cw};
                 scheduleList_[carrierFrequency][scListId] = blocks;
+
+                mac_->emit(racGrantDelaySignal_, NOW - arrival);
             }
+            racStatus.erase(nodeId);
         }
 
-        // clean up all requests
-        racStatus.clear();
+        EV << NOW << " LteSchedulerEnbUl::racschedule " << racStatus.size() << " RAC requests deferred to the next slot" << endl;
     }
 
+    // grant resources to connections whose next arrival is imminent
+    if (preGrantEnabled_ && racAllocatedBlocks < numBands)
+        racAllocatedBlocks += preGrantSchedule(carrierFrequency, bandLim, bandwidthPart);
+
     if (racAllocatedBlocks < numBands) {
         // serve RAC for background UEs
         racscheduleBackground(racAllocatedBlocks, carrierFrequency, bandLim);
@@ -195,30 +215,29 @@ void LteSchedulerEnbUl::racscheduleBackground(unsigned int& racAllocatedBlocks,
     // Get number of logical bands
     unsigned int numBands = mac_->getCellInfo()->getNumBands();
 
+    BandLimitVector tempBandLim;
+    if (bandLim == nullptr) {
+        // Create a vector of band limit using all bands
+
+        // for each band of the band vector provided
+        for (unsigned int i = 0; i < numBands; i++) {
+            BandLimit elem;
+            // copy the band
+            elem.band_ = Band(i);
+            for (unsigned int j = 0; j < MAX_CODEWORDS; j++) {
+                elem.limit_[j] = -1;
+            }
+            tempBandLim.push_back(elem);
+        }
+        bandLim = &tempBandLim;
+    }
+
     for (auto it = bgTrafficManager->getWaitingForRacUesBegin(), et = bgTrafficManager->getWaitingForRacUesEnd(); it != et; ++it) {
         // get current nodeId
         MacNodeId bgUeId = BGUE_MIN_ID + *it;
 
         EV << NOW << " LteSchedulerEnbUl::racscheduleBackground handling RAC for node " << bgUeId << endl;
 
-        BandLimitVector tempBandLim;
-        std::string bands_msg = "BAND_LIMIT_SPECIFIED";
-        if (bandLim == nullptr) {
-            // Create a vector of band limit using all bands
-
-            // for each band of the band vector provided
-            for (unsigned int i = 0; i < numBands; i++) {
-                BandLimit elem;
-                // copy the band
-                elem.band_ = Band(i);
-                for (unsigned int j = 0; j < MAX_CODEWORDS; j++) {
-                    elem.limit_[j] = -1;
-                }
-                tempBandLim.push_back(elem);
-            }
-            bandLim = &tempBandLim;
-        }
-
         // FIXME default behavior
         // try to allocate one block to selected UE on at least one logical band of MACRO antenna, first codeword
 
@@ -270,13 +289,9 @@ bool LteSchedulerEnbUl::rtxschedule(double carrierFrequency, BandLimitVector *ba
                 // get current nodeId
                 MacNodeId nodeId = it->first;
 
-                if (nodeId == NODEID_NONE) {
+                if (nodeId == NODEID_NONE || binder_->getOmnetId(nodeId) == 0) {
                     // UE has left the simulation - erase queue and continue
-                    it = rxBufferForCarrierFrequency.erase(it);
-                    continue;
-                }
-                OmnetId id = binder_->getOmnetId(nodeId);
-                if (id == 0) {
+                    delete it->second;
                     it = rxBufferForCarrierFrequency.erase(it);
                     continue;
                 }
@@ -327,18 +342,20 @@ bool LteSchedulerEnbUl::rtxschedule(double carrierFrequency, BandLimitVector *ba
             Direction dir = D2D;
             HarqBuffersMirrorD2D *harqBuffersMirrorD2D = check_and_cast<LteMacEnbD2D *>(mac_.get())->getHarqBuffersMirrorD2D(carrierFrequency);
             if (harqBuffersMirrorD2D != nullptr) {
-                for (auto it_d2d = harqBuffersMirrorD2D->begin(); it_d2d != harqBuffersMirrorD2D->end(); ) {
-                    MacNodeId senderId = (it_d2d->first).first; // Transmitter
-                    MacNodeId destId = (it_d2d->first).second;  // Receiver
+                // only the pairs with units waiting for retransmission are visited
+                for (auto slot : harqBuffersMirrorD2D->getPendingSlots()) {
+                    D2DPair pair = harqBuffersMirrorD2D->getPair(slot);
+                    MacNodeId senderId = pair.first; // Transmitter
+                    MacNodeId destId = pair.second;  // Receiver
 
                     if (senderId == NODEID_NONE || binder_->getOmnetId(senderId) == 0) {
                         // UE has left the simulation - erase queue and continue
-                        it_d2d = harqBuffersMirrorD2D->erase(it_d2d);
+                        harqBuffersMirrorD2D->erase(pair);
                         continue;
                     }
                     if (destId == NODEID_NONE || binder_->getOmnetId(destId) == 0) {
                         // UE has left the simulation - erase queue and continue
-                        it_d2d = harqBuffersMirrorD2D->erase(it_d2d);
+                        harqBuffersMirrorD2D->erase(pair);
                         continue;
                     }
 
@@ -347,19 +364,17 @@ bool LteSchedulerEnbUl::rtxschedule(double carrierFrequency, BandLimitVector *ba
 
                     // check whether the UE has a H-ARQ process waiting for retransmission. If not, skip UE.
                     bool skip = true;
-                    unsigned char acid = (currentAcid + 2) % (it_d2d->second->getProcesses());
-                    LteHarqProcessMirrorD2D *currentProcess = it_d2d->second->getProcess(acid);
-                    std::vector<TxHarqPduStatus> procStatus = currentProcess->getProcessStatus();
-                    for (const auto& status : procStatus) {
+                    LteHarqBufferMirrorD2D *currHarq = harqBuffersMirrorD2D->getBuffer(slot);
+                    unsigned char acid = (currentAcid + 2) % (currHarq->getProcesses());
+                    LteHarqProcessMirrorD2D *currentProcess = currHarq->getProcess(acid);
+                    for (const auto& status : currentProcess->getProcessStatus()) {
                         if (status == TXHARQ_PDU_BUFFERED) {
                             skip = false;
                             break;
                         }
                     }
-                    if (skip) {
-                        ++it_d2d;
+                    if (skip)
                         continue;
-                    }
 
                     EV << NOW << " LteSchedulerEnbUl::rtxschedule - D2D UE: " << senderId << " Acid: " << (unsigned int)currentAcid << endl;
 
@@ -377,7 +392,6 @@ bool LteSchedulerEnbUl::rtxschedule(double carrierFrequency, BandLimitVector *ba
                         }
                     }
                     EV << NOW << " LteSchedulerEnbUl::rtxschedule - D2D UE: " << senderId << " allocated bytes : " << allocatedBytes << endl;
-                    ++it_d2d;
                 }
             }
         }
@@ -932,11 +946,329 @@ unsigned int LteSchedulerEnbUl::scheduleBgRtx(MacNodeId bgUeId, double carrierFr
 
 void LteSchedulerEnbUl::removePendingRac(MacNodeId nodeId)
 {
-    for (auto& item : racStatus_) {
-        RacStatus::iterator elem_it = item.second.find(nodeId);
-        if (elem_it != item.second.end())
-            item.second.erase(nodeId);
+    eraseNodeFromEach(racStatus_, nodeId);
+
+    // the synchronous H-ARQ process counters of the UE are not needed anymore
+    eraseNodeFromEach(harqStatus_, nodeId);
+}
+
+void LteSchedulerEnbUl::initializePreGrants()
+{
+    preGrantEnabled_ = mac_->par("preGrantEnabled").boolValue();
+    preGrantConfidence_ = mac_->par("preGrantConfidence").doubleValue();
+    preGrantTolerance_ = mac_->par("preGrantTolerance").doubleValue();
+    preGrantSmoothing_ = mac_->par("preGrantSmoothing").doubleValue();
+    preGrantLead_ = mac_->par("preGrantLead").doubleValue();
+    preGrantWindow_ = mac_->par("preGrantWindow").doubleValue();
+    preGrantValidity_ = mac_->par("preGrantValidity").doubleValue();
+    preGrantMinPeriod_ = mac_->par("preGrantMinPeriod").doubleValue();
+    preGrantPeriodic_ = mac_->par("preGrantPeriodic").boolValue();
+    int expiration = mac_->par("preGrantExpiration");
+
+    if (preGrantSmoothing_ <= 0 || preGrantSmoothing_ > 1)
+        throw cRuntimeError("LteSchedulerEnbUl::initializePreGrants - preGrantSmoothing must be in (0,1], found %f", preGrantSmoothing_);
+    if (expiration < 1)
+        throw cRuntimeError("LteSchedulerEnbUl::initializePreGrants - preGrantExpiration must be at least 1 slot, found %d", expiration);
+    preGrantExpiration_ = expiration;
+}
+
+unsigned int LteSchedulerEnbUl::allocateConfiguredGrants(double carrierFrequency, int bandwidthPart)
+{
+    auto cit = configuredGrants_.find(carrierFrequency);
+    if (cit == configuredGrants_.end())
+        return 0;
+
+    simtime_t slot = mac_->getTtiPeriod();
+    unsigned int allocatedBlocks = 0;
+    const unsigned int cw = 0;
+
+    for (auto it = cit->second.begin(); it != cit->second.end(); ) {
+        MacNodeId nodeId = it->first;
+        ConfiguredGrant& grant = it->second;
+        if (bandwidthPart >= 0 && mac_->getBandwidthPart(grant.cid) != (unsigned int)bandwidthPart) {
+            ++it;
+            continue;
+        }
+
+        // the UE transmits on the grant at the period-th TTI after receiving it, and then every period TTIs
+        // while not expired. As for the other grants, the blocks are allocated one slot before they are used
+        if (grant.occasion * grant.period > grant.expiration) {
+            EV << NOW << " LteSchedulerEnbUl::allocateConfiguredGrants - configured grant of UE " << nodeId << " expired" << endl;
+            it = cit->second.erase(it);
+            continue;
+        }
+        if (NOW < grant.issueTime + slot * (grant.occasion * grant.period - 1)) {
+            ++it;
+            continue;
+        }
+
+        unsigned int grantedBytes = 0;
+        for (const auto& [b, blocks] : grant.blocks) {
+            unsigned int allocated = std::min(blocks, allocator_->availableBlocks(nodeId, MACRO, b));
+            if (allocated == 0)
+                continue;
+            unsigned int bytes = mac_->getAmc()->computeBytesOnSubband(nodeId, b, cw, allocated, UL, carrierFrequency);
+            allocator_->addBlocks(MACRO, b, nodeId, allocated, bytes);
+            grantedBytes += bytes;
+            allocatedBlocks += allocated;
+        }
+        grant.occasion++;
+
+        // the bytes of each occasion are accounted as a pre-grant
+        ArrivalPredictor& pred = preGrantPredictors_[grant.cid];
+        if (NOW > pred.windowEnd) {
+            pred.windowEnd = NOW + preGrantWindow_;
+            pred.hit = false;
+        }
+        pred.outstandingBytes += grantedBytes;
+
+        EV << NOW << " LteSchedulerEnbUl::allocateConfiguredGrants - UE " << nodeId << " occasion " << grant.occasion - 1
+           << ", allocated " << grantedBytes << " bytes" << endl;
+        ++it;
     }
+
+    return allocatedBlocks;
+}
+
+unsigned int LteSchedulerEnbUl::preGrantSchedule(double carrierFrequency, BandLimitVector *bandLim, int bandwidthPart)
+{
+    EV << NOW << " LteSchedulerEnbUl::preGrantSchedule - carrier [" << carrierFrequency << "]" << endl;
+
+    unsigned int allocatedBlocks = 0;
+    const unsigned int cw = 0;
+
+    // new configured grants are not given the bands already used by the configured grants of the carrier,
+    // whose blocks are allocated first at each of their occasions
+    std::map<MacNodeId, ConfiguredGrant>& configuredGrants = configuredGrants_[carrierFrequency];
+    std::set<Band> configuredBands;
+    for (const auto& [nodeId, grant] : configuredGrants) {
+        for (const auto& [b, blocks] : grant.blocks)
+            configuredBands.insert(b);
+    }
+    simtime_t slot = mac_->getTtiPeriod();
+
+    for (auto& [cid, pred] : preGrantPredictors_) {
+        // close the expired window: whatever was not used by the UE is wasted
+        if (pred.outstandingBytes > 0 && NOW > pred.windowEnd + preGrantValidity_) {
+            recordPreGrantWaste(cid, pred.outstandingBytes);
+            pred.outstandingBytes = 0;
+
+            // the predicted arrival did not occur, lower the confidence. Pre-grants for this
+            // connection will stop as soon as the confidence falls below the threshold
+            if (!pred.hit)
+                pred.confidence *= (1 - preGrantSmoothing_);
+        }
+
+        if (pred.carrierFrequency != carrierFrequency || pred.period <= 0 || pred.confidence < preGrantConfidence_)
+            continue;
+        if (bandwidthPart >= 0 && mac_->getBandwidthPart(cid) != (unsigned int)bandwidthPart)
+            continue;
+
+        // the UE already transmits on a configured grant
+        MacNodeId nodeId = MacCidToNodeId(cid);
+        if (configuredGrants.find(nodeId) != configuredGrants.end())
+            continue;
+
+        simtime_t expectedArrival = pred.lastArrival + pred.period;
+        if (NOW < expectedArrival - preGrantLead_ || NOW > expectedArrival + preGrantWindow_)
+            continue;
+
+        // backlog of the UE is already known through a BSR (stored once per UE, not per connection),
+        // the UE is served by the regular scheduling
+        bool reported = false;
+        for (auto bit = lowerBoundNodeCid(*bsrbuf_, nodeId); bit != bsrbuf_->end() && MacCidToNodeId(bit->first) == nodeId; ++bit) {
+            if (!bit->second->isEmpty()) {
+                reported = true;
+                break;
+            }
+        }
+        if (reported)
+            continue;
+
+        // open a new window
+        if (pred.windowEnd != expectedArrival + preGrantWindow_) {
+            pred.windowEnd = expectedArrival + preGrantWindow_;
+            pred.hit = false;
+        }
+
+        Codeword availableCw = cw;
+        if (!checkEligibility(nodeId, availableCw, carrierFrequency) || availableCw != cw)
+            continue;
+
+        const UserTxParams& txParams = mac_->getAmc()->computeTxParams(nodeId, UL, carrierFrequency);
+        const std::set<Band>& allowedBands = txParams.readBands();
+
+        unsigned int toServe = (unsigned int)ceil(pred.burstSize) + MAC_HEADER;
+        unsigned int grantedBytes = 0;
+        unsigned int grantedBlocks = 0;
+        std::vector<std::pair<Band, unsigned int>> grantBlocks;
+
+        // bands marked as not usable for the carrier or the BWP are skipped, as for RAC and grants
+        unsigned int numBands = (bandLim != nullptr) ? bandLim->size() : mac_->getCellInfo()->getNumBands();
+        for (unsigned int i = 0; i < numBands && grantedBytes < toServe; ++i) {
+            Band b = (bandLim != nullptr) ? bandLim->at(i).band_ : Band(i);
+            if (allowedBands.find(b) == allowedBands.end())
+                continue;
+            if (bandLim != nullptr && bandLim->at(i).limit_.at(cw) == -2)
+                continue;
+            if (configuredBands.find(b) != configuredBands.end())
+                continue;
+
+            unsigned int available = allocator_->availableBlocks(nodeId, MACRO, b);
+            if (available == 0)
+                continue;
+
+            // use the minimum number of blocks covering the predicted burst
+            unsigned int blocks = 0;
+            unsigned int bytes = 0;
+            while (blocks < available && grantedBytes + bytes < toServe)
+                bytes = mac_->getAmc()->computeBytesOnSubband(nodeId, b, cw, ++blocks, UL, carrierFrequency);
+
+            if (bytes == 0)
+                continue;
+
+            allocator_->addBlocks(MACRO, b, nodeId, blocks, bytes);
+            grantedBytes += bytes;
+            grantedBlocks += blocks;
+            grantBlocks.emplace_back(b, blocks);
+        }
+
+        if (grantedBlocks == 0)
+            continue;
+
+        std::pair<unsigned int, Codeword> scListId = {cid, cw};
+        scheduleList_[carrierFrequency][scListId] += grantedBlocks;
+        allocatedBlocks += grantedBlocks;
+
+        // the pre-grant is issued as a configured grant with the learned period, if the period fits its validity
+        unsigned int period = std::max(1u, (unsigned int)round(pred.period / slot.dbl()));
+        if (preGrantPeriodic_ && period <= preGrantExpiration_) {
+            ConfiguredGrant& grant = configuredGrants[nodeId];
+            grant.cid = cid;
+            grant.issueTime = NOW;
+            grant.period = period;
+            grant.expiration = preGrantExpiration_;
+            grant.blocks = grantBlocks;
+
+            // the first occasion comes one period later: only with a period of one slot the UE uses
+            // the blocks allocated now
+            grant.occasion = (period == 1) ? 2 : 1;
+            if (period == 1)
+                pred.outstandingBytes += grantedBytes;
+
+            EV << NOW << " LteSchedulerEnbUl::preGrantSchedule - cid " << cid << " configured grant, period " << period
+               << " slots, expiration " << preGrantExpiration_ << " slots" << endl;
+        }
+        else
+            pred.outstandingBytes += grantedBytes;
+
+        EV << NOW << " LteSchedulerEnbUl::preGrantSchedule - cid " << cid << " predicted arrival " << expectedArrival
+           << " (period " << pred.period << "s, confidence " << pred.confidence << "), granted " << grantedBlocks
+           << " blocks / " << grantedBytes << " bytes" << endl;
+    }
+
+    return allocatedBlocks;
+}
+
+void LteSchedulerEnbUl::notifyUlReception(MacCid cid, unsigned int bytes, simtime_t arrival, double carrierFrequency)
+{
+    simtime_t delay = NOW - arrival;
+    mac_->emit(ulAccessDelaySignal_, delay);
+
+    if (!preGrantEnabled_)
+        return;
+
+    ArrivalPredictor& pred = preGrantPredictors_[cid];
+    pred.carrierFrequency = carrierFrequency;
+
+    // pre-grant accounting
+    if (pred.outstandingBytes > 0) {
+        unsigned int used = std::min(bytes, pred.outstandingBytes);
+        pred.outstandingBytes -= used;
+        pred.hit = true;
+        preGrantUsedBytes_[QfiContextManager::getInstance()->getQfiForCid(cid)] += used;
+        mac_->emit(preGrantAccessDelaySignal_, delay);
+    }
+
+    // SDUs arriving close to each other belong to the same burst
+    if (pred.lastArrival >= 0 && arrival - pred.lastArrival < preGrantMinPeriod_) {
+        pred.currentBurstBytes += bytes;
+        return;
+    }
+
+    // new burst: update the estimates with the last inter-arrival and the size of the previous burst
+    if (pred.lastArrival >= 0) {
+        double interval = (arrival - pred.lastArrival).dbl();
+        if (pred.period == 0) {
+            pred.period = interval;
+        }
+        else {
+            bool match = fabs(interval - pred.period) <= preGrantTolerance_ * pred.period;
+            pred.confidence = (1 - preGrantSmoothing_) * pred.confidence + preGrantSmoothing_ * (match ? 1.0 : 0.0);
+            pred.period = (1 - preGrantSmoothing_) * pred.period + preGrantSmoothing_ * interval;
+        }
+        pred.burstSize = (pred.burstSize == 0) ? pred.currentBurstBytes
+            : (1 - preGrantSmoothing_) * pred.burstSize + preGrantSmoothing_ * pred.currentBurstBytes;
+    }
+    pred.lastArrival = arrival;
+    pred.currentBurstBytes = bytes;
+
+    EV << NOW << " LteSchedulerEnbUl::notifyUlReception - cid " << cid << " new burst at " << arrival << ", period " << pred.period
+       << "s, size " << pred.burstSize << "B, confidence " << pred.confidence << endl;
+}
+
+void LteSchedulerEnbUl::recordPreGrantWaste(MacCid cid, unsigned int bytes)
+{
+    EV << NOW << " LteSchedulerEnbUl::recordPreGrantWaste - cid " << cid << " wasted " << bytes << " pre-granted bytes" << endl;
+
+    preGrantWastedBytes_[QfiContextManager::getInstance()->getQfiForCid(cid)] += bytes;
+    mac_->emit(preGrantWastedBytesSignal_, (long)bytes);
+}
+
+void LteSchedulerEnbUl::removePreGrantPredictors(MacNodeId nodeId)
+{
+    for (auto it = preGrantPredictors_.begin(); it != preGrantPredictors_.end(); ) {
+        if (MacCidToNodeId(it->first) == nodeId)
+            it = preGrantPredictors_.erase(it);
+        else
+            ++it;
+    }
+
+    for (auto& item : configuredGrants_)
+        item.second.erase(nodeId);
+}
+
+bool LteSchedulerEnbUl::getIssuedConfiguredGrant(MacNodeId nodeId, double carrierFrequency, unsigned int& period, unsigned int& expiration) const
+{
+    auto cit = configuredGrants_.find(carrierFrequency);
+    if (cit == configuredGrants_.end())
+        return false;
+    auto it = cit->second.find(nodeId);
+    if (it == cit->second.end() || it->second.issueTime != NOW)
+        return false;
+
+    period = it->second.period;
+    expiration = it->second.expiration;
+    return true;
+}
+
+void LteSchedulerEnbUl::releaseConfiguredGrant(MacNodeId nodeId, double carrierFrequency)
+{
+    auto cit = configuredGrants_.find(carrierFrequency);
+    if (cit != configuredGrants_.end() && cit->second.erase(nodeId) > 0)
+        EV << NOW << " LteSchedulerEnbUl::releaseConfiguredGrant - configured grant of UE " << nodeId << " replaced" << endl;
+}
+
+void LteSchedulerEnbUl::recordPreGrantStatistics()
+{
+    if (!preGrantEnabled_)
+        return;
+
+    // QFI -1 collects the connections without a registered QFI
+    for (const auto& [qfi, bytes] : preGrantUsedBytes_)
+        mac_->recordScalar(("preGrantUsedBytes:qfi" + std::to_string(qfi)).c_str(), bytes);
+    for (const auto& [qfi, bytes] : preGrantWastedBytes_)
+        mac_->recordScalar(("preGrantWastedBytes:qfi" + std::to_string(qfi)).c_str(), bytes);
 }
 
 } //namespace
@@ -12,6 +12,9 @@
 #ifndef _LTE_LTE_SCHEDULER_ENB_UL_H_
 #define _LTE_LTE_SCHEDULER_ENB_UL_H_
 
+#include <algorithm>
+#include <tuple>
+
 #include "stack/mac/scheduler/LteSchedulerEnb.h"
 
 namespace simu5g {
@@ -26,7 +29,14 @@ class LteSchedulerEnbUl : public LteSchedulerEnb
   protected:
 
     typedef std::map<MacNodeId, unsigned char> HarqStatus;
-    typedef std::map<MacNodeId, bool> RacStatus;
+    /// pending RAC request of a UE
+    struct RacRequest
+    {
+        simtime_t arrival;
+        int priorityLevel;
+        int bandwidthPart;    // BWP serving the request, -1 if BWPs are not used
+    };
+    typedef std::map<MacNodeId, RacRequest> RacStatus;
 
     /// Minimum scheduling unit, represents the MAC SDU size
     unsigned int scheduleUnit_;
@@ -44,9 +54,91 @@ class LteSchedulerEnbUl : public LteSchedulerEnb
     //! Uplink Synchronous H-ARQ process counter - keeps track of currently active process on connected UEs.
     std::map<double, HarqStatus> harqStatus_;
 
-    //! RAC request flags: signals whether a UE shall be granted the RAC allocation
+    //! Pending RAC requests: arrival time of the oldest request of each UE still waiting for the RAC allocation,
+    //! with the best priority level reported by the UE since then and the BWP of that level
     std::map<double, RacStatus> racStatus_;
 
+    /*
+     * UL pre-grant predictor, one per UL connection.
+     * Tracks the arrival period and burst size of the connection, so that a grant can be
+     * issued just ahead of the next predicted arrival, without waiting for the BSR.
+     */
+    struct ArrivalPredictor
+    {
+        simtime_t lastArrival = -1;            // UE-side arrival time of the last burst
+        double period = 0;                     // smoothed inter-arrival period (s)
+        double burstSize = 0;                  // smoothed burst size (bytes)
+        unsigned int currentBurstBytes = 0;    // bytes received so far for the last burst
+        double confidence = 0;                 // smoothed fraction of periods matching the estimate
+        double carrierFrequency = 0;           // carrier where the connection was last served
+
+        unsigned int outstandingBytes = 0;     // pre-granted bytes not used yet
+        simtime_t windowEnd = -1;              // end of the current pre-grant window
+        bool hit = false;                      // true if the current window was used by the UE
+    };
+    typedef std::map<MacCid, ArrivalPredictor> ArrivalPredictorMap;
+
+    ArrivalPredictorMap preGrantPredictors_;
+
+    /*
+     * Periodic (configured) pre-grant of a UE. The UE transmits on it every 'period' slots
+     * until it expires, thus the blocks granted when it is issued are allocated again at
+     * each of its occasions
+     */
+    struct ConfiguredGrant
+    {
+        MacCid cid = 0;                                      // connection the grant was issued for
+        simtime_t issueTime;                                 // slot the grant was sent in
+        unsigned int period = 1;                             // slots between two occasions
+        unsigned int expiration = 0;                         // slots the grant is valid for
+        unsigned int occasion = 1;                           // index of the next occasion to allocate
+        std::vector<std::pair<Band, unsigned int>> blocks;   // blocks granted on each band
+    };
+    // configured grants of each carrier, at most one per UE
+    std::map<double, std::map<MacNodeId, ConfiguredGrant>> configuredGrants_;
+
+    // pre-grant parameters (read from the MAC module)
+    bool preGrantEnabled_ = false;
+    double preGrantConfidence_ = 0.8;
+    double preGrantTolerance_ = 0.1;
+    double preGrantSmoothing_ = 0.2;
+    simtime_t preGrantLead_;
+    simtime_t preGrantWindow_;
+    simtime_t preGrantValidity_;
+    simtime_t preGrantMinPeriod_;
+    bool preGrantPeriodic_ = false;
+    unsigned int preGrantExpiration_ = 0;
+
+    // per-QFI pre-grant statistics: pre-granted bytes used by the UE / wasted
+    std::map<int, unsigned long> preGrantUsedBytes_;
+    std::map<int, unsigned long> preGrantWastedBytes_;
+
+    static simsignal_t ulAccessDelaySignal_;
+    static simsignal_t racGrantDelaySignal_;
+    static simsignal_t preGrantAccessDelaySignal_;
+    static simsignal_t preGrantWastedBytesSignal_;
+
+    /**
+     * Issues pre-grants to the connections whose next arrival is expected within the
+     * pre-grant window and closes the expired windows, accounting the unused bytes.
+     * With bandwidth parts, only the connections of the given BWP are pre-granted (all of them if -1).
+     * @return the number of allocated blocks
+     */
+    virtual unsigned int preGrantSchedule(double carrierFrequency, BandLimitVector *bandLim = nullptr, int bandwidthPart = -1);
+
+    /**
+     * Allocates the blocks of the configured grants having an occasion at the current slot
+     * and releases the expired ones.
+     * With bandwidth parts, only the grants of the connections of the given BWP are handled (all of them if -1).
+     * @return the number of allocated blocks
+     */
+    unsigned int allocateConfiguredGrants(double carrierFrequency, int bandwidthPart = -1);
+
+    /**
+     * Accounts pre-granted bytes that have not been used by the UE
+     */
+    void recordPreGrantWaste(MacCid cid, unsigned int bytes);
+
   public:
 
     //! Updates HARQ descriptor current process pointer (to be called every TTI by main loop).
@@ -56,7 +148,7 @@ class LteSchedulerEnbUl : public LteSchedulerEnb
      * Updates current schedule list with RAC grant responses.
      * @return TRUE if OFDM space is exhausted.
      */
-    bool racschedule(double carrierFrequency, BandLimitVector *bandLim = nullptr) override;
+    bool racschedule(double carrierFrequency, BandLimitVector *bandLim = nullptr, int bandwidthPart = -1) override;
     virtual void racscheduleBackground(unsigned int& racAllocatedBlocks, double carrierFrequency, BandLimitVector *bandLim = nullptr);
 
     /**
@@ -72,15 +164,19 @@ class LteSchedulerEnbUl : public LteSchedulerEnb
     bool rtxscheduleBackground(double carrierFrequency, BandLimitVector *bandLim = nullptr) override;
 
     /**
-     * signals RAC request to the scheduler (called by e/gNb)
+     * signals all the SRs and RAC requests received in a slot, with their arrival times,
+     * priority levels and bandwidth parts, to the scheduler (called by e/gNb)
      */
-    virtual void signalRac(MacNodeId nodeId, double carrierFrequency)
+    virtual void signalSr(const std::vector<std::tuple<MacNodeId, simtime_t, int, int>>& requests, double carrierFrequency)
     {
-        if (racStatus_.find(carrierFrequency) == racStatus_.end()) {
-            RacStatus newMap;
-            racStatus_[carrierFrequency] = newMap;
+        RacStatus& racStatus = racStatus_[carrierFrequency];
+        for (const auto& [nodeId, arrival, priorityLevel, bandwidthPart] : requests) {
+            auto [it, inserted] = racStatus.emplace(nodeId, RacRequest{ arrival, priorityLevel, bandwidthPart });
+            if (!inserted && priorityLevel < it->second.priorityLevel) {
+                it->second.priorityLevel = priorityLevel;
+                it->second.bandwidthPart = bandwidthPart;
+            }
         }
-        racStatus_.at(carrierFrequency)[nodeId] = true;
     }
 
     /**
@@ -104,7 +200,49 @@ class LteSchedulerEnbUl : public LteSchedulerEnb
     unsigned int scheduleBgRtx(MacNodeId bgUeId, double carrierFrequency, Codeword cw, std::vector<BandLimit> *bandLim = nullptr,
             Remote antenna = MACRO, bool limitBl = false) override;
 
+    /**
+     * Removes the pending RAC requests and the H-ARQ process counters of the given UE
+     */
     void removePendingRac(MacNodeId nodeId);
+
+    /**
+     * Reads the pre-grant parameters from the MAC module (called by e/gNb at init)
+     */
+    virtual void initializePreGrants();
+
+    /**
+     * Signals the reception of a UL MAC SDU (called by e/gNb). Updates the arrival
+     * period and burst size estimates of the connection and the pre-grant accounting.
+     *
+     * @param cid connection of the SDU
+     * @param bytes size of the SDU
+     * @param arrival time the SDU entered the UE MAC buffer
+     * @param carrierFrequency carrier the SDU was received on
+     */
+    virtual void notifyUlReception(MacCid cid, unsigned int bytes, simtime_t arrival, double carrierFrequency);
+
+    /**
+     * Removes the arrival predictors and the configured grants of the given UE
+     */
+    void removePreGrantPredictors(MacNodeId nodeId);
+
+    /**
+     * Returns true if a configured grant has been issued to the UE on the given carrier
+     * in the current slot, with its period and expiration in slots (called by e/gNb
+     * when sending the grants)
+     */
+    bool getIssuedConfiguredGrant(MacNodeId nodeId, double carrierFrequency, unsigned int& period, unsigned int& expiration) const;
+
+    /**
+     * Releases the configured grant of the UE on the given carrier, e.g. when the
+     * UE is sent another grant that replaces it
+     */
+    void releaseConfiguredGrant(MacNodeId nodeId, double carrierFrequency);
+
+    /**
+     * Records per-QFI pre-grant statistics (called by e/gNb at finish)
+     */
+    void recordPreGrantStatistics();
 };
 
 } //namespace
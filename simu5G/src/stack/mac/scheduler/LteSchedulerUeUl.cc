@@ -49,6 +49,7 @@ LteMacScheduleList *LteSchedulerUeUl::schedule()
 
     // clean up old scheduling decisions
     scheduleList_.clear();
+    scheduledBytesList_.clear();
 
     // get the grant
     const LteSchedulingGrant *grant = mac_->getSchedulingGrant(carrierFrequency_);
@@ -98,22 +99,6 @@ LteMacScheduleList *LteSchedulerUeUl::schedule()
             // set schedule list entry
             scheduledBytesList_[{cid, cw}] = byte;
         }
-
-        MacCid highestBackloggedFlow = 0;
-        MacCid highestBackloggedPriority = 0;
-        MacCid lowestBackloggedFlow = 0;
-        MacCid lowestBackloggedPriority = 0;
-        bool backlog = false;
-
-        // get the highest backlogged flow id and priority
-        backlog = mac_->getHighestBackloggedFlow(highestBackloggedFlow, highestBackloggedPriority);
-
-        if (backlog) { // at least one backlogged flow exists
-            // get the lowest backlogged flow id and priority
-            mac_->getLowestBackloggedFlow(lowestBackloggedFlow, lowestBackloggedPriority);
-        }
-
-        // TODO make use of the above values
     }
     return &scheduleList_;
 }
@@ -51,17 +51,16 @@ bool NRSchedulerGnbUl::rtxschedule(double carrierFrequency, BandLimitVector *ban
         // retrieving reference to HARQ entities
         HarqRxBuffers *harqQueues = mac_->getHarqRxBuffers(carrierFrequency);
         if (harqQueues != nullptr) {
-            for (auto [nodeId, currHarq] : *harqQueues) {
-                if (nodeId == NODEID_NONE) {
+            for (auto it = harqQueues->begin(); it != harqQueues->end(); ) {
+                MacNodeId nodeId = it->first;
+                LteHarqBufferRx *currHarq = it->second;
+                if (nodeId == NODEID_NONE || binder_->getOmnetId(nodeId) == 0) {
                     // UE has left the simulation - erase queue and continue
-                    harqRxBuffers_->at(carrierFrequency).erase(nodeId);
-                    continue;
-                }
-                OmnetId id = binder_->getOmnetId(nodeId);
-                if (id == 0) {
-                    harqRxBuffers_->at(carrierFrequency).erase(nodeId);
+                    delete currHarq;
+                    it = harqQueues->erase(it);
                     continue;
                 }
+                ++it;
 
                 // Get user transmission parameters
                 const UserTxParams& txParams = mac_->getAmc()->computeTxParams(nodeId, direction_, carrierFrequency);// get the user info
@@ -114,24 +113,26 @@ bool NRSchedulerGnbUl::rtxschedule(double carrierFrequency, BandLimitVector *ban
             Direction dir = D2D;
             HarqBuffersMirrorD2D *harqBuffersMirrorD2D = check_and_cast<LteMacEnbD2D *>(mac_.get())->getHarqBuffersMirrorD2D(carrierFrequency);
             if (harqBuffersMirrorD2D != nullptr) {
-                for (auto it_d2d = harqBuffersMirrorD2D->begin(); it_d2d != harqBuffersMirrorD2D->end(); ) {
+                // only the pairs with units waiting for retransmission are visited
+                for (auto slot : harqBuffersMirrorD2D->getPendingSlots()) {
 
                     // get current nodeIDs
-                    MacNodeId senderId = (it_d2d->first).first; // Transmitter
-                    MacNodeId destId = (it_d2d->first).second;  // Receiver
+                    D2DPair pair = harqBuffersMirrorD2D->getPair(slot);
+                    MacNodeId senderId = pair.first; // Transmitter
+                    MacNodeId destId = pair.second;  // Receiver
 
                     if (senderId == NODEID_NONE || binder_->getOmnetId(senderId) == 0) {
                         // UE has left the simulation - erase queue and continue
-                        harqBuffersMirrorD2D->erase(it_d2d++);
+                        harqBuffersMirrorD2D->erase(pair);
                         continue;
                     }
                     if (destId == NODEID_NONE || binder_->getOmnetId(destId) == 0) {
                         // UE has left the simulation - erase queue and continue
-                        harqBuffersMirrorD2D->erase(it_d2d++);
+                        harqBuffersMirrorD2D->erase(pair);
                         continue;
                     }
 
-                    LteHarqBufferMirrorD2D *currHarq = it_d2d->second;
+                    LteHarqBufferMirrorD2D *currHarq = harqBuffersMirrorD2D->getBuffer(slot);
 
                     // Get user transmission parameters
                     const UserTxParams& txParams = mac_->getAmc()->computeTxParams(senderId, dir, carrierFrequency);// get the user info
@@ -176,7 +177,6 @@ bool NRSchedulerGnbUl::rtxschedule(double carrierFrequency, BandLimitVector *ban
                         }
                         EV << NOW << " NRSchedulerGnbUl::rtxschedule - D2D UE: " << senderId << " allocated bytes : " << allocatedBytes << endl;
                     }
-                    ++it_d2d;
                 }
             }
             // --- END Schedule D2D retransmissions --- //
@@ -9,6 +9,8 @@
 // and cannot be removed from it.
 //
 
+#include <map>
+
 #include "stack/mac/scheduling_modules/LteAllocatorBestFit.h"
 #include "stack/mac/scheduler/LteSchedulerEnb.h"
 #include "stack/mac/buffer/LteMacBuffer.h"
@@ -183,7 +185,7 @@ void LteAllocatorBestFit::prepareSchedule()
             for (const Band& band : bands) {
                 unsigned int blocks = eNbScheduler_->readAvailableRbs(nodeId, antenna, band);
                 availableBlocks += blocks;
-                availableBytes += eNbScheduler_->mac_->getAmc()->computeBytesOnNRbs(nodeId, band, blocks, dir, carrierFrequency_);
+                availableBytes += eNbScheduler_->mac_->getAmc()->computeBytesOnSubband(nodeId, band, blocks, dir, carrierFrequency_);
             }
         }
 
@@ -242,7 +244,8 @@ void LteAllocatorBestFit::prepareSchedule()
         Codeword cw = 0;
         unsigned int req_RBs = 0;
 
-        // Calculate the number of Bytes available in a block
+        // Calculate the number of Bytes available in a block, on the wideband CQI. It is used to size the
+        // hole to search for: the RBs are then booked according to the sub-band CQI of each band
         unsigned int req_Bytes1RB = eNbScheduler_->mac_->getAmc()->computeBytesOnNRbs(nodeId, 0, cw, 1, dir, carrierFrequency_); // The band (here equals to 0) is useless
 
         // This calculation is for coherence with the allocation done in the ScheduleGrant function
@@ -252,10 +255,12 @@ void LteAllocatorBestFit::prepareSchedule()
         unsigned int numBands = mac_->getCellInfo()->getNumBands();
 
         unsigned int blocks = 0;
+        unsigned int bookedBytes = 0;
         // Set the band counter to zero
         int band = 0;
-        // Create the set for booked bands
+        // Create the set for booked bands, with the bytes carried by one block of each band
         std::vector<Band> bookedBands;
+        std::map<Band, unsigned int> bookedBandBytes;
 
         // Scan the RBs and find the best candidate "hole" to allocate the UE
         // We need to allocate RBs in the hole with the minimum length, such that the request is satisfied
@@ -376,7 +381,9 @@ void LteAllocatorBestFit::prepareSchedule()
 
                 // Book the bands that must be allocated
                 bookedBands.push_back(band);
-                if (blocks == req_RBs)
+                bookedBandBytes[band] = eNbScheduler_->mac_->getAmc()->computeBytesOnSubband(nodeId, band, cw, 1, dir, carrierFrequency_);
+                bookedBytes += bookedBandBytes[band];
+                if (bookedBytes >= vQueueFrontSize)
                     break; // All the blocks and bytes have been allocated
             }
         }
@@ -390,21 +397,23 @@ void LteAllocatorBestFit::prepareSchedule()
 
                 // Book the bands that must be allocated
                 bookedBands.push_back(band);
-                if (blocks == req_RBs)
+                bookedBandBytes[band] = eNbScheduler_->mac_->getAmc()->computeBytesOnSubband(nodeId, band, cw, 1, dir, carrierFrequency_);
+                bookedBytes += bookedBandBytes[band];
+                if (bookedBytes >= vQueueFrontSize)
                     break; // All the blocks and bytes have been allocated
             }
         }
 
         // If the booked request is sufficient to serve entirely or
         // partially a BSR (at least an RB) do the allocation
-        if (blocks <= req_RBs && blocks != 0) {
+        if (blocks != 0) {
             // Going here means that there's room for allocation (here's the true allocation)
             std::sort(bookedBands.begin(), bookedBands.end());
             // For all the bands previously booked
             for (auto band : bookedBands) {
                 // TODO Find a correct way to specify plane and antenna
                 allocatedRbsPerBand_[MAIN_PLANE][MACRO][band].ueAllocatedRbsMap_[nodeId] += 1;
-                allocatedRbsPerBand_[MAIN_PLANE][MACRO][band].ueAllocatedBytesMap_[nodeId] += req_Bytes1RB;
+                allocatedRbsPerBand_[MAIN_PLANE][MACRO][band].ueAllocatedBytesMap_[nodeId] += bookedBandBytes[band];
                 allocatedRbsPerBand_[MAIN_PLANE][MACRO][band].allocated_ += 1;
             }
 
@@ -423,12 +432,15 @@ void LteAllocatorBestFit::prepareSchedule()
             }
 
             // Extract the BSR if an entire BSR is served
-            if (blocks == req_RBs) {
+            if (bookedBytes >= vQueueFrontSize) {
                 // All the bytes have been served
                 conn->popFront();
             }
             else {
-                conn->front().first -= (blocks * req_Bytes1RB - MAC_HEADER - RLC_HEADER_UM); // Otherwise update the BSR size
+                // Otherwise update the BSR size
+                PacketInfo bsr = conn->popFront();
+                bsr.first -= (bookedBytes - MAC_HEADER - RLC_HEADER_UM);
+                conn->pushFront(bsr);
             }
         }
 
@@ -9,6 +9,9 @@
 // and cannot be removed from it.
 //
 
+#include <algorithm>
+#include <cmath>
+
 #include "stack/mac/scheduling_modules/LteDrr.h"
 #include "stack/mac/scheduler/LteSchedulerEnb.h"
 
@@ -16,35 +19,64 @@ namespace simu5g {
 
 using namespace omnetpp;
 
+LteDrr::DrrDesc& LteDrr::touchDescriptor(MacCid cid)
+{
+    auto it = drrLog_.find(cid);
+    if (it == drrLog_.end())
+        it = drrLog_.emplace(cid, getDescriptor(cid)).first;
+    return it->second;
+}
+
+LteDrr::DrrDesc& LteDrr::getDescriptor(MacCid cid)
+{
+    auto [it, created] = drrMap_.try_emplace(cid);
+    if (created) {
+        // the quantum is weighted by the priority level of the QFI carried by the connection,
+        // lower levels meaning higher priority (same scaling as the Lyapunov scheduler)
+        double weight = 1.0;
+        if (qfiWeightBase_ != 1.0) {
+            const QfiContext *context = QfiContextManager::getInstance()->getContextByQfi(eNbScheduler_->mac_->getQfi(cid));
+            if (context != nullptr)
+                weight = pow(qfiWeightBase_, 9 - context->priorityLevel);
+        }
+        it->second.quantum_ = std::max(1u, (unsigned int)ceil(baseQuantum_ * weight));
+        EV << NOW << " LteDrr::getDescriptor CID " << cid << " quantum " << it->second.quantum_ << endl;
+    }
+    return it->second;
+}
+
 void LteDrr::prepareSchedule()
 {
-    activeTempList_ = activeList_;
-    drrTempMap_ = drrMap_;
+    // prepareSchedule() is always followed by commitSchedule(), hence the round-robin pointer
+    // of the active list is moved in place, while the descriptors are modified through a log
+    // holding only the connections visited in this slot
+    drrLog_.clear();
+    deactivatedLog_.clear();
 
     bool terminateFlag = false, activeFlag = true, eligibleFlag = true;
-    unsigned int eligible = activeTempList_.size();
+    unsigned int eligible = activeList_.size();
     // Loop until the active list is not empty and there is spare room.
-    while (!activeTempList_.empty() && eligible > 0) {
+    while (!activeList_.empty() && eligible > 0) {
         // Get the current CID.
-        MacCid cid = activeTempList_.current();
+        MacCid cid = activeList_.current();
 
         MacNodeId nodeId = MacCidToNodeId(cid);
 
         // Check if node is still a valid node in the simulation - might have been dynamically removed.
         if (binder_->getOmnetId(nodeId) == 0) {
-            activeTempList_.erase();          // Remove from the active list.
-            activeConnectionTempSet_.erase(cid);
+            activeList_.erase();          // Remove from the active list.
+            deactivatedLog_.push_back(cid);
             carrierActiveConnectionSet_.erase(cid);
             EV << "CID " << cid << " of node " << nodeId << " removed from active connection set - no OmnetId in Binder known.";
             continue;
         }
 
         // Get the current DRR descriptor.
-        DrrDesc& desc = drrTempMap_[cid];
+        DrrDesc& desc = touchDescriptor(cid);
 
         // Check for connection eligibility. If not, skip it.
         if (!desc.eligible_) {
-            activeTempList_.move();
+            activeList_.move();
             eligible--;
             continue;
         }
@@ -76,8 +108,8 @@ void LteDrr::prepareSchedule()
 
         // Remove the queue if it has become inactive.
         if (!activeFlag) {
-            activeTempList_.erase();          // Remove from the active list.
-            activeConnectionTempSet_.erase(cid);
+            activeList_.erase();          // Remove from the active list.
+            deactivatedLog_.push_back(cid);
             carrierActiveConnectionSet_.erase(cid);
             desc.deficit_ = 0;       // Reset the deficit to zero.
             desc.active_ = false;   // Set this descriptor as inactive.
@@ -98,7 +130,7 @@ void LteDrr::prepareSchedule()
         }
         else if (desc.deficit_ == 0) {
             desc.addQuantum_ = true;
-            activeTempList_.move();
+            activeList_.move();
         }
         // else
         //     this connection still has to consume its deficit (e.g., because space has ended)
@@ -112,9 +144,13 @@ void LteDrr::prepareSchedule()
 
 void LteDrr::commitSchedule()
 {
-    activeList_ = activeTempList_;
-    *activeConnectionSet_ = activeConnectionTempSet_;
-    drrMap_ = drrTempMap_;
+    for (const auto& [cid, desc] : drrLog_)
+        drrMap_[cid] = desc;
+    drrLog_.clear();
+
+    for (MacCid cid : deactivatedLog_)
+        activeConnectionSet_->erase(cid);
+    deactivatedLog_.clear();
 }
 
 void LteDrr::updateSchedulingInfo()
@@ -133,9 +169,6 @@ void LteDrr::updateSchedulingInfo()
         throw cRuntimeError("LteDrr::updateSchedulingInfo invalid direction");
     }
 
-    // Select the minimum rate and MAC SDU size.
-    double minSize = 0;
-    double minRate = 0;
     for (auto& it : *conn) {
         MacCid cid = it.first;
         MacNodeId nodeId = MacCidToNodeId(cid);
@@ -149,17 +182,10 @@ void LteDrr::updateSchedulingInfo()
             if (info.readCqiVector()[i] == 0)
                 eligible = false;
         }
-        if (minRate == 0 /* || pars.minReservedRate_ < minRate*/)
-//                TODO add connections parameters and fix this value
-            minRate = 500;
-        if (minSize == 0 /*|| pars.maxBurst_ < minSize */)
-            minSize = 160; // pars.maxBurst_;
 
-        // Compute the quanta. If descriptors do not exist they are created.
+        // If descriptors do not exist they are created along with their quantum.
         // The values of the other fields, e.g., active status, are not changed.
-
-        drrMap_[cid].quantum_ = (unsigned int)(ceil((/*pars.minReservedRate_*/ 500 / minRate) * minSize));
-        drrMap_[cid].eligible_ = eligible;
+        getDescriptor(cid).eligible_ = eligible;
     }
 }
 
@@ -170,14 +196,21 @@ void LteDrr::notifyActiveConnection(MacCid cid)
 
     bool alreadyIn = false;
     activeList_.find(cid, alreadyIn);
+    DrrDesc& desc = getDescriptor(cid);
     if (!alreadyIn) {
         activeList_.insert(cid);
-        drrMap_[cid].active_ = true;
+        desc.active_ = true;
     }
 
-    drrMap_[cid].eligible_ = true;
+    desc.eligible_ = true;
 
-    EV << NOW << "LteSchedulerEnb::notifyDrr active: " << drrMap_[cid].active_ << endl;
+    EV << NOW << "LteSchedulerEnb::notifyDrr active: " << desc.active_ << endl;
+}
+
+void LteDrr::removeConnections(MacNodeId nodeId)
+{
+    // the active list drops the connections of nodes that left the simulation by itself
+    eraseNodeCids(drrMap_, nodeId);
 }
 
 } //namespace
@@ -13,6 +13,7 @@
 #define _LTE_LTEDRR_H_
 
 #include <map>
+#include <vector>
 #include "stack/mac/scheduler/LteScheduler.h"
 #include "common/Circular.h"
 
@@ -50,17 +51,30 @@ class LteDrr : public LteScheduler
     //! Deficit round-robin Active List.
     ActiveList activeList_;
 
-    //! Deficit round-robin Active List. Temporary variable used in the two-phase scheduling operations.
-    ActiveList activeTempList_;
-
     //! Deficit round-robin descriptor per-connection map.
     DrrDescMap drrMap_;
 
-    //! Deficit round-robin descriptor per-connection map. Temporary variable used in the two-phase scheduling operations.
-    DrrDescMap drrTempMap_;
+    //! Descriptors touched by prepareSchedule(), written back to drrMap_ by commitSchedule().
+    DrrDescMap drrLog_;
+
+    //! Connections that became inactive in prepareSchedule(), removed from the active set by commitSchedule().
+    std::vector<MacCid> deactivatedLog_;
+
+    //! Quantum of a connection with unit weight, in bytes.
+    unsigned int baseQuantum_;
+
+    //! Base of the per-QFI quantum weight (1 gives the same quantum to all the QFIs).
+    double qfiWeightBase_;
+
+    //! Returns the working copy of the descriptor of the given connection, logging it on first access.
+    DrrDesc& touchDescriptor(MacCid cid);
+
+    //! Returns the descriptor of the given connection, creating it with its (QFI-weighted) quantum if needed.
+    DrrDesc& getDescriptor(MacCid cid);
 
   public:
-    LteDrr(Binder *binder) : LteScheduler(binder) {}
+    LteDrr(Binder *binder, unsigned int baseQuantum = 160, double qfiWeightBase = 1.0) :
+        LteScheduler(binder), baseQuantum_(baseQuantum), qfiWeightBase_(qfiWeightBase) {}
 
     // Scheduling functions ********************************************************************
 
@@ -70,6 +84,8 @@ class LteDrr : public LteScheduler
 
     void commitSchedule() override;
 
+    void removeConnections(MacNodeId nodeId) override;
+
     // *****************************************************************************************
 
     void notifyActiveConnection(MacCid cid) override;
@@ -18,39 +18,27 @@ using namespace omnetpp;
 
 bool LteMaxCiComp::getBandLimit(std::vector<BandLimit> *bandLimit, MacNodeId ueId)
 {
-    bandLimit->clear();
-
     // get usable bands for this user
-    UsableBands *usableBands = eNbScheduler_->mac_->getAmc()->getPilotUsableBands(ueId);
+    const UsableBandsMask *usableBands = eNbScheduler_->mac_->getAmc()->getPilotUsableBandsMask(ueId);
     if (usableBands == nullptr) {
         // leave the bandLimit empty
+        bandLimit->clear();
         return false;
     }
 
     // check the number of codewords
     unsigned int numCodewords = 1;
     unsigned int numBands = eNbScheduler_->mac_->getCellInfo()->getNumBands();
-    // for each band of the band vector provided
+
+    // the vector is reused across calls: only the limits are rewritten
+    bandLimit->resize(numBands);
     for (unsigned int i = 0; i < numBands; i++) {
-        BandLimit elem;
+        BandLimit& elem = bandLimit->at(i);
         elem.band_ = Band(i);
 
-        int limit = -2;
-
-        // check whether band i is in the set of usable bands
-        for (auto band : *usableBands) {
-            if (band == i) {
-                // band i must be marked as unlimited
-                limit = -1;
-                break;
-            }
-        }
-
-        elem.limit_.clear();
-        for (unsigned int j = 0; j < numCodewords; j++)
-            elem.limit_.push_back(limit);
-
-        bandLimit->push_back(elem);
+        // bands not in the set of usable bands are skipped, the others are unlimited
+        int limit = isUsableBand(*usableBands, elem.band_) ? -1 : -2;
+        elem.limit_.assign(numCodewords, limit);
     }
 
     return true;
@@ -9,6 +9,8 @@
 // and cannot be removed from it.
 //
 
+#include <map>
+#include <set>
 #include <vector>
 
 #include "stack/mac/scheduling_modules/LteMaxCiMultiband.h"
@@ -16,101 +18,193 @@
 
 namespace simu5g {
 
-using namespace std;
 using namespace omnetpp;
 
-bool debug = false;
+// a grant has a single direction: the D2D connections of a UE are not granted together with its UL ones
+static Direction getGrantDirection(MacCid cid, Direction direction)
+{
+    LogicalCid lcid = MacCidToLcid(cid);
+    if (direction == UL && lcid == D2D_SHORT_BSR)
+        return D2D;
+    if (direction == UL && lcid == D2D_MULTI_SHORT_BSR)
+        return D2D_MULTI;
+    return direction;
+}
+
+void LteMaxCiMultiband::updateBandScores()
+{
+    unsigned int numBands = bandLimit_->size();
+    bool sameBands = rankedBands_.size() == numBands;
+    for (unsigned int i = 0; sameBands && i < numBands; i++)
+        sameBands = rankedBands_[i] == bandLimit_->at(i).band_;
+    if (!sameBands) {
+        rankedBands_.resize(numBands);
+        for (unsigned int i = 0; i < numBands; i++)
+            rankedBands_[i] = bandLimit_->at(i).band_;
+        bandScores_.reset(numBands);
+        rankedFeedbackCount_.clear();
+    }
+
+    // the UEs that are not backlogged anymore leave the ranking
+    std::vector<MacNodeId> idle;
+    for (const auto& [nodeId, scores] : bandScores_.getScores()) {
+        if (ueCids_.find(nodeId) == ueCids_.end())
+            idle.push_back(nodeId);
+    }
+    for (MacNodeId nodeId : idle)
+        removeConnections(nodeId);
+
+    // the scores of a UE are computed again only when it reports a new CQI
+    LteAmc *amc = eNbScheduler_->mac_->getAmc();
+    std::vector<unsigned int> bandBytes(numBands);
+    for (const auto& [nodeId, cids] : ueCids_) {
+        unsigned int feedbackCount = amc->getFeedbackCount(nodeId, direction_, carrierFrequency_);
+        auto fit = rankedFeedbackCount_.find(nodeId);
+        if (fit != rankedFeedbackCount_.end() && fit->second == feedbackCount)
+            continue;
+        rankedFeedbackCount_[nodeId] = feedbackCount;
+
+        const UserTxParams& info = amc->computeTxParams(nodeId, direction_, carrierFrequency_);
+        unsigned int layers = info.getLayers().empty() ? 1 : info.getLayers().front();
+
+        // obtain a vector of CQI, one for each band
+        std::vector<Cqi> cqi = amc->readMultiBandCqi(nodeId, direction_, carrierFrequency_);
+        for (unsigned int i = 0; i < numBands; i++) {
+            Band band = rankedBands_[i];
+            bandBytes[i] = (band < cqi.size()) ? layers * amc->computeBitsPerRbBackground(cqi[band], direction_, carrierFrequency_) / 8 : 0;
+        }
+        bandScores_.update(nodeId, bandBytes);
+    }
+}
 
 void LteMaxCiMultiband::prepareSchedule()
 {
     activeConnectionTempSet_ = *activeConnectionSet_;
-    unsigned int byPs = 0;
-    ScoreList score;
 
-    // compute score based on total available bytes
-    unsigned int availableBlocks = 0;
-    unsigned int availableBytes = 0;
-    unsigned int availableBytes_MB = 0;
+    unsigned int numBands = bandLimit_->size();
 
-    unsigned int totAvailableBlocks = 0;
-    unsigned int totAvailableBytes_MB = 0;
+    // all the bands are skipped but the ones won by the UE being granted
+    ueBandLimit_ = *bandLimit_;
+    for (auto& elem : ueBandLimit_)
+        elem.limit_.assign(elem.limit_.size(), -2);
 
-    // UsableBands * usableBands;
-    if (debug)
-        cout << NOW << " LteMaxCiMultiband::prepareSchedule - Total Active Connections:" << activeConnectionTempSet_.size() << endl;
-    for (MacCid cid : carrierActiveConnectionSet_) {
+    for (auto& [nodeId, cids] : ueCids_)
+        cids.clear();
+
+    EV << NOW << " LteMaxCiMultiband::prepareSchedule - Total Active Connections:" << activeConnectionTempSet_.size() << endl;
+    for (auto it = carrierActiveConnectionSet_.begin(); it != carrierActiveConnectionSet_.end(); ) {
         // Current connection.
+        MacCid cid = *it;
         MacNodeId nodeId = MacCidToNodeId(cid);
         OmnetId id = binder_->getOmnetId(nodeId);
         if (nodeId == NODEID_NONE || id == 0) {
             // node has left the simulation - erase corresponding CIDs
             activeConnectionSet_->erase(cid);
             activeConnectionTempSet_.erase(cid);
-            carrierActiveConnectionSet_.erase(cid);
+            it = carrierActiveConnectionSet_.erase(it);
             continue;
         }
-        // obtain a vector of CQI, one for each band
-        std::vector<Cqi> vect = eNbScheduler_->mac_->getAmc()->readMultiBandCqi(nodeId, direction_, carrierFrequency_);
-        if (debug)
-            cout << NOW << " LteMaxCiMultiband::prepareSchedule - per band cqi for UE[" << nodeId << "]" << endl;
-
-        totAvailableBlocks = 0;
-        totAvailableBytes_MB = 0;
-
-        // compute the number of bytes that can be fitted into each BAND
-        for (int band = 0; band < vect.size(); ++band ) {
-            unsigned int blocks = eNbScheduler_->readAvailableRbs(nodeId, MACRO, band);
-            availableBlocks += blocks;
-            availableBytes_MB = eNbScheduler_->mac_->getAmc()->computeBytesOnNRbs_MB(nodeId, band, blocks, direction_, carrierFrequency_);
-            availableBytes = eNbScheduler_->mac_->getAmc()->computeBytesOnNRbs(nodeId, band, blocks, direction_, carrierFrequency_);
-
-            totAvailableBlocks += availableBlocks;
-            totAvailableBytes_MB += availableBytes_MB;
-            if (debug)
-                cout << "\t" << band << ") CQI=" << vect[band] << " - Blocks=" << availableBlocks
-                     << " - Bytes_MB=" << availableBytes_MB << " - Bytes=" << availableBytes << endl;
-        }
-
-        // current user bytes per slot
-        byPs = (totAvailableBlocks > 0) ? (totAvailableBytes_MB / totAvailableBlocks) : 0;
-
-        // Create a new score descriptor for the connection, where the score is equal to the ratio between bytes per slot and long term rate
-        ScoreDesc desc(cid, byPs);
-        // insert the cid score
-        score.push(desc);
-        if (debug)
-            cout << NOW << " LteMaxCiMultiband::schedule computed for cid " << cid << " score of " << desc.score_ << endl;
+        ++it;
+        ueCids_[nodeId].push_back(cid);
+    }
+    for (auto it = ueCids_.begin(); it != ueCids_.end(); ) {
+        if (it->second.empty())
+            it = ueCids_.erase(it);
+        else
+            ++it;
     }
 
-    // Schedule the connections in score order.
-    while (!score.empty()) {
-        // Pop the top connection from the list.
-        ScoreDesc current = score.top();
-
-        EV << NOW << " LteMaxCiMultiband::schedule scheduling connection " << current.x_ << " with score of " << current.score_ << endl;
-
-        // Grant data to that connection.
-        bool terminate = false;
-        bool active = true;
-        bool eligible = true;
-        unsigned int granted = requestGrant(current.x_, 4294967295U, terminate, active, eligible);
-
-        EV << NOW << "LteMaxCiMultiband::schedule granted " << granted << " bytes to connection " << current.x_ << endl;
-
-        // Exit immediately if the terminate flag is set.
-        if (terminate) break;
-
-        // Pop the descriptor from the score list if the active or eligible flag are clear.
-        if (!active || !eligible) {
-            score.pop();
-            EV << NOW << "LteMaxCiMultiband::schedule  connection " << current.x_ << " was found ineligible" << endl;
+    updateBandScores();
+
+    // UEs that cannot be served anymore in this slot: a UE receives a single grant per slot, hence
+    // the UEs already granted by a previous scheduling pass (e.g. retransmissions) are skipped as well
+    std::set<MacNodeId> excluded;
+    for (const auto& [nodeId, cws] : eNbScheduler_->allocatedCws_)
+        excluded.insert(nodeId);
+    auto isExcluded = [&excluded](MacNodeId nodeId) { return excluded.find(nodeId) != excluded.end(); };
+
+    // bands that can still be assigned in this slot
+    std::vector<bool> open(numBands);
+    for (unsigned int i = 0; i < numBands; i++)
+        open[i] = bandLimit_->at(i).limit_.at(0) != -2;
+
+    // each round assigns every band with free blocks to the best UE on that band, then issues one grant
+    // per winning UE, spanning all the bands it won. The blocks left over by a winner are assigned in
+    // the next round to the best of the remaining UEs
+    bandScores_.startPass();
+    std::vector<MacNodeId> winners;
+    std::map<MacNodeId, std::vector<unsigned int>> wonBands;
+    std::vector<std::pair<MacCid, double>> shares;
+    std::vector<unsigned int> granted;
+    bool assigned = true;
+    while (assigned) {
+        assigned = false;
+        winners.clear();
+        wonBands.clear();
+
+        for (unsigned int i = 0; i < numBands; i++) {
+            if (!open[i])
+                continue;
+
+            Band band = bandLimit_->at(i).band_;
+            BandScoreIndex<MacNodeId>::Entry best;
+            if (!bandScores_.getBest(i, isExcluded, best) || eNbScheduler_->readAvailableRbs(best.second, MACRO, band) == 0) {
+                // no UE left or the band is full, it will not be assigned anymore
+                open[i] = false;
+                continue;
+            }
+            auto [bytesPerBlock, nodeId] = best;
+
+            EV << NOW << " LteMaxCiMultiband::schedule band " << band << " won by UE " << nodeId << " with " << bytesPerBlock << " bytes per block" << endl;
+
+            auto [win, inserted] = wonBands.emplace(nodeId, std::vector<unsigned int>());
+            if (inserted)
+                winners.push_back(nodeId);
+            win->second.push_back(i);
         }
 
-        // Set the connection as inactive if indicated by the grant ().
-        if (!active) {
-            EV << NOW << "LteMaxCiMultiband::schedule scheduling connection " << current.x_ << " set to inactive " << endl;
-            carrierActiveConnectionSet_.erase(current.x_);
-            activeConnectionTempSet_.erase(current.x_);
+        for (MacNodeId nodeId : winners) {
+            const std::vector<unsigned int>& bands = wonBands.at(nodeId);
+            for (unsigned int i : bands)
+                ueBandLimit_[i].limit_ = bandLimit_->at(i).limit_;
+
+            // Grant data to the UE, on the bands it won only. The grant is shared by all the
+            // backlogged connections of the UE having the same direction as the first one
+            const std::vector<MacCid>& cids = ueCids_.at(nodeId);
+            Direction dir = getGrantDirection(cids.front(), direction_);
+            shares.clear();
+            for (MacCid cid : cids) {
+                if (getGrantDirection(cid, direction_) == dir)
+                    shares.emplace_back(cid, 1.0);
+            }
+
+            bool terminate = false;
+            bool active = true;
+            bool eligible = true;
+            unsigned int total = requestUeGrant(shares, 4294967295U, terminate, active, eligible, granted, &ueBandLimit_);
+
+            EV << NOW << " LteMaxCiMultiband::schedule granted " << total << " bytes to UE " << nodeId << " (" << shares.size() << " connections) on " << bands.size() << " bands" << endl;
+
+            for (unsigned int i : bands)
+                ueBandLimit_[i].limit_.assign(ueBandLimit_[i].limit_.size(), -2);
+
+            // Exit immediately if the terminate flag is set.
+            if (terminate)
+                return;
+
+            excluded.insert(nodeId);
+            assigned = true;
+
+            // Set the connections as inactive if indicated by the grant: a UE grant is active as
+            // long as any of its connections is, hence each one is checked
+            LteMacBufferMap *buffers = (direction_ == DL) ? eNbScheduler_->vbuf_ : eNbScheduler_->bsrbuf_;
+            for (const auto& [cid, weight] : shares) {
+                if (!active || (shares.size() > 1 && buffers->at(cid)->isEmpty())) {
+                    EV << NOW << " LteMaxCiMultiband::schedule scheduling connection " << cid << " set to inactive " << endl;
+                    carrierActiveConnectionSet_.erase(cid);
+                    activeConnectionTempSet_.erase(cid);
+                }
+            }
         }
     }
 }
@@ -120,5 +214,11 @@ void LteMaxCiMultiband::commitSchedule()
     *activeConnectionSet_ = activeConnectionTempSet_;
 }
 
+void LteMaxCiMultiband::removeConnections(MacNodeId nodeId)
+{
+    bandScores_.remove(nodeId);
+    rankedFeedbackCount_.erase(nodeId);
+}
+
 } //namespace
 
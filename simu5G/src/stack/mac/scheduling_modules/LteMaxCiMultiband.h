@@ -13,14 +13,39 @@
 #define LTEMAXCIMULTIBAND_H_
 
 #include "stack/mac/scheduler/LteScheduler.h"
+#include "stack/mac/scheduler/BandScoreIndex.h"
 
 namespace simu5g {
 
 typedef SortedDesc<MacCid, unsigned int> ScoreDesc;
 typedef std::priority_queue<ScoreDesc> ScoreList;
 
+/**
+ * Frequency-selective MaxC/I: each band is assigned to the backlogged UE with the best CQI on
+ * that band, according to the per-band CQI reports.
+ * Each UE receives a single grant, spanning all the bands it won and shared by all its backlogged
+ * connections.
+ */
 class LteMaxCiMultiband : public virtual LteScheduler
 {
+  protected:
+    /// Per-band ranking of the backlogged UEs by bytes per block, kept across slots
+    BandScoreIndex<MacNodeId> bandScores_;
+
+    /// Bands ranked by bandScores_, the ranking is rebuilt if they change (e.g. on a bandwidth part switch)
+    std::vector<Band> rankedBands_;
+
+    /// Number of feedbacks received from each ranked UE when its scores were computed
+    std::map<MacNodeId, unsigned int> rankedFeedbackCount_;
+
+    /// Backlogged connections of each UE in the current slot. The storage is reused across slots
+    std::map<MacNodeId, std::vector<MacCid>> ueCids_;
+
+    /// Band limit used to restrict the grant of a UE to the bands it won
+    BandLimitVector ueBandLimit_;
+
+    /// Updates the ranking of the UEs whose backlog or CQI changed since the previous slot
+    void updateBandScores();
 
   public:
     LteMaxCiMultiband(Binder *binder) : LteScheduler(binder) {}
@@ -28,9 +53,10 @@ class LteMaxCiMultiband : public virtual LteScheduler
     void prepareSchedule() override;
 
     void commitSchedule() override;
+
+    void removeConnections(MacNodeId nodeId) override;
 };
 
 } //namespace
 
 #endif /* LTEMAXCIMULTIBAND_H_ */
-
@@ -84,7 +84,7 @@ void LtePf::prepareSchedule()
             for ( ; it != et; ++it) {
                 unsigned int blocks = eNbScheduler_->readAvailableRbs(nodeId, antenna, *it);
                 availableBlocks += blocks;
-                availableBytes += eNbScheduler_->mac_->getAmc()->computeBytesOnNRbs(nodeId, *it, blocks, dir, carrierFrequency_);
+                availableBytes += eNbScheduler_->mac_->getAmc()->computeBytesOnSubband(nodeId, *it, blocks, dir, carrierFrequency_);
             }
         }
 
@@ -175,5 +175,10 @@ void LtePf::commitSchedule()
     *activeConnectionSet_ = activeConnectionTempSet_;
 }
 
+void LtePf::removeConnections(MacNodeId nodeId)
+{
+    eraseNodeCids(pfRate_, nodeId);
+}
+
 } //namespace
 
@@ -51,6 +51,8 @@ class LtePf : public LteScheduler
 
     void commitSchedule() override;
 
+    void removeConnections(MacNodeId nodeId) override;
+
     // *****************************************************************************************
 
     LtePf(Binder *binder, double pfAlpha) :
@@ -5,6 +5,8 @@
  * Author: kouros
  */
 
+#include <algorithm>
+
 #include "stack/mac/scheduling_modules/LyapunovScheduler.h"
 #include "stack/mac/scheduler/LteSchedulerEnb.h"
 #include "stack/mac/LteMacEnb.h"
@@ -17,11 +19,12 @@ using namespace omnetpp;
 
 
 // Constructor saves alpha and beta using an initializer list
-LyapunovScheduler::LyapunovScheduler(Binder* binder, double lyAlpha, double lyBeta)
-    : LteScheduler(binder), lyAlpha_(lyAlpha), lyBeta_(lyBeta)
+LyapunovScheduler::LyapunovScheduler(Binder* binder, double lyAlpha, double lyBeta, double lyEnergyWeight, bool ueScoring, double maxMutedDelay)
+    : LteScheduler(binder), lyAlpha_(lyAlpha), lyBeta_(lyBeta), lyEnergyWeight_(lyEnergyWeight), maxMutedDelay_(maxMutedDelay), ueScoring_(ueScoring)
 {
     loadContextIfNeeded();
-    EV << "LyapunovScheduler created with lyAlpha: " << lyAlpha_ << ", lyBeta: " << lyBeta_ << endl;
+    EV << "LyapunovScheduler created with lyAlpha: " << lyAlpha_ << ", lyBeta: " << lyBeta_ << ", lyEnergyWeight: " << lyEnergyWeight_
+       << ", ueScoring: " << ueScoring_ << endl;
 }
 
 
@@ -79,6 +82,38 @@ const QfiContext* LyapunovScheduler::getQfiContextForCid(MacCid cid)
 
 
 
+void LyapunovScheduler::buildPricedBandLimit(const std::vector<double>& price, std::vector<BandLimit>& bandLim)
+{
+    // start from the band limits of the carrier (and BWP), so that bands marked as not usable (-2) stay excluded
+    bandLim = *bandLimit_;
+    auto bandPrice = [&price](const BandLimit& elem) {
+        return (elem.band_ < price.size()) ? price[elem.band_] : 0.0;
+    };
+    std::stable_sort(bandLim.begin(), bandLim.end(), [&bandPrice](const BandLimit& a, const BandLimit& b) {
+        return bandPrice(a) < bandPrice(b);
+    });
+}
+
+simtime_t LyapunovScheduler::getHolDelay(MacCid cid, const LteMacBufferMap* buffers) const
+{
+    if (buffers == nullptr)
+        return 0;
+    auto it = buffers->find(cid);
+    if (it == buffers->end() || it->second->isEmpty())
+        return 0;
+    return NOW - it->second->getHolTimestamp();
+}
+
+bool LyapunovScheduler::isDelayCritical(const QfiContext* ctx, simtime_t holDelay) const
+{
+    // age cap, also for the flows without a context or a delay budget
+    if (maxMutedDelay_ > 0 && holDelay >= maxMutedDelay_)
+        return true;
+    if (ctx == nullptr)
+        return false;
+    return ctx->qfi == 4 || (ctx->delayBudgetMs > 0 && holDelay >= ctx->delayBudgetMs / 1000.0);
+}
+
 struct SchedulingInfo {
     MacCid cid;
     const QfiContext* qfiContext;
@@ -86,86 +121,207 @@ struct SchedulingInfo {
     double achievableRate; // in bytes per resource block
 };
 
+double LyapunovScheduler::getBacklog(MacCid cid, const LteMacBufferMap* virtualBuffers)
+{
+    if (direction_ == DL)
+        return eNbScheduler_->mac_->getDlQueueSize(cid);
+
+    // Uplink
+    if (virtualBuffers == nullptr)
+        return 0;
+    auto it = virtualBuffers->find(cid);
+    return (it != virtualBuffers->end()) ? it->second->getQueueOccupancy() : 0;
+}
+
+bool LyapunovScheduler::computeAchievableRate(MacNodeId nodeId, const std::vector<double>& interferencePrice, double& rate, unsigned int& availableBlocks, bool& cellEdge)
+{
+    Direction dir = (direction_ == UL) ? UL : DL;
+    const UserTxParams& info = eNbScheduler_->mac_->getAmc()->computeTxParams(nodeId, dir, carrierFrequency_);
+    if (info.readCqiVector().empty() || info.readBands().empty())
+        return false;
+
+    // per-band rate, discounted by the interference price of the band for cell-edge UEs
+    cellEdge = !interferencePrice.empty() && eNbScheduler_->mac_->isCellEdgeUe(info);
+    availableBlocks = 0;
+    double availableBytes = 0;
+    for (auto antenna : info.readAntennaSet()) {
+        for (auto band : info.readBands()) {
+            unsigned int blocks = eNbScheduler_->readAvailableRbs(nodeId, antenna, band);
+            availableBlocks += blocks;
+            double bytes = eNbScheduler_->mac_->getAmc()->computeBytesOnSubband(nodeId, band, blocks, dir, carrierFrequency_);
+            availableBytes += (cellEdge && band < interferencePrice.size()) ? bytes / (1.0 + interferencePrice[band]) : bytes;
+        }
+    }
+    rate = (availableBlocks > 0) ? availableBytes / availableBlocks : 0.0;
+    return rate > 0;
+}
+
 void LyapunovScheduler::prepareSchedule()
 {
     EV << NOW << " HybridLyapunovScheduler::prepareSchedule" << endl;
 
     const LteMacBufferMap* virtualBuffers = (direction_ == UL) ? eNbScheduler_->mac_->getBsrVirtualBuffers() : nullptr;
+    const LteMacBufferMap* holBuffers = (direction_ == UL) ? virtualBuffers : eNbScheduler_->mac_->getMacBuffers();
     grantedBytes_.clear();
     activeConnectionTempSet_ = *activeConnectionSet_;
 
+    // TDD: backlog not served now waits until the next opportunity in the same direction
+    double tddWaitingTime = eNbScheduler_->mac_->getTddWaitingTime(direction_);
+
+    // inter-cell coordination: bands loaded in the neighbouring cells are priced for cell-edge UEs
+    const std::vector<double>& interferencePrice = eNbScheduler_->mac_->getInterferencePrice(direction_);
+    bool anyCellEdge = false;
+
+    // energy term: serving a block reduces the drift by the score of the connection and costs
+    // V * rbTxEnergy, waking the cell up for the slot costs V * slotActiveEnergy
+    bool energyAware = lyEnergyWeight_ > 0;
+    double blockPenalty = lyEnergyWeight_ * eNbScheduler_->mac_->getRbTxEnergy();
+    double slotGain = 0;
+    bool delayCritical = false;
+
     // --- Unified priority queue for all traffic ---
-    auto compare = [](const ScoredCid& a, const ScoredCid& b) { return a.second < b.second; };
-    std::priority_queue<ScoredCid, std::vector<ScoredCid>, decltype(compare)> scoreQueue(compare);
+    candidates_.clear();
+    auto compare = [](const ScoredCandidate& a, const ScoredCandidate& b) { return a.second < b.second; };
+    std::priority_queue<ScoredCandidate, std::vector<ScoredCandidate>, decltype(compare)> scoreQueue(compare);
 
-    // --- Single Pass Data Gathering and Scoring ---
-    for (const auto& cid : carrierActiveConnectionSet_)
+    // --- Single Pass Data Gathering and Scoring, one UE at a time ---
+    std::vector<std::pair<MacCid, double>> backlogged;
+    for (auto it = carrierActiveConnectionSet_.begin(); it != carrierActiveConnectionSet_.end(); )
     {
-        MacNodeId nodeId = MacCidToNodeId(cid);
+        // the connections of a UE are contiguous in the set
+        MacNodeId nodeId = MacCidToNodeId(*it);
+        auto first = it;
+        while (it != carrierActiveConnectionSet_.end() && MacCidToNodeId(*it) == nodeId)
+            ++it;
         if (nodeId == NODEID_NONE || binder_->getOmnetId(nodeId) == 0) continue;
 
-        double backlog = 0;
-        Direction dir = (direction_ == UL) ? UL : DL;
-
-        if (dir == DL) {
-            backlog = eNbScheduler_->mac_->getDlQueueSize(cid);
-        } else { // Uplink
-            if (virtualBuffers && virtualBuffers->count(cid) > 0) {
-                backlog = virtualBuffers->at(cid)->getQueueOccupancy();
-            }
+        backlogged.clear();
+        for (auto cit = first; cit != it; ++cit) {
+            double backlog = getBacklog(*cit, virtualBuffers);
+            if (backlog > 0)
+                backlogged.push_back({*cit, backlog});
         }
-        if (backlog == 0) continue;
-
-        const UserTxParams& info = eNbScheduler_->mac_->getAmc()->computeTxParams(nodeId, dir, carrierFrequency_);
-        if (info.readCqiVector().empty() || info.readBands().empty()) continue;
+        if (backlogged.empty()) continue;
+
+        // --- Channel-dependent part, common to all the connections of the UE ---
+        double achievableRate = 0;
+        unsigned int availableBlocks = 0;
+        bool cellEdge = false;
+        if (!computeAchievableRate(nodeId, interferencePrice, achievableRate, availableBlocks, cellEdge)) continue;
+
+        GrantCandidate ueCandidate;
+        ueCandidate.cellEdge = cellEdge;
+        double ueScore = 0;
+        bool ueUrllc = false;
+
+        for (const auto& [cid, backlog] : backlogged) {
+            const QfiContext* ctx = getQfiContextForCid(cid);
+            double qosWeight = ctx ? computeQosWeightFromContext(*ctx) : 1.0;
+
+            // the extra waiting is weighed against the delay budget of the flow
+            if (ctx && tddWaitingTime > 0 && ctx->delayBudgetMs > 0)
+                qosWeight *= 1.0 + tddWaitingTime / (ctx->delayBudgetMs / 1000.0);
+
+            // --- Score calculation with tuning exponents ---
+            double weight = pow(backlog, lyAlpha_) * pow(qosWeight, lyBeta_);
+            double score = weight * achievableRate;
+
+            // --- Energy term: blocks whose drift reduction does not pay their energy are left muted ---
+            if (energyAware) {
+                if (isDelayCritical(ctx, getHolDelay(cid, holBuffers)))
+                    delayCritical = true;
+                else if (score <= blockPenalty) {
+                    EV_INFO << NOW << " LyapunovScheduler [CID=" << cid << "] muted, score " << score << " below block penalty " << blockPenalty << endl;
+                    continue;
+                }
+                else
+                    slotGain += (score - blockPenalty) * std::min(backlog / achievableRate, (double)availableBlocks);
+            }
 
-        unsigned int availableBlocks = 0, availableBytes = 0;
-        for (auto antenna : info.readAntennaSet()) {
-            for (auto band : info.readBands()) {
-                unsigned int blocks = eNbScheduler_->readAvailableRbs(nodeId, antenna, band);
-                availableBlocks += blocks;
-                availableBytes += eNbScheduler_->mac_->getAmc()->computeBytesOnNRbs(nodeId, band, blocks, dir, carrierFrequency_);
+            EV_INFO << NOW << " LyapunovScheduler [CID=" << cid << ", QFI=" << (ctx ? ctx->qfi : -1) << "]"
+                    << " Backlog(Q^a)=" << pow(backlog, lyAlpha_)
+                    << " Rate(R)=" << achievableRate
+                    << " Weight(W^b)=" << pow(qosWeight, lyBeta_)
+                    << " --> SCORE=" << score << endl;
+
+            bool urllc = ctx && ctx->qfi == 4; // QFI 4 for URLLC
+            LogicalCid lcid = MacCidToLcid(cid);
+            if (ueScoring_ && lcid != D2D_SHORT_BSR && lcid != D2D_MULTI_SHORT_BSR) {
+                // the queue weights of the DRBs add up into the score of the UE
+                ueCandidate.shares.push_back({cid, weight});
+                ueScore += score;
+                ueUrllc = ueUrllc || urllc;
+                continue;
             }
+
+            // --- Correct Strict Priority logic using a massive score bonus ---
+            if (urllc)
+                score *= 1e12;
+            score += uniform(getEnvir()->getRNG(0), -scoreEpsilon_, scoreEpsilon_);
+
+            GrantCandidate candidate;
+            candidate.shares.push_back({cid, weight});
+            candidate.cellEdge = cellEdge;
+            candidates_.push_back(std::move(candidate));
+            scoreQueue.push({(unsigned int)(candidates_.size() - 1), score});
+            anyCellEdge = anyCellEdge || cellEdge;
         }
-        double achievableRate = (availableBlocks > 0) ? static_cast<double>(availableBytes) / availableBlocks : 0.0;
-        if (achievableRate == 0) continue;
 
-        const QfiContext* ctx = getQfiContextForCid(cid);
-        double qosWeight = ctx ? computeQosWeightFromContext(*ctx) : 1.0;
+        if (!ueCandidate.shares.empty()) {
+            // the heaviest DRB leads the grant
+            std::stable_sort(ueCandidate.shares.begin(), ueCandidate.shares.end(), [](const std::pair<MacCid, double>& a, const std::pair<MacCid, double>& b) {
+                return a.second > b.second;
+            });
+            if (ueUrllc)
+                ueScore *= 1e12;
+            ueScore += uniform(getEnvir()->getRNG(0), -scoreEpsilon_, scoreEpsilon_);
 
-        // --- Score calculation with tuning exponents ---
-        double score = pow(backlog, lyAlpha_) * achievableRate * pow(qosWeight, lyBeta_);
+            EV_INFO << NOW << " LyapunovScheduler [UE=" << nodeId << ", DRBs=" << ueCandidate.shares.size() << "] --> FINAL SCORE=" << ueScore << endl;
 
-        // --- Correct Strict Priority logic using a massive score bonus ---
-        if (ctx && ctx->qfi == 4) { // QFI 4 for URLLC
-            score *= 1e12;
+            candidates_.push_back(std::move(ueCandidate));
+            scoreQueue.push({(unsigned int)(candidates_.size() - 1), ueScore});
+            anyCellEdge = anyCellEdge || cellEdge;
         }
+    }
 
-        score += uniform(getEnvir()->getRNG(0), -scoreEpsilon_, scoreEpsilon_);
-
-        EV_INFO << NOW << " LyapunovScheduler [CID=" << cid << ", QFI=" << (ctx ? ctx->qfi : -1) << "]"
-                << " Backlog(Q^a)=" << pow(backlog, lyAlpha_)
-                << " Rate(R)=" << achievableRate
-                << " Weight(W^b)=" << pow(qosWeight, lyBeta_)
-                << " --> FINAL SCORE=" << score << endl;
-
-        scoreQueue.push({cid, score});
+    // the whole slot stays muted unless some flow is delay critical or the overall gain pays the wake-up
+    if (energyAware && !delayCritical && slotGain <= lyEnergyWeight_ * eNbScheduler_->mac_->getSlotActiveEnergy()) {
+        EV << NOW << " LyapunovScheduler::prepareSchedule - slot muted, gain " << slotGain << endl;
+        return;
     }
 
+    std::vector<BandLimit> pricedBandLim, bandLim;
+    if (anyCellEdge)
+        buildPricedBandLimit(interferencePrice, pricedBandLim);
+
     // --- Unified Granting Loop ---
+    std::vector<unsigned int> granted;
     while (!scoreQueue.empty())
     {
-        ScoredCid current = scoreQueue.top();
+        const GrantCandidate& current = candidates_[scoreQueue.top().first];
         scoreQueue.pop();
 
         bool terminate = false, active = true, eligible = true;
-        unsigned int granted = requestGrant(current.first, UINT32_MAX, terminate, active, eligible);
-        grantedBytes_[current.first] += granted;
+        std::vector<BandLimit> *grantBandLim = nullptr;
+        if (current.cellEdge) {
+            bandLim = pricedBandLim;
+            grantBandLim = &bandLim;
+        }
+        requestUeGrant(current.shares, UINT32_MAX, terminate, active, eligible, granted, grantBandLim);
+        for (size_t i = 0; i < current.shares.size(); i++) {
+            MacCid cid = current.shares[i].first;
+            grantedBytes_[cid] += granted[i];
+            if (granted[i] > 0)
+                eNbScheduler_->mac_->recordSchedulingDelay(cid, direction_, getHolDelay(cid, holBuffers));
+        }
 
         if (terminate) break;
-        if (!active) {
-            activeConnectionTempSet_.erase(current.first);
-            carrierActiveConnectionSet_.erase(current.first);
+        for (const auto& share : current.shares) {
+            // a UE grant is active as long as any of its connections is, check each one
+            if (!active || (current.shares.size() > 1 && getBacklog(share.first, virtualBuffers) == 0)) {
+                activeConnectionTempSet_.erase(share.first);
+                carrierActiveConnectionSet_.erase(share.first);
+            }
         }
     }
 }
@@ -25,6 +25,15 @@ class LyapunovScheduler : public LteScheduler
     double lyAlpha_;
     double lyBeta_;
 
+    // Weight V of the transmit energy in the drift-plus-penalty objective (0 disables the energy term)
+    double lyEnergyWeight_;
+
+    // Head-of-line age beyond which any connection is served regardless of the energy term (0 disables it)
+    simtime_t maxMutedDelay_;
+
+    // If true, the backlogged connections of a UE are scored and granted together (see GrantCandidate)
+    bool ueScoring_;
+
     // Map to store granted bytes in the current TTI for each connection
     std::map<MacCid, unsigned int> grantedBytes_;
 
@@ -34,7 +43,18 @@ class LyapunovScheduler : public LteScheduler
     // Small epsilon value for floating point comparisons and randomization
     const double scoreEpsilon_ = 1e-6;
 
-    typedef std::pair<MacCid, double> ScoredCid;
+    // Connections granted together with a single allocation, with their Lyapunov weights (heaviest first).
+    // A candidate holds either one connection, or all the connections of a UE in UE scoring mode
+    struct GrantCandidate
+    {
+        std::vector<std::pair<MacCid, double>> shares;
+        // cell-edge UEs are served on the bands with the lowest interference price first
+        bool cellEdge = false;
+    };
+    std::vector<GrantCandidate> candidates_;
+
+    // Index of a candidate in candidates_, with its score
+    typedef std::pair<unsigned int, double> ScoredCandidate;
 
     // --- Methods ---
 
@@ -47,10 +67,29 @@ class LyapunovScheduler : public LteScheduler
     // Calculates a weight based on the QoS parameters of a flow
     double computeQosWeightFromContext(const QfiContext& ctx);
 
+    // Builds a copy of the band limits of the carrier, sorted by increasing interference price
+    void buildPricedBandLimit(const std::vector<double>& price, std::vector<BandLimit>& bandLim);
+
+    // Backlog of the connection (DL buffer, or UL virtual buffer fed by the BSRs)
+    double getBacklog(MacCid cid, const LteMacBufferMap* virtualBuffers);
+
+    // Channel-dependent part of the score of a UE: bytes per block over the available blocks, discounted by
+    // the interference price for cell-edge UEs. Returns false if the UE cannot be served on this carrier
+    bool computeAchievableRate(MacNodeId nodeId, const std::vector<double>& interferencePrice, double& rate, unsigned int& availableBlocks, bool& cellEdge);
+
+    // Age of the head-of-line data of the connection in the given buffers, 0 if none.
+    // In UL the buffers are the BSR virtual buffers, whose content is replaced by each BSR: the age is measured
+    // from the last BSR of the connection, and the time the data waited at the UE before (e.g. for a grant) is not seen
+    simtime_t getHolDelay(MacCid cid, const LteMacBufferMap* buffers) const;
+
+    // True if the connection must be served regardless of the energy term (QFI 4, delay budget reached,
+    // or head-of-line age above maxMutedDelay_ for any flow, so that no flow is muted forever)
+    bool isDelayCritical(const QfiContext* ctx, simtime_t holDelay) const;
+
 
   public:
     // Constructor - Simplified to remove PF parameters
-    LyapunovScheduler(Binder* binder, double lyAlpha, double lyBeta);
+    LyapunovScheduler(Binder* binder, double lyAlpha, double lyBeta, double lyEnergyWeight = 0, bool ueScoring = false, double maxMutedDelay = 0);
 
 
     // Main scheduling functions
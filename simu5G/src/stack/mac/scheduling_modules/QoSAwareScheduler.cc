@@ -148,6 +148,11 @@ void QoSAwareScheduler::commitSchedule()
     *activeConnectionSet_ = activeConnectionTempSet_;
 }
 
+void QoSAwareScheduler::removeConnections(MacNodeId nodeId)
+{
+    eraseNodeCids(pfRate_, nodeId);
+}
+
 } // namespace simu5g
 
 
@@ -45,6 +45,7 @@ class QoSAwareScheduler : public LteScheduler
     QoSAwareScheduler(Binder* binder, double pfAlpha);
     void prepareSchedule() override;
     void commitSchedule() override;
+    void removeConnections(MacNodeId nodeId) override;
 };
 
 } // namespace simu5g
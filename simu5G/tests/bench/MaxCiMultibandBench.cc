@@ -0,0 +1,199 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+// Standalone benchmark of the band assignment of LteMaxCiMultiband: the per-band ranking kept
+// across slots (see BandScoreIndex) against per-band heaps rebuilt every slot. Both variants run
+// the same slots, in which a share of the UEs reports new CQIs and some UEs enter or leave the
+// backlogged set, and must assign the bands to the same UEs. It needs no simulation kernel, build
+// and run it from the simu5G directory with:
+//
+//   g++ -std=c++17 -O2 -Isrc tests/bench/MaxCiMultibandBench.cc -o MaxCiMultibandBench && ./MaxCiMultibandBench
+//
+// Optional arguments: number of UEs, number of bands, number of slots, percentage of UEs reporting
+// a CQI in each slot (defaults: 200 100 2000 10).
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "stack/mac/scheduler/BandScoreIndex.h"
+
+using namespace simu5g;
+
+typedef unsigned int UeId;
+typedef std::vector<std::pair<unsigned int, UeId>> Assignment;    // (band, UE) in assignment order
+
+// the state of the cell in a slot, as seen by the scheduler
+struct Slot
+{
+    std::vector<bool> backlogged;
+    std::vector<unsigned int> feedbackCount;
+    std::vector<std::vector<unsigned int>> bandBytes;    // per UE and band, bytes per block
+};
+
+// whether a UE leaves its won bands with free blocks for the next round (e.g. its backlog is short)
+static bool leavesBlocks(unsigned int slot, UeId ue)
+{
+    return (slot * 2654435761u + ue * 40503u) % 10 < 3;
+}
+
+// the rounds of LteMaxCiMultiband::prepareSchedule(): each open band goes to its best UE not served
+// yet in the slot, the bands are closed when their blocks run out
+template<typename BestFn>
+static void assignBands(unsigned int slot, unsigned int numBands, BestFn best, Assignment& assignment)
+{
+    std::set<UeId> excluded;
+    std::vector<bool> open(numBands, true);
+    std::vector<UeId> winners;
+    bool assigned = true;
+    while (assigned) {
+        assigned = false;
+        winners.clear();
+        for (unsigned int i = 0; i < numBands; i++) {
+            UeId ue;
+            if (!open[i] || !best(i, excluded, ue)) {
+                open[i] = false;
+                continue;
+            }
+            assignment.emplace_back(i, ue);
+            open[i] = leavesBlocks(slot, ue);
+            winners.push_back(ue);
+        }
+        for (UeId ue : winners) {
+            excluded.insert(ue);
+            assigned = true;
+        }
+    }
+}
+
+// baseline: the heaps are rebuilt from all the backlogged UEs in every slot
+static double runRebuild(const std::vector<Slot>& slots, unsigned int numBands, std::vector<Assignment>& result)
+{
+    std::vector<std::vector<std::pair<unsigned int, UeId>>> heaps(numBands);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int s = 0; s < slots.size(); s++) {
+        const Slot& slot = slots[s];
+        for (auto& heap : heaps)
+            heap.clear();
+        for (UeId ue = 0; ue < slot.backlogged.size(); ue++) {
+            if (!slot.backlogged[ue])
+                continue;
+            for (unsigned int i = 0; i < numBands; i++) {
+                if (slot.bandBytes[ue][i] > 0)
+                    heaps[i].emplace_back(slot.bandBytes[ue][i], ue);
+            }
+        }
+        for (auto& heap : heaps)
+            std::make_heap(heap.begin(), heap.end());
+
+        auto best = [&heaps](unsigned int i, const std::set<UeId>& excluded, UeId& ue) {
+            auto& heap = heaps[i];
+            while (!heap.empty()) {
+                ue = heap.front().second;
+                if (excluded.find(ue) == excluded.end())
+                    return true;
+                std::pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+            return false;
+        };
+        assignBands(s, numBands, best, result[s]);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the ranking is only updated for the UEs whose backlog or CQI changed, as in LteMaxCiMultiband
+static double runIncremental(const std::vector<Slot>& slots, unsigned int numBands, std::vector<Assignment>& result)
+{
+    BandScoreIndex<UeId> index;
+    index.reset(numBands);
+    std::vector<unsigned int> rankedFeedbackCount;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int s = 0; s < slots.size(); s++) {
+        const Slot& slot = slots[s];
+        rankedFeedbackCount.resize(slot.backlogged.size(), 0);
+        for (UeId ue = 0; ue < slot.backlogged.size(); ue++) {
+            if (!slot.backlogged[ue]) {
+                index.remove(ue);
+                continue;
+            }
+            if (index.contains(ue) && rankedFeedbackCount[ue] == slot.feedbackCount[ue])
+                continue;
+            rankedFeedbackCount[ue] = slot.feedbackCount[ue];
+            index.update(ue, slot.bandBytes[ue]);
+        }
+
+        index.startPass();
+        auto best = [&index](unsigned int i, const std::set<UeId>& excluded, UeId& ue) {
+            BandScoreIndex<UeId>::Entry entry;
+            if (!index.getBest(i, [&excluded](UeId id) { return excluded.find(id) != excluded.end(); }, entry))
+                return false;
+            ue = entry.second;
+            return true;
+        };
+        assignBands(s, numBands, best, result[s]);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int numUes = (argc > 1) ? atoi(argv[1]) : 200;
+    unsigned int numBands = (argc > 2) ? atoi(argv[2]) : 100;
+    unsigned int numSlots = (argc > 3) ? atoi(argv[3]) : 2000;
+    unsigned int reportPercent = (argc > 4) ? atoi(argv[4]) : 10;
+
+    // the slots are generated beforehand, so that both variants only time the scheduler
+    std::mt19937 rng(1);
+    std::vector<Slot> slots(numSlots);
+    Slot current;
+    current.backlogged.assign(numUes, true);
+    current.feedbackCount.assign(numUes, 0);
+    current.bandBytes.assign(numUes, std::vector<unsigned int>(numBands));
+    // bytes per block of each CQI, one and two layers
+    static const unsigned int cqiBytes[] = { 0, 2, 3, 5, 8, 11, 14, 18, 23, 27, 33, 38, 44, 49, 55, 58 };
+    auto report = [&](UeId ue) {
+        current.feedbackCount[ue]++;
+        unsigned int layers = 1 + ue % 2;
+        for (auto& bytes : current.bandBytes[ue])
+            bytes = layers * cqiBytes[rng() % 16];
+    };
+    for (UeId ue = 0; ue < numUes; ue++)
+        report(ue);
+    for (auto& slot : slots) {
+        for (UeId ue = 0; ue < numUes; ue++) {
+            if (rng() % 100 < reportPercent)
+                report(ue);
+            if (rng() % 100 < 2)
+                current.backlogged[ue] = !current.backlogged[ue];
+        }
+        slot = current;
+    }
+
+    std::vector<Assignment> rebuilt(numSlots), incremental(numSlots);
+    double rebuildTime = runRebuild(slots, numBands, rebuilt);
+    double incrementalTime = runIncremental(slots, numBands, incremental);
+
+    std::cout << numUes << " UEs, " << numBands << " bands, " << numSlots << " slots, " << reportPercent << "% CQI reports per slot" << std::endl;
+    std::cout << "  heaps rebuilt every slot:  " << rebuildTime * 1e6 / numSlots << " us/slot" << std::endl;
+    std::cout << "  incremental ranking:       " << incrementalTime * 1e6 / numSlots << " us/slot" << std::endl;
+
+    if (rebuilt != incremental) {
+        std::cerr << "FAILED: the two variants assign the bands differently" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+// Standalone churn test of the release of the per-UE state of the eNB on detach (see
+// LteMacEnb::deleteQueues()): UEs repeatedly attach and detach, and the per-node CID ranges
+// (see eraseNodeCids()) must release exactly their own entries of the H-ARQ status of the UL
+// scheduler, of the per-QFI CQI back-off of the AMC and of the PF, QoS-aware and DRR maps.
+// It needs no simulation kernel, build and run it from the simu5G directory with:
+//
+//   g++ -std=c++17 -Isrc tests/unit/DetachChurnTest.cc -o DetachChurnTest && ./DetachChurnTest
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+
+namespace simu5g {
+
+// node and connection identifiers as in common/LteCommon.h
+enum class MacNodeId : unsigned short {};
+typedef unsigned int MacCid;
+typedef unsigned short LogicalCid;
+
+inline MacCid idToMacCid(MacNodeId nodeId, LogicalCid lcid) { return ((MacCid)nodeId << 16) | lcid; }
+inline MacNodeId MacCidToNodeId(MacCid cid) { return MacNodeId(cid >> 16); }
+
+} //namespace
+
+#include "stack/mac/MacCidRange.h"
+
+using namespace simu5g;
+
+static const MacNodeId UE_MIN_ID = MacNodeId(1025);
+static const unsigned int NUM_IDS = 64;     // pool of node IDs reused by the UEs
+static const double CARRIERS[] = { 2.0, 3.5 };
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+// the per-UE state of an eNB touched by the detach
+struct EnbState
+{
+    std::map<double, std::map<MacNodeId, int>> harqRxBuffers;          // MAC, H-ARQ RX buffers
+    std::map<double, std::map<MacNodeId, unsigned char>> harqStatus;   // UL scheduler
+    std::map<double, std::map<MacNodeId, bool>> racStatus;             // UL scheduler
+    std::set<MacCid> activeConnectionSet;                              // schedulers
+    std::map<MacCid, unsigned int> cidCqiBackoff;                      // AMC
+    std::map<MacCid, double> pfRate;                                   // PF
+    std::map<MacCid, double> qosPfRate;                                // QoS-aware
+    std::map<MacCid, int> drrMap;                                      // DRR
+
+    void attach(MacNodeId nodeId, unsigned int numLcids)
+    {
+        for (double carrier : CARRIERS)
+            harqRxBuffers[carrier][nodeId] = 8;
+        racStatus[CARRIERS[0]][nodeId] = true;
+        for (LogicalCid lcid = 1; lcid <= numLcids; lcid++) {
+            MacCid cid = idToMacCid(nodeId, lcid);
+            activeConnectionSet.insert(cid);
+            cidCqiBackoff[cid] = lcid;
+            pfRate[cid] = 0.5;
+            qosPfRate[cid] = 0.5;
+            drrMap[cid] = 0;
+        }
+    }
+
+    // as LteSchedulerEnbUl::updateHarqDescs(), once per slot
+    void updateHarqDescs()
+    {
+        for (const auto& [carrier, buffers] : harqRxBuffers) {
+            for (const auto& [nodeId, processes] : buffers) {
+                auto it = harqStatus[carrier].find(nodeId);
+                if (it != harqStatus[carrier].end())
+                    it->second = (it->second + 1) % processes;
+                else
+                    harqStatus[carrier][nodeId] = 0;
+            }
+        }
+    }
+
+    // as LteMacEnb::deleteQueues() and LteAmc::detachUser()
+    void detach(MacNodeId nodeId)
+    {
+        eraseNodeFromEach(harqRxBuffers, nodeId);
+        eraseNodeCids(activeConnectionSet, nodeId);
+        eraseNodeCids(pfRate, nodeId);
+        eraseNodeCids(qosPfRate, nodeId);
+        eraseNodeCids(drrMap, nodeId);
+        eraseNodeFromEach(racStatus, nodeId);
+        eraseNodeFromEach(harqStatus, nodeId);
+        eraseNodeCids(cidCqiBackoff, nodeId);
+    }
+
+    size_t perNodeEntries() const
+    {
+        size_t n = 0;
+        for (const auto& [carrier, buffers] : harqRxBuffers)
+            n += buffers.size();
+        for (const auto& [carrier, status] : harqStatus)
+            n += status.size();
+        for (const auto& [carrier, status] : racStatus)
+            n += status.size();
+        return n;
+    }
+
+    size_t perCidEntries() const
+    {
+        return activeConnectionSet.size() + cidCqiBackoff.size() + pfRate.size() + qosPfRate.size() + drrMap.size();
+    }
+};
+
+// returns true if the given node has no entry left in any CID-keyed container
+static bool hasNoCids(EnbState& enb, MacNodeId nodeId)
+{
+    auto owns = [nodeId](auto& container) {
+        auto it = lowerBoundNodeCid(container, nodeId);
+        return it != container.end() && MacCidToNodeId(nodeCidKey(*it)) == nodeId;
+    };
+    return !owns(enb.activeConnectionSet) && !owns(enb.cidCqiBackoff) && !owns(enb.pfRate) && !owns(enb.qosPfRate) && !owns(enb.drrMap);
+}
+
+static bool hasNoHarqStatus(const EnbState& enb, MacNodeId nodeId)
+{
+    for (const auto& [carrier, status] : enb.harqStatus) {
+        if (status.count(nodeId) > 0)
+            return false;
+    }
+    return true;
+}
+
+// the CID range of a node does not reach its neighbours in the CID order
+static void testNeighbourNodes()
+{
+    EnbState enb;
+    MacNodeId first = UE_MIN_ID, second = MacNodeId((unsigned short)UE_MIN_ID + 1);
+    enb.attach(first, 3);
+    enb.attach(second, 3);
+    enb.updateHarqDescs();
+
+    enb.detach(first);
+    check(hasNoCids(enb, first) && hasNoHarqStatus(enb, first), "detached node released");
+    check(enb.cidCqiBackoff.size() == 3 && enb.drrMap.size() == 3, "neighbour CIDs kept");
+    check(enb.harqStatus[CARRIERS[0]].count(second) == 1, "neighbour H-ARQ status kept");
+
+    check(eraseNodeCids(enb.pfRate, first) == 0, "erasing an absent node is a no-op");
+    enb.detach(second);
+    check(enb.perCidEntries() == 0 && enb.perNodeEntries() == 0, "all released");
+}
+
+// UEs attach and detach at random over many slots, reusing the same node IDs
+static void testChurn()
+{
+    EnbState enb;
+    std::mt19937 rng(1);
+    std::map<MacNodeId, unsigned int> attached;    // node -> number of connections
+
+    for (unsigned int slot = 0; slot < 5000; slot++) {
+        MacNodeId nodeId = MacNodeId((unsigned short)UE_MIN_ID + rng() % NUM_IDS);
+        if (attached.count(nodeId) == 0) {
+            unsigned int numLcids = 1 + rng() % 4;
+            enb.attach(nodeId, numLcids);
+            attached[nodeId] = numLcids;
+        }
+        else {
+            size_t before = enb.perCidEntries();
+            enb.detach(nodeId);
+            check(before - enb.perCidEntries() == 5 * attached[nodeId], "only the own connections are released");
+            check(hasNoCids(enb, nodeId) && hasNoHarqStatus(enb, nodeId), "no state left for a detached UE");
+            attached.erase(nodeId);
+        }
+        // the H-ARQ status is not created again for detached UEs
+        enb.updateHarqDescs();
+
+        size_t expected = 0;
+        for (const auto& [id, numLcids] : attached)
+            expected += numLcids;
+        check(enb.perCidEntries() == 5 * expected, "CID-keyed state follows the attached UEs");
+        check(enb.perNodeEntries() == attached.size() * (2 * 2 + 1), "per-node state follows the attached UEs");
+        if (failures > 0)
+            return;
+    }
+
+    for (const auto& [nodeId, numLcids] : attached)
+        enb.detach(nodeId);
+    enb.updateHarqDescs();
+
+    check(enb.perNodeEntries() == 0, "harqStatus empty after the last detach");
+    check(enb.cidCqiBackoff.empty(), "cidCqiBackoff empty after the last detach");
+    check(enb.pfRate.empty() && enb.qosPfRate.empty(), "PF and QoS-aware rates empty after the last detach");
+    check(enb.drrMap.empty() && enb.activeConnectionSet.empty(), "DRR map empty after the last detach");
+}
+
+int main()
+{
+    testNeighbourNodes();
+    testChurn();
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "DetachChurnTest: all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+// Standalone test of the split of a UE grant across its DRBs (see splitGrantBytes()).
+// It needs no simulation kernel, build and run it from the simu5G directory with:
+//
+//   g++ -std=c++17 -Isrc tests/unit/GrantSplitTest.cc -o GrantSplitTest && ./GrantSplitTest
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+
+#include "stack/mac/scheduler/GrantSplit.h"
+
+using namespace simu5g;
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static unsigned int sum(const std::vector<unsigned int>& v)
+{
+    return std::accumulate(v.begin(), v.end(), 0u);
+}
+
+// with enough backlog, the shares follow the weights
+static void testSharesMatchWeights()
+{
+    std::vector<unsigned int> split;
+    splitGrantBytes(1000, { 1.0, 3.0, 6.0 }, { false, false, false }, { 5000, 5000, 5000 }, split);
+    check(split == std::vector<unsigned int>({ 100, 300, 600 }), "shares match the weights");
+
+    // rounding leftover goes to the first connection that can use it, no byte is lost
+    splitGrantBytes(1001, { 1.0, 1.0, 1.0 }, { false, false, false }, { 5000, 5000, 5000 }, split);
+    check(sum(split) == 1001, "rounding leftover is assigned");
+    check(split[0] == 335 && split[1] == 333 && split[2] == 333, "rounding leftover in order");
+}
+
+// what a connection cannot use is shared among the other ones by weight
+static void testNeedsAreCapped()
+{
+    std::vector<unsigned int> split;
+    splitGrantBytes(1000, { 2.0, 1.0, 1.0 }, { false, false, false }, { 100, 5000, 5000 }, split);
+    check(split[0] == 100, "saturated connection gets its need");
+    check(split[1] == 450 && split[2] == 450, "remaining bytes split by weight");
+
+    splitGrantBytes(1000, { 1.0, 1.0 }, { false, false }, { 100, 200 }, split);
+    check(split[0] == 100 && split[1] == 200, "bytes beyond the needs are not assigned");
+
+    splitGrantBytes(1000, { 1.0, 1.0 }, { false, false }, { 0, 5000 }, split);
+    check(split[0] == 0 && split[1] == 1000, "empty connection gets nothing");
+}
+
+// the URLLC connections are served to their full need before the weighted ones
+static void testStrictPriority()
+{
+    std::vector<unsigned int> split;
+
+    // the eMBB backlog is far heavier, yet it does not take bytes from the URLLC DRB
+    splitGrantBytes(1000, { 1000.0, 1.0 }, { false, true }, { 50000, 300 }, split);
+    check(split[1] == 300, "urllc served to its need");
+    check(split[0] == 700, "weighted connections share the rest");
+
+    splitGrantBytes(200, { 1000.0, 1.0 }, { false, true }, { 50000, 300 }, split);
+    check(split[1] == 200 && split[0] == 0, "urllc takes the whole grant under contention");
+
+    splitGrantBytes(1000, { 1.0, 1.0, 3.0 }, { true, false, false }, { 200, 5000, 5000 }, split);
+    check(split[0] == 200, "urllc first");
+    check(split[1] == 200 && split[2] == 600, "rest split by weight");
+}
+
+int main()
+{
+    testSharesMatchWeights();
+    testNeedsAreCapped();
+    testStrictPriority();
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "GrantSplitTest: all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+//
+//                  Simu5G
+//
+// Authors: Giovanni Nardini, Giovanni Stea, Antonio Virdis (University of Pisa)
+//
+// This file is part of a software released under the license included in file
+// "license.pdf". Please read LICENSE and README files before using it.
+// The above files and the present reference are part of the software itself,
+// and cannot be removed from it.
+//
+
+// Standalone test of the UE side of UL scheduling: the priority order of the connections in
+// the LCG map (see insertByPriorityLevel()) and the packing of a grant on them (see LcgGrantPacker).
+// It needs no simulation kernel, build and run it from the simu5G directory with:
+//
+//   g++ -std=c++17 -Isrc tests/unit/LcgPackingTest.cc -o LcgPackingTest && ./LcgPackingTest
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "stack/mac/scheduler/LcgPacking.h"
+
+using namespace simu5g;
+
+// sizes as in LteCommon.h
+static const unsigned int MAC_HEADER = 2;
+static const unsigned int RLC_HEADER_UM = 2;
+
+// a DRB of a UE: its QFI and backlog
+struct Drb
+{
+    unsigned int cid;
+    int qfi;
+    unsigned int backlog;
+};
+
+// traffic class -> DRB, as the LCG map of the MAC
+typedef std::multimap<int, Drb> TestLcgMap;
+
+// priority levels configured for the QFIs, the lower the higher the priority
+static std::map<int, int> priorityLevel = { { 4, 20 }, { 5, 10 }, { 7, 70 }, { 9, 90 } };
+
+static int failures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+static void registerDrb(TestLcgMap& lcgMap, int tClass, const Drb& drb)
+{
+    insertByPriorityLevel(lcgMap, tClass, drb, [](const Drb& d) { return priorityLevel.at(d.qfi); });
+}
+
+// serves the DRBs of the map as LcgScheduler::schedule() does, filling the bytes given to each QFI.
+// Returns the number of DRBs visited
+static unsigned int packGrant(const TestLcgMap& lcgMap, unsigned int grant, std::map<int, unsigned int>& perQfi)
+{
+    perQfi.clear();
+    LcgGrantPacker packer(grant, MAC_HEADER, RLC_HEADER_UM);
+    unsigned int visited = 0;
+    for (auto it = lcgMap.begin(); it != lcgMap.end() && !packer.isFilled(); ++it) {
+        visited++;
+        const Drb& drb = it->second;
+        if (drb.backlog == 0)
+            continue;
+        perQfi[drb.qfi] += packer.serve(drb.backlog + RLC_HEADER_UM);
+    }
+    return visited;
+}
+
+// the connections of each traffic class follow the configured priorities, whatever the registration order
+static void testRegistrationOrder()
+{
+    TestLcgMap lcgMap;
+    registerDrb(lcgMap, 0, { 1, 7, 0 });
+    registerDrb(lcgMap, 0, { 2, 4, 0 });
+    registerDrb(lcgMap, 1, { 3, 9, 0 });
+    registerDrb(lcgMap, 0, { 4, 5, 0 });
+    registerDrb(lcgMap, 1, { 5, 5, 0 });
+    registerDrb(lcgMap, 0, { 6, 4, 0 });
+
+    std::vector<unsigned int> order;
+    for (const auto& [tClass, drb] : lcgMap)
+        order.push_back(drb.cid);
+
+    // class 0: QFI 5, then the two QFI 4 DRBs in registration order, then QFI 7. Class 1: QFI 5, then QFI 9
+    check(order == std::vector<unsigned int>({ 4, 2, 6, 1, 5, 3 }), "DRBs sorted by priority level within each class");
+}
+
+// the highest priority flow is packed first and the remainder goes to the next QFI
+static void testPerQfiShares()
+{
+    TestLcgMap lcgMap;
+    registerDrb(lcgMap, 0, { 1, 7, 5000 });
+    registerDrb(lcgMap, 0, { 2, 4, 300 });
+    registerDrb(lcgMap, 0, { 3, 5, 200 });
+
+    std::map<int, unsigned int> perQfi;
+
+    // QFI 5 and 4 fully served, QFI 7 takes what is left
+    packGrant(lcgMap, 1000, perQfi);
+    check(perQfi[5] == 200 + RLC_HEADER_UM, "QFI 5 served first to its backlog");
+    check(perQfi[4] == 300 + RLC_HEADER_UM, "QFI 4 served next to its backlog");
+    check(perQfi[7] == 1000 - MAC_HEADER - perQfi[5] - perQfi[4], "QFI 7 takes the remainder");
+
+    // the grant only covers part of QFI 4, nothing is left for QFI 7
+    packGrant(lcgMap, 400, perQfi);
+    check(perQfi[5] == 200 + RLC_HEADER_UM, "QFI 5 served to its backlog");
+    check(perQfi[4] == 400 - MAC_HEADER - perQfi[5], "QFI 4 takes the rest of the grant");
+    check(perQfi[7] == 0, "lowest priority QFI gets nothing");
+
+    // an empty higher priority DRB leaves the whole grant to the next one
+    lcgMap.clear();
+    registerDrb(lcgMap, 0, { 1, 7, 5000 });
+    registerDrb(lcgMap, 0, { 2, 4, 0 });
+    packGrant(lcgMap, 500, perQfi);
+    check(perQfi[7] == 500 - MAC_HEADER, "empty DRB skipped");
+}
+
+// the scheduler stops visiting the DRBs once the grant cannot carry a minimum SDU
+static void testEarlyStop()
+{
+    TestLcgMap lcgMap;
+    registerDrb(lcgMap, 0, { 1, 5, 1000 });
+    for (unsigned int cid = 2; cid < 10; cid++)
+        registerDrb(lcgMap, 0, { cid, 9, 1000 });
+
+    std::map<int, unsigned int> perQfi;
+    unsigned int visited = packGrant(lcgMap, 500, perQfi);
+    check(visited == 1, "only the DRB filling the grant is visited");
+    check(perQfi[5] == 500 - MAC_HEADER && perQfi[9] == 0, "grant filled by the highest priority DRB");
+
+    // a remainder of exactly a minimum SDU is not served
+    lcgMap.clear();
+    registerDrb(lcgMap, 0, { 1, 5, 100 });
+    registerDrb(lcgMap, 0, { 2, 9, 100 });
+    visited = packGrant(lcgMap, MAC_HEADER + 100 + RLC_HEADER_UM + RLC_HEADER_UM, perQfi);
+    check(visited == 1 && perQfi[9] == 0, "remainder too small for another SDU");
+
+    // a grant too small for any SDU serves nobody
+    visited = packGrant(lcgMap, MAC_HEADER + RLC_HEADER_UM, perQfi);
+    check(visited == 0 && perQfi.empty(), "grant too small for a SDU");
+}
+
+int main()
+{
+    testRegistrationOrder();
+    testPerQfiShares();
+    testEarlyStop();
+
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "LcgPackingTest: all checks passed" << std::endl;
+    return EXIT_SUCCESS;
+}